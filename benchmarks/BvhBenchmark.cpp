@@ -0,0 +1,167 @@
+// Micro-benchmarks of the scene BVH against brute force: build, refit after 1% of the instances
+// moved, frustum query and nearest ray hit, at 10k instances and ten times more up to the limit.
+// Usage: BvhBenchmark [max instances]
+#include "../include/Bvh.h"
+#include "../include/Culling.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t MIN_INSTANCES = 10000;
+static const size_t DEFAULT_MAX_INSTANCES = 1000000;
+static const size_t MOVED_FRACTION = 100; // one instance in this many moves before a refit
+static const size_t RAY_COUNT = 1000;
+static const size_t BRUTE_RAY_COUNT = 20; // brute force rays are slow at a million instances
+static const float  INSTANCES_PER_UNIT3 = 0.01f; // density, kept across sizes
+static const int    REPETITIONS = 3;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Best of a few runs, to keep scheduling noise out
+template <typename Function> static double bestSeconds(Function function) {
+    double best = 1e30;
+    for (int i = 0; i < REPETITIONS; ++i) {
+        Clock::time_point start = Clock::now();
+        function();
+        best = std::min(best, secondsSince(start));
+    }
+    return best;
+}
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverseDirection;
+};
+
+// Distance along the ray to where it enters the box, maxDistance when it misses it closer
+static float rayBoxDistance(const Ray &ray, const AABB &box, float maxDistance) {
+    glm::vec3 t0 = (box.min - ray.origin) * ray.inverseDirection;
+    glm::vec3 t1 = (box.max - ray.origin) * ray.inverseDirection;
+    glm::vec3 near = glm::min(t0, t1);
+    glm::vec3 far = glm::max(t0, t1);
+    float     enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    float     exit = std::min(std::min(far.x, far.y), far.z);
+    return enter <= exit && enter < maxDistance ? enter : maxDistance;
+}
+
+static std::vector<AABB> randomBoxes(size_t count, float extent, std::mt19937 &random) {
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> size(0.5f, 2.0f);
+    std::vector<AABB>                     boxes(count);
+    for (auto &box : boxes) {
+        glm::vec3 center(position(random), position(random), position(random));
+        glm::vec3 half(size(random), size(random), size(random));
+        box.min = center - half;
+        box.max = center + half;
+    }
+    return boxes;
+}
+
+// Rays from the middle of the scene in random directions
+static std::vector<Ray> randomRays(size_t count, std::mt19937 &random) {
+    std::normal_distribution<float> axis(0.0f, 1.0f);
+    std::vector<Ray>                rays(count);
+    for (auto &ray : rays) {
+        ray.origin = glm::vec3(0.0f);
+        ray.direction = glm::normalize(glm::vec3(axis(random), axis(random), axis(random)));
+        ray.inverseDirection = 1.0f / ray.direction;
+    }
+    return rays;
+}
+
+static void benchmark(size_t count) {
+    std::mt19937      random(static_cast<unsigned int>(count));
+    float             extent = 0.5f * std::cbrt(static_cast<float>(count) / INSTANCES_PER_UNIT3);
+    std::vector<AABB> boxes = randomBoxes(count, extent, random);
+    std::vector<Ray>  rays = randomRays(RAY_COUNT, random);
+
+    Bvh    bvh;
+    double build = bestSeconds([&]() { bvh.build(boxes); });
+
+    std::vector<unsigned int> moved;
+    for (size_t i = 0; i < count; i += MOVED_FRACTION) {
+        moved.push_back(static_cast<unsigned int>(i));
+    }
+    double refit = bestSeconds([&]() {
+        for (unsigned int item : moved) {
+            boxes[item].min.x += 0.1f;
+            boxes[item].max.x += 0.1f;
+        }
+        bvh.refit(boxes, moved);
+    });
+
+    // A camera in the middle looking down +z as far as the edge of the scene
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, extent);
+    glm::mat4 view =
+        glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum                   frustum = extractFrustum(projection * view);
+    std::vector<unsigned int> visible;
+    double                    query = bestSeconds([&]() {
+        visible.clear();
+        bvh.queryFrustum(frustum, visible);
+    });
+    size_t bruteVisible = 0;
+    double bruteQuery = bestSeconds([&]() {
+        bruteVisible = 0;
+        for (const auto &box : boxes) {
+            bruteVisible += aabbInFrustum(frustum, box) != FRUSTUM_OUTSIDE;
+        }
+    });
+
+    std::vector<float> nearest(RAY_COUNT);
+    double             raycast = bestSeconds([&]() {
+        for (size_t i = 0; i < RAY_COUNT; ++i) {
+            const Ray &ray = rays[i];
+            nearest[i] = FLT_MAX;
+            bvh.raycast(ray.origin, ray.direction, FLT_MAX,
+                        [&](unsigned int item, float maxDistance) {
+                            nearest[i] = rayBoxDistance(ray, boxes[item], maxDistance);
+                            return nearest[i];
+                        });
+        }
+    });
+    std::vector<float> bruteNearest(BRUTE_RAY_COUNT);
+    double             bruteRaycast = bestSeconds([&]() {
+        for (size_t i = 0; i < BRUTE_RAY_COUNT; ++i) {
+            bruteNearest[i] = FLT_MAX;
+            for (const auto &box : boxes) {
+                bruteNearest[i] = rayBoxDistance(rays[i], box, bruteNearest[i]);
+            }
+        }
+    });
+    size_t hits = 0;
+    for (float distance : nearest) {
+        hits += distance < FLT_MAX;
+    }
+
+    std::printf("%10zu %10.2f %10.3f %10.3f %10.3f %9zu %10.2f %10.2f %6zu\n", count, build * 1e3,
+                refit * 1e3, query * 1e3, bruteQuery * 1e3, visible.size(),
+                raycast * 1e6 / RAY_COUNT, bruteRaycast * 1e6 / BRUTE_RAY_COUNT, hits);
+    if (visible.size() != bruteVisible) {
+        std::printf("  frustum query found %zu instances, brute force %zu\n", visible.size(),
+                    bruteVisible);
+    }
+    if (!std::equal(bruteNearest.begin(), bruteNearest.end(), nearest.begin())) {
+        std::printf("  nearest ray hits differ from brute force\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t maxInstances = argc > 1 ? static_cast<size_t>(std::strtoul(argv[1], nullptr, 10))
+                                   : DEFAULT_MAX_INSTANCES;
+
+    std::printf("%10s %10s %10s %10s %10s %9s %10s %10s %6s\n", "instances", "build ms",
+                "refit ms", "query ms", "brute ms", "visible", "ray us", "brute us", "hits");
+    for (size_t count = MIN_INSTANCES; count <= maxInstances; count *= 10) {
+        benchmark(count);
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+// Micro-benchmarks of the job system: the cost of one job from inside and outside the pool,
+// recursive fork-join, and how a data-parallel loop scales with the worker count.
+// Usage: JobBenchmark [max workers]
+#include "../include/JobSystem.h"
+#include "../include/Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t OVERHEAD_JOBS = 200000;
+static const size_t SCALING_ITEMS = 1 << 22;
+static const size_t SCALING_CHUNK = 1 << 14;
+static const size_t FORK_JOIN_LEAF = 1024;
+static const int    REPETITIONS = 5;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Best of a few runs, to keep scheduling noise out
+template <typename Function> static double bestSeconds(Function function) {
+    double best = 1e30;
+    for (int i = 0; i < REPETITIONS; ++i) {
+        Clock::time_point start = Clock::now();
+        function();
+        best = std::min(best, secondsSince(start));
+    }
+    return best;
+}
+
+// Empty jobs queued by a thread outside the pool, through the shared list
+static double externalJobNanoseconds(JobSystem &jobs) {
+    return bestSeconds([&jobs]() {
+               JobCounter counter;
+               for (size_t i = 0; i < OVERHEAD_JOBS; ++i) {
+                   jobs.run([]() {}, &counter);
+               }
+               jobs.wait(counter);
+           }) *
+           1e9 / static_cast<double>(OVERHEAD_JOBS);
+}
+
+// Empty jobs queued by a job, through its worker's own deque
+static double internalJobNanoseconds(JobSystem &jobs) {
+    return bestSeconds([&jobs]() {
+               JobCounter outer;
+               jobs.run(
+                   [&jobs]() {
+                       JobCounter counter;
+                       for (size_t i = 0; i < OVERHEAD_JOBS; ++i) {
+                           jobs.run([]() {}, &counter);
+                       }
+                       jobs.wait(counter);
+                   },
+                   &outer);
+               jobs.wait(outer);
+           }) *
+           1e9 / static_cast<double>(OVERHEAD_JOBS);
+}
+
+static float work(const std::vector<float> &values, size_t begin, size_t end) {
+    float sum = 0.0f;
+    for (size_t i = begin; i < end; ++i) {
+        sum += std::sqrt(values[i]) * std::sin(values[i]);
+    }
+    return sum;
+}
+
+// Splits the range in halves down to FORK_JOIN_LEAF items, each half a job
+static void forkJoin(JobSystem &jobs, const std::vector<float> &values, size_t begin, size_t end,
+                     float &result) {
+    if (end - begin <= FORK_JOIN_LEAF) {
+        result = work(values, begin, end);
+        return;
+    }
+    size_t     middle = begin + (end - begin) / 2;
+    float      left = 0.0f, right = 0.0f;
+    JobCounter counter;
+    jobs.run([&jobs, &values, begin, middle, &left]() {
+        forkJoin(jobs, values, begin, middle, left);
+    }, &counter);
+    forkJoin(jobs, values, middle, end, right);
+    jobs.wait(counter);
+    result = left + right;
+}
+
+static double chunkedSeconds(JobSystem &jobs, const std::vector<float> &values) {
+    std::vector<float> sums(values.size() / SCALING_CHUNK + 1);
+    return bestSeconds([&]() {
+        JobCounter counter;
+        for (size_t begin = 0, chunk = 0; begin < values.size(); begin += SCALING_CHUNK, ++chunk) {
+            size_t end = std::min(begin + SCALING_CHUNK, values.size());
+            jobs.run([&values, &sums, begin, end,
+                      chunk]() { sums[chunk] = work(values, begin, end); },
+                     &counter);
+        }
+        jobs.wait(counter);
+    });
+}
+
+int main(int argc, char **argv) {
+    size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t maxWorkers = argc > 1 ? static_cast<size_t>(std::strtoul(argv[1], nullptr, 10))
+                                 : hardwareThreads - 1;
+
+    std::vector<float> values(SCALING_ITEMS);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = static_cast<float>(i % 1000) * 0.01f;
+    }
+    double serial = bestSeconds([&values]() {
+        volatile float sum = work(values, 0, values.size());
+        (void)sum;
+    });
+
+    std::printf("%zu hardware threads, %zu items, serial loop %.2f ms\n\n", hardwareThreads,
+                SCALING_ITEMS, serial * 1e3);
+    std::printf("%8s %14s %14s %12s %12s %9s\n", "workers", "external ns", "internal ns",
+                "chunked ms", "fork-join ms", "speedup");
+    for (size_t workers = 0; workers <= maxWorkers; ++workers) {
+        JobSystem jobs(workers);
+        double    external = externalJobNanoseconds(jobs);
+        double    internal = workers ? internalJobNanoseconds(jobs) : 0.0;
+        double    chunked = chunkedSeconds(jobs, values);
+        double    forked = bestSeconds([&jobs, &values]() {
+            float result = 0.0f;
+            forkJoin(jobs, values, 0, values.size(), result);
+        });
+        std::printf("%8zu %14.1f %14.1f %12.2f %12.2f %8.2fx\n", workers, external, internal,
+                    chunked * 1e3, forked * 1e3, serial / chunked);
+    }
+
+    double parallel = bestSeconds([&values]() {
+        parallelFor(values.size(), SCALING_CHUNK, [&values](size_t begin, size_t end) {
+            volatile float sum = work(values, begin, end);
+            (void)sum;
+        });
+    });
+    std::printf("\nparallelFor on the default pool (%zu workers): %.2f ms, %.2fx\n",
+                JobSystem::getDefault().getWorkerCount(), parallel * 1e3, serial / parallel);
+    return 0;
+}
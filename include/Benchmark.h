@@ -0,0 +1,59 @@
+#pragma once
+
+#include "LoadStats.h"
+#include "struct.h"
+#include <fstream>
+#include <functional>
+
+class Scene;
+
+// Flies the active camera of a scene along a path for a fixed number of frames, each frame at a
+// fixed point of the path so every run renders the same images, and reports per-frame CPU and GPU
+// times, render statistics and memory use as JSON. The path comes from a file of poses or orbits
+// the scene.
+class Benchmark {
+  public:
+    Benchmark(Scene &scene, size_t frameCount);
+
+    // One pose per line, "x y z yaw pitch", spread evenly over the frames; throws on bad files
+    void loadPath(const std::string &path);
+
+    // One turn around the scene bounds, looking at their center
+    void generateOrbit();
+
+    void addLoadStage(const LoadStage &stage);
+
+    // Renders every frame, calling endFrame after each (to swap buffers or poll events).
+    // GPU times are read back a few frames late from a ring of timer queries, so the loop never
+    // waits on the GPU.
+    void run(const std::function<void()> &endFrame);
+
+    void writeReport(const std::string &path, const std::string &model, int width,
+                     int height) const;
+
+  private:
+    static const size_t GPU_QUERY_LATENCY = 4;
+
+    Scene                  &_scene;
+    size_t                  _frameCount;
+    std::string             _pathSource;
+    std::vector<CameraPose> _path;
+    std::vector<LoadStage>  _loadStages;
+
+    std::vector<double> _cpuMilliseconds;
+    std::vector<double> _gpuMilliseconds;
+    std::vector<double> _drawCalls;
+    std::vector<double> _triangles;
+
+    CameraPose _poseAt(size_t frame) const;
+};
+
+// Appends the camera pose of every frame to a file loadPath() can replay
+class CameraRecorder {
+  public:
+    explicit CameraRecorder(const std::string &path);
+    void record(const CameraPose &pose);
+
+  private:
+    std::ofstream _file;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "struct.h"
+#include <functional>
+
+// Best binned surface area heuristic split of the build slots [first, first + count). Shared by
+// Bvh and TriangleBvh, which both keep item boxes and centers permuted along with their items.
+struct SahSplit {
+    int   axis = -1; // -1 when every center coincides and no plane separates them
+    float position = 0.0f;
+    float cost = FLT_MAX;
+};
+
+SahSplit findSahSplit(const std::vector<AABB> &slotBounds, const std::vector<glm::vec3> &centroids,
+                      unsigned int first, unsigned int count);
+
+// Moves the slots whose center lies below the split plane to the front; returns how many did
+unsigned int partitionSlots(const SahSplit &split, unsigned int first, unsigned int count,
+                            std::vector<unsigned int> &items, std::vector<AABB> &slotBounds,
+                            std::vector<glm::vec3> &centroids);
+
+// Bounding volume hierarchy over a set of boxes (one per scene mesh). Nodes live in one flat
+// array with sibling pairs stored next to each other, so children always come after their
+// parent and a reverse sweep refits the whole tree bottom-up.
+class Bvh {
+  public:
+    struct Node {
+        glm::vec3    boundsMin;
+        unsigned int leftFirst; // first child for inner nodes, first item slot for leaves
+        glm::vec3    boundsMax;
+        unsigned int count; // item count of a leaf, 0 for inner nodes
+    };
+
+    Bvh();
+
+    // Surface area heuristic build over binned centroids
+    void build(const std::vector<AABB> &bounds);
+
+    // Updates the boxes of the given items and the boxes above them, keeping the topology
+    void refit(const std::vector<AABB> &bounds, const std::vector<unsigned int> &changedItems);
+
+    // Appends every item whose box touches the frustum
+    void queryFrustum(const Frustum &frustum, std::vector<unsigned int> &items) const;
+
+    // Visits the items whose boxes the ray crosses, nearest node first. The visitor returns the
+    // distance of its own hit (or maxDistance when it has none) which then prunes the traversal.
+    void raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+                 const std::function<float(unsigned int item, float maxDistance)> &visitor) const;
+
+    const std::vector<Node> &getNodes() const;
+    size_t                   getItemCount() const;
+
+  private:
+    std::vector<Node>         _nodes;
+    std::vector<unsigned int> _items;     // item indices, grouped by leaf
+    std::vector<unsigned int> _parents;   // parent node of every node
+    std::vector<unsigned int> _itemLeafs; // leaf node holding every item
+
+    // Item boxes and centers permuted along with _items, only kept during build()
+    std::vector<AABB>      _slotBounds;
+    std::vector<glm::vec3> _centroids;
+
+    // Reads bounds indexed by item when byItem is set, by item slot otherwise
+    void _updateNodeBounds(unsigned int nodeIndex, const std::vector<AABB> &bounds, bool byItem);
+    void _subdivide(unsigned int nodeIndex);
+    void _refitNode(unsigned int nodeIndex, const std::vector<AABB> &bounds);
+};
@@ -18,10 +18,16 @@ class Camera {
     void      processMouseScroll(float yoffset);
     void      setPosition(const glm::vec3 &position);
     glm::vec3 getPosition() const;
+    glm::vec3 getFront() const;
+    void      setOrientation(float yaw, float pitch); // in degrees
+    float     getYaw() const;
+    float     getPitch() const;
+    void      lookAt(const glm::vec3 &target);
     void      setFieldOfView(float fov);
     float     getFieldOfView() const;
     void      setAspectRatio(float aspectRatio);
     float     getAspectRatio() const;
+    float     getNearPlane() const;
 
   private:
     // Camera Attributes
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "struct.h"
+
+// Extracts the six clip planes of a view-projection matrix. Given a model-view-projection matrix
+// the planes come out in that model's object space.
+Frustum extractFrustum(const glm::mat4 &viewProjection);
+
+bool sphereInFrustum(const Frustum &frustum, const glm::vec3 &center, float radius);
+
+enum FrustumTest { FRUSTUM_OUTSIDE, FRUSTUM_INTERSECTS, FRUSTUM_INSIDE };
+
+FrustumTest aabbInFrustum(const Frustum &frustum, const AABB &box);
+
+// Bounds of the box after an affine transform (Arvo's method)
+AABB transformAABB(const AABB &box, const glm::mat4 &matrix);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "struct.h"
+#include <unordered_set>
+
+// Tells which files changed on disk, for hot reloading. Each file is covered by an inotify watch
+// on its directory rather than on the file itself, since editors often save by writing a new file
+// and renaming it over the old one. A file is reported once it is closed after writing or moved
+// into place, so never half written. Without inotify at build time, or when it cannot be
+// initialized, the constructor throws std::runtime_error.
+class FileWatcher {
+  public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // Starts watching a file, which need not exist yet; a path already watched is ignored
+    void watch(const std::string &path);
+    bool isWatched(const std::string &path) const;
+
+    // Files changed since the last call, each once, named as they were given to watch(). Never
+    // blocks.
+    std::vector<std::string> poll();
+
+  private:
+    int                                               _fd;
+    std::unordered_map<int, std::vector<std::string>> _directoryFiles; // watch -> paths in it
+    std::unordered_set<std::string>                   _paths;
+};
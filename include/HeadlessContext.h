@@ -0,0 +1,38 @@
+#pragma once
+
+#include "struct.h"
+
+// OpenGL context without a window or display server, for CI and render nodes: an EGL surfaceless
+// context (Mesa, llvmpipe included) made current on the calling thread, with GLAD loaded, and an
+// offscreen framebuffer of any size to render into. Without EGL at build time, or when no
+// display can be initialized, the constructor throws std::runtime_error.
+class HeadlessContext {
+  public:
+    HeadlessContext(int width, int height);
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext &) = delete;
+    HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+    // Binds the offscreen framebuffer and sets the viewport to cover it
+    void   bind() const;
+    GLuint getFramebuffer() const;
+    int    getWidth() const;
+    int    getHeight() const;
+
+    // Reads the color buffer back and writes it as a binary PPM, top row first
+    void writeImage(const std::string &path) const;
+
+  private:
+    void  *_display; // EGLDisplay
+    void  *_context; // EGLContext
+    GLuint _framebuffer;
+    GLuint _colorBuffer;
+    GLuint _depthBuffer;
+    int    _width;
+    int    _height;
+
+    void _createContext();
+    void _createFramebuffer();
+    void _destroy();
+};
@@ -3,6 +3,7 @@
 #include "struct.h"
 
 class Scene;
+class Camera;
 
 class InputHandler {
   public:
@@ -26,8 +27,13 @@ class InputHandler {
 
     static bool _firstMouse;
 
+    // Set by a left click, consumed by the next processInput
+    static bool _pickRequested;
+
     static std::array<bool, 1024> _keys;
 
     static void mouseCallback(GLFWwindow *window, double xpos, double ypos);
     static void scrollCallback(GLFWwindow *window, double xoffset, double yoffset);
+    static void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods);
+    static void _pick(const Camera &camera);
 };
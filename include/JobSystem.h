@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Jobs of a group still to finish: run() adds one, the end of the job removes it
+class JobCounter {
+  public:
+    JobCounter() : _pending(0) {}
+
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    bool isDone() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+  private:
+    friend class JobSystem;
+
+    std::atomic<size_t> _pending;
+};
+
+// Fixed pool of worker threads, each with a Chase-Lev work-stealing deque. A worker pushes and
+// pops its own jobs at one end, last in first out for locality, while idle workers steal the
+// oldest from the other end. Threads outside the pool queue jobs in a shared list instead. A
+// thread waiting on a counter runs queued jobs meanwhile, so a job can wait on the jobs it
+// depends on without tying up its worker, and a pool with no workers runs everything in wait().
+class JobSystem {
+  public:
+    explicit JobSystem(size_t workerCount);
+
+    // Jobs still queued are dropped; wait on their counters first
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // Shared pool with one worker per hardware thread but the caller's
+    static JobSystem &getDefault();
+
+    // Queues a job, which must not throw. The counter, if any, stays pending until it has run.
+    void run(std::function<void()> job, JobCounter *counter = nullptr);
+
+    // Runs queued jobs until the counter reaches zero
+    void wait(JobCounter &counter);
+
+    size_t getWorkerCount() const;
+
+  private:
+    struct Job {
+        std::function<void()> function;
+        JobCounter           *counter;
+    };
+
+    // Owner pushes and pops at the bottom, thieves take from the top (Lê et al., "Correct and
+    // Efficient Work-Stealing for Weak Memory Models"). A full deque rejects the push.
+    class Deque {
+      public:
+        static const int64_t CAPACITY = 4096; // a power of two
+
+        Deque();
+        bool push(Job *job);
+        Job *pop();
+        Job *steal();
+
+      private:
+        std::atomic<int64_t> _top;
+        std::atomic<int64_t> _bottom;
+        std::atomic<Job *>   _buffer[CAPACITY];
+    };
+
+    std::vector<std::unique_ptr<Deque>> _deques; // one per worker
+    std::vector<std::thread>            _workers;
+    std::deque<Job *>                   _sharedJobs; // queued by threads outside the pool
+    std::mutex                          _sharedMutex;
+
+    // Idle workers sleep until a job is queued; queuedJobs counts jobs not yet taken
+    std::atomic<size_t>     _queuedJobs;
+    std::atomic<size_t>     _sleepingWorkers;
+    std::atomic<bool>       _stopping;
+    std::mutex              _sleepMutex;
+    std::condition_variable _wakeUp;
+
+    static thread_local JobSystem *_threadSystem; // pool the calling thread works for
+    static thread_local size_t     _threadIndex;  // its worker index in that pool
+
+    void _workerLoop(size_t index);
+    Job *_findJob();
+    void _execute(Job *job);
+    void _wakeWorker();
+};
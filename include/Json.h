@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Text as a JSON string literal, quotes included: quotes and backslashes are escaped and control
+// characters become spaces
+std::string jsonString(const std::string &text);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "struct.h"
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Cost of one model loading stage, summed over every interval it ran. Time and allocations are
+// exclusive: a stage nested in another is not counted again in the outer one.
+struct LoadStage {
+    std::string name;
+    double      milliseconds;
+    uint64_t    bytes;       // input consumed or data produced, 0 where it means nothing
+    uint64_t    allocations; // operator new calls of the loading thread, see countsAllocations()
+    long        peakRssKb;   // process resident high-water mark when the stage last ran
+};
+
+// Collects the LoadStageScopes of the loading thread between start() and stop(): wall time,
+// bytes, throughput, allocation count and peak resident memory per stage, in the order stages
+// first started, printed as a table or written as JSON. Scopes anywhere in the import path
+// report to it without being passed a collector.
+class LoadStats {
+  public:
+    LoadStats();
+
+    // Makes this the collector of the calling thread's scopes; stop() before destroying it
+    void start();
+    void stop();
+
+    const std::vector<LoadStage> &getStages() const;
+    double                        getTotalMilliseconds() const; // from start() to stop()
+    uint64_t                      getTotalAllocations() const;
+    long                          getPeakRssKb() const;
+
+    void printSummary(std::ostream &out) const;
+    void writeJson(const std::string &path, const std::string &model) const;
+
+    // operator new calls the calling thread made since it started. Counting replaces the global
+    // operator new, so it is only built in with SCOP_COUNT_ALLOCATIONS; otherwise the counts
+    // stay 0 and the reports leave them out.
+    static uint64_t getAllocationCount();
+    static bool     countsAllocations();
+
+    // Resident high-water mark of the whole process so far
+    static long getProcessPeakRssKb();
+
+  private:
+    friend class LoadStageScope;
+
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<LoadStage> _stages;
+    Clock::time_point      _start;
+    Clock::time_point      _lastMemorySample;
+    double                 _totalMilliseconds;
+    uint64_t               _startAllocations;
+    uint64_t               _totalAllocations;
+    long                   _peakRssKb;
+
+    static thread_local LoadStats *_active;
+
+    size_t _stageIndex(const char *name); // adds the stage on first use
+    void   _sampleMemory(LoadStage &stage, Clock::time_point now, bool force);
+};
+
+// Adds the time, allocations and bytes of the enclosing block to a stage of the active
+// LoadStats. Nested scopes subtract their cost from the enclosing one. Does nothing, not even read
+// the clock, when the thread has no active LoadStats.
+class LoadStageScope {
+  public:
+    // name must outlive the LoadStats, such as a string literal
+    explicit LoadStageScope(const char *name, uint64_t bytes = 0);
+    ~LoadStageScope();
+
+    LoadStageScope(const LoadStageScope &) = delete;
+    LoadStageScope &operator=(const LoadStageScope &) = delete;
+
+    void addBytes(uint64_t bytes);
+
+  private:
+    LoadStats                  *_stats;
+    size_t                      _stage;
+    uint64_t                    _bytes;
+    LoadStats::Clock::time_point _start;
+    uint64_t                    _startAllocations;
+    LoadStats::Clock::duration  _childTime;
+    uint64_t                    _childAllocations;
+    LoadStageScope             *_parent;
+
+    static thread_local LoadStageScope *_current;
+};
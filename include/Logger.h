@@ -0,0 +1,78 @@
+#pragma once
+
+#include "struct.h"
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+// Most to least important; a message is kept when its level is at or above the logger's
+enum LogLevel { LOG_ERROR, LOG_WARNING, LOG_INFO, LOG_VERBOSE };
+
+// Asynchronous log. Threads queue messages in a bounded lock-free ring and a background thread
+// writes them, errors and warnings to stderr and the rest to stdout, so no render or load thread
+// ever waits on the terminal. When the ring is full, messages are dropped and counted rather
+// than waited for. Before start() and after stop(), messages are written directly.
+class Logger {
+  public:
+    // Starts the writer thread
+    static void start(LogLevel level = LOG_INFO);
+
+    // Writes everything still queued and stops the writer thread
+    static void stop();
+
+    static void     setLevel(LogLevel level);
+    static LogLevel getLevel();
+    static bool     isEnabled(LogLevel level);
+
+    // Queues one message, a newline is added. Never blocks while the writer runs.
+    static void write(LogLevel level, std::string message);
+
+    // Messages lost to a full ring since start()
+    static size_t getDroppedCount();
+
+  private:
+    static const size_t RING_SIZE = 4096; // a power of two
+
+    // One message; sequence tells whose turn the slot is (Vyukov's bounded queue)
+    struct Slot {
+        std::atomic<size_t> sequence;
+        LogLevel            level;
+        std::string         message;
+    };
+
+    static Slot                  _ring[RING_SIZE];
+    static std::atomic<size_t>   _enqueuePosition;
+    static size_t                _dequeuePosition; // writer thread only
+    static std::atomic<int>      _level;
+    static std::atomic<size_t>   _state; // RUNNING, plus WRITE_STEP per write() queueing
+    static std::atomic<size_t>   _dropped;
+    static std::thread           _writer;
+
+    static void _enqueue(LogLevel level, std::string &message);
+    static void _writerLoop();
+    static bool _drain(); // writes every queued message, false when there was none
+    static void _output(LogLevel level, const std::string &text);
+};
+
+// Builds a message with operator<< and queues it when destroyed, at the end of the statement:
+// LogMessage(LOG_INFO) << "Loaded " << count << " meshes";
+class LogMessage {
+  public:
+    explicit LogMessage(LogLevel level);
+    ~LogMessage();
+
+    LogMessage(const LogMessage &) = delete;
+    LogMessage &operator=(const LogMessage &) = delete;
+
+    template <typename T> LogMessage &operator<<(const T &value) {
+        if (_enabled) {
+            _stream << value;
+        }
+        return *this;
+    }
+
+  private:
+    LogLevel           _level;
+    bool               _enabled;
+    std::ostringstream _stream;
+};
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "TriangleBvh.h"
 #include "struct.h"
 
 class Mesh {
   public:
+    // Only builds the CPU side, so meshes can be made on any thread; upload() creates the GL
+    // buffers
     Mesh(const std::shared_ptr<std::vector<Vertex>> &vertices,
          const std::vector<unsigned int>            &indices);
 
@@ -17,21 +20,99 @@ class Mesh {
     Mesh(Mesh &&other) noexcept;
     Mesh &operator=(Mesh &&other) noexcept;
 
-    void draw() const;
+    // Sends up to budget bytes of the vertex and then index data to the GPU, continuing where the
+    // previous call stopped, and takes what it sent off budget. Returns true once the mesh can be
+    // drawn. The overload without a budget sends everything left. Needs a GL context.
+    bool upload(size_t &budget);
+    void upload();
+    bool isUploaded() const;
 
-    void                             setModelMatrix(const glm::mat4 &modelMatrix);
-    const glm::mat4                 &getModelMatrix() const;
-    void                             setMaterial(const Material &material);
+    // Simplifies LOD 0 into up to maxLevels - 1 coarser levels; an uploaded index buffer is sent
+    // again
+    void buildLods(size_t maxLevels);
+
+    // Splits LOD 0 into meshlets for per-cluster culling; an uploaded index buffer is sent again
+    void buildMeshlets();
+
+    // Points the per-instance model matrix attributes of the VAO at a buffer of glm::mat4, so
+    // draws pick their transforms from it starting at their base instance
+    void setInstanceBuffer(GLuint instanceBuffer);
+
+    void draw(size_t lod = 0, unsigned int instanceCount = 1, unsigned int baseInstance = 0) const;
+
+    // Draws the LOD 0 meshlets of one instance that survive frustum and normal cone culling in
+    // one multi-draw
+    void drawMeshlets(const glm::mat4 &modelMatrix, const glm::mat4 &viewProjection,
+                      const glm::vec3 &cameraPosition, unsigned int baseInstance,
+                      RenderStats &stats) const;
+
+    // Builds the triangle hierarchy raycast() searches, which the model loader does on its
+    // thread; buildMeshlets() reorders the triangles and drops it
+    void buildTriangleBvh();
+
+    // Nearest LOD 0 triangle hit by an object-space ray, building the triangle hierarchy first
+    // when buildTriangleBvh() was not called. hit.triangle indexes the triangles of getIndices().
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+                 TriangleBvh::Hit &hit) const;
+
+    void                             setMaterial(const Material &material, const std::string &name);
     const std::vector<Vertex>       &getVertices() const;
     const std::vector<unsigned int> &getIndices() const;
     const Material                  &getMaterial() const;
+    const std::string               &getMaterialName() const; // empty without one
+    GLenum                           getIndexType() const;
+    const std::vector<DrawRange>    &getDrawRanges(size_t lod = 0) const;
+    size_t                           getLodCount() const;
+    float                            getLodError(size_t lod) const;
+    size_t                           getTriangleCount(size_t lod = 0) const;
+    const BoundingSphere            &getBoundingSphere() const;
+    const AABB                      &getBounds() const;
+    const std::vector<Meshlet>      &getMeshlets() const;
 
   private:
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint  baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Meshlet bounds laid out as structure of arrays, which lets GCC vectorize the culling passes
+    // at -O3
+    struct MeshletCullData {
+        std::vector<float> centerX, centerY, centerZ, radius;
+        std::vector<float> apexX, apexY, apexZ;
+        std::vector<float> axisX, axisY, axisZ, cutoff;
+    };
+
     std::shared_ptr<std::vector<Vertex>> _vertices;
-    std::vector<unsigned int>            _indices;
+    std::vector<LodLevel>                _lods;
     Material                             _material;
+    std::string                          _materialName;
     unsigned int                         _VAO, _VBO, _EBO;
-    glm::mat4                            _modelMatrix;
+    unsigned int                         _indirectBuffer; // meshlet draw commands
+    GLenum                               _indexType;
+    AABB                                 _bounds;
+    BoundingSphere                       _boundingSphere;
+    std::vector<Meshlet>                 _meshlets;
+    MeshletCullData                      _meshletCullData;
+    std::vector<DrawRange>               _meshletRanges;       // LOD 0 ranges of every meshlet
+    std::vector<unsigned int>            _meshletRangeOffsets; // meshlet i -> its _meshletRanges
+    mutable std::unique_ptr<TriangleBvh> _triangleBvh;         // null until built
+
+    // Every LOD back to back as the index buffer will hold them, until upload() is done with it
+    std::vector<unsigned char> _indexData;
+    size_t                     _uploadedBytes; // of the vertices, then of _indexData
+    bool                       _uploaded;
+
+    // Per-frame scratch for drawMeshlets, kept to avoid reallocating every frame
+    mutable std::vector<unsigned char>               _meshletVisibility;
+    mutable std::vector<DrawElementsIndirectCommand> _indirectCommands;
 
-    void _setupMesh();
+    void   _computeBounds();
+    void   _createBuffers();
+    void   _buildIndexData();
+    void   _updateIndices();
+    size_t _getVertexBytes() const;
 };
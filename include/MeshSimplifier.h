@@ -0,0 +1,49 @@
+#pragma once
+
+#include "struct.h"
+
+// Quadric error metric edge-collapse simplifier. Vertices on open borders (which includes the
+// edges between two materials, since each SubMesh is simplified on its own) and on UV/normal
+// seams are locked so that simplified levels keep the same silhouette and texture layout.
+class MeshSimplifier {
+  public:
+    MeshSimplifier(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices);
+
+    // Collapses edges until at most targetIndexCount indices remain or the cheapest collapse
+    // would exceed maxError. Successive calls continue from the previous result, so a LOD chain
+    // is built by calling it with decreasing targets.
+    std::vector<unsigned int> simplify(size_t targetIndexCount, float maxError);
+
+    // Object-space distance error of the last simplify() result, relative to the input mesh
+    float getError() const;
+
+  private:
+    struct Quadric {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+        double w; // total area of the merged planes
+    };
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        double       cost;
+    };
+
+    const std::vector<Vertex> &_vertices;
+    std::vector<unsigned int>  _indices;
+    std::vector<unsigned int>  _positionIds;
+    std::vector<bool>          _locked;
+    std::vector<Quadric>       _quadrics;
+    double                     _error;
+
+    void   _classifyVertices();
+    void   _computeQuadrics();
+    bool   _collapsePass(size_t targetTriangleCount, double maxError);
+    bool   _flipsTriangles(unsigned int from, unsigned int to,
+                           const std::vector<unsigned int> &adjacencyOffsets,
+                           const std::vector<unsigned int> &adjacency,
+                           const std::vector<unsigned int> &remap) const;
+    double _collapseCost(unsigned int from, unsigned int to) const;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "struct.h"
+
+class MeshletBuilder {
+  public:
+    static const size_t MAX_VERTICES = 64;
+    static const size_t MAX_TRIANGLES = 124;
+
+    // Greedily grows clusters along shared vertices and reorders `indices` in place so that each
+    // meshlet's triangles are contiguous
+    static std::vector<Meshlet> build(const std::vector<Vertex> &vertices,
+                                      std::vector<unsigned int> &indices);
+
+  private:
+    static void _computeBounds(const std::vector<Vertex> &vertices,
+                               const std::vector<unsigned int> &indices, Meshlet &meshlet);
+};
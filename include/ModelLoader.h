@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Texture.h"
+#include "struct.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+// Progress of one model given to Scene::loadModel or Scene::loadModelAsync, shared by the loader,
+// the scene and the caller. Read it from the render thread.
+class ModelLoad {
+  public:
+    enum State { LOADING, DONE, FAILED };
+
+    // The model is placed once at each transform
+    ModelLoad(const std::string &path, const std::vector<glm::mat4> &placements);
+
+    const std::string &getPath() const;
+    State              getState() const;
+    bool               isFinished() const; // DONE, every object in the scene, or FAILED
+    std::string        getError() const;   // why it FAILED
+
+    // Objects of the OBJ file, 0 until it is parsed, and how many of them are in the scene
+    size_t getObjectCount() const;
+    size_t getObjectsAdded() const;
+
+    // Scene graph node of each placement, which the objects hang under; empty until the first
+    // object is added
+    const std::vector<unsigned int> &getRootNodes() const;
+
+    // The OBJ file and the .mtl files it names; complete once the model is finished
+    const std::vector<std::string> &getFiles() const;
+
+  private:
+    friend class ModelLoader;
+    friend class Scene;
+
+    // Object of the model in the scene: its node under each root, and how many of the instances
+    // of each node show its meshes, the others being left over from a reload
+    struct Object {
+        std::string               name;
+        std::vector<unsigned int> nodes;
+        size_t                    meshCount;
+    };
+
+    std::string               _path;
+    std::vector<glm::mat4>    _placements;
+    std::atomic<int>          _state;
+    std::atomic<size_t>       _objectCount;
+    size_t                    _objectsAdded;
+    std::vector<unsigned int> _rootNodes;
+    std::vector<int>          _textures; // loader TextureCache index -> scene TextureCache index
+    std::vector<std::string>  _files;
+    std::vector<Object>       _objects;
+    mutable std::mutex        _errorMutex;
+    std::string               _error;
+
+    // Hot reload. A reload takes over the roots and objects of the model it replaces, which stays
+    // in the scene until the reload is done; it does not decode the textures the scene already
+    // has. A change during a reload triggers another one after it.
+    std::shared_ptr<ModelLoad>      _previous;
+    std::vector<Object>             _unclaimed; // objects of _previous not reloaded yet
+    std::unordered_set<std::string> _loadedTextures;
+    bool                            _reloading;
+    bool                            _reloadPending;
+
+    void _fail(const std::string &error);
+};
+
+typedef std::shared_ptr<ModelLoad> ModelHandle;
+
+// Piece of a model that is ready for the render thread. The textures of a model come first, in
+// the order its TextureCache indexed them, then its objects, then END. A texture requested alone
+// for a reload comes as a TEXTURE without a model.
+struct ModelPart {
+    enum Type { TEXTURE, OBJECT, END };
+
+    Type                               type;
+    ModelHandle                        load;
+    std::string                        name;   // texture path or object name
+    TextureImage                       image;  // TEXTURE, without pixels when decoding failed
+    std::vector<std::shared_ptr<Mesh>> meshes; // OBJECT, not uploaded yet
+
+    ModelPart(Type partType, const ModelHandle &model, const std::string &partName);
+};
+
+// Does the part of loading OBJ models that needs no GL context: parsing, building the meshes
+// with their LODs and meshlets, and decoding the textures. Each part is queued as soon as it is
+// ready, for the render thread to poll(), upload and add to the scene. Models requested with
+// request() load in parallel on the loader's threads, started as they are needed. A texture file
+// several models use at the same time is decoded once and its pixels shared.
+class ModelLoader {
+  public:
+    ModelLoader();
+    ~ModelLoader(); // drops the requests not started and waits for the models in progress
+
+    ModelLoader(const ModelLoader &) = delete;
+    ModelLoader &operator=(const ModelLoader &) = delete;
+
+    void request(const ModelHandle &load);
+
+    // Decodes a texture file again, on a loader thread, ahead of the models waiting
+    void requestTexture(const std::string &path);
+
+    // Loads on the calling thread instead; every part is queued when it returns
+    void load(const ModelHandle &load);
+
+    // Oldest part ready, null when there is none
+    std::unique_ptr<ModelPart> poll();
+
+    // Blocks until a part is ready; only call it while some model is loading
+    void waitForPart();
+
+    // Models loaded at the same time, at most; threads already running are kept
+    void   setThreadCount(size_t threadCount);
+    size_t getThreadCount() const;
+
+  private:
+    std::vector<std::thread>               _threads;
+    size_t                                 _threadCount;
+    size_t                                 _idleThreads;
+    std::mutex                             _mutex;
+    std::condition_variable                _wakeUp;
+    std::condition_variable                _partReady;
+    std::deque<ModelHandle>                _requests;
+    std::deque<std::string>                _textureRequests;
+    std::deque<std::unique_ptr<ModelPart>> _parts;
+    std::atomic<bool>                      _stopping;
+
+    // Decoded or being decoded, by path, while any model is loading
+    std::mutex                                                        _imageMutex;
+    std::unordered_map<std::string, std::shared_future<TextureImage>> _images;
+    size_t                                                            _activeLoads;
+
+    void         _startThread(); // or wakes one up
+    void         _threadLoop();
+    void         _load(const ModelHandle &load);
+    TextureImage _decode(const std::string &path);
+    void         _push(std::unique_ptr<ModelPart> part);
+};
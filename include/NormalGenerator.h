@@ -0,0 +1,27 @@
+#pragma once
+
+#include "struct.h"
+
+// Builds the per-vertex shading frame: smooth normals for vertices that came without one, and
+// tangents for normal mapping. Each triangle corner gathers the
+// angle-weighted face normals of the triangles around its position that are in the same smoothing
+// group and within the crease angle, so no two threads ever write the same normal.
+class NormalGenerator {
+  public:
+    // positionIds tells which vertices share a position (UV seams are smoothed across), needsNormal
+    // which vertices to fill in, and smoothingGroups the OBJ group of every triangle, 0 for flat.
+    // Vertices whose corners end up with different normals are split and indices rewritten.
+    static void generate(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                         const std::vector<unsigned int>  &positionIds,
+                         const std::vector<unsigned char> &needsNormal,
+                         const std::vector<unsigned int> &smoothingGroups, float creaseAngle);
+
+    // Fills Vertex::tangent from the texture coordinates; normals must already be set. The w
+    // component is the bitangent sign, and vertices on a UV mirror seam are split.
+    static void generateTangents(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+
+  private:
+    static void _splitVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                               const std::vector<unsigned char> &needsNormal,
+                               const std::vector<glm::vec3>     &cornerNormals);
+};
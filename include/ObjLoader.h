@@ -1,30 +1,57 @@
 #pragma once
 
 #include "struct.h"
+#include <cstdint>
+#include <sstream>
+
+class TextureCache;
 
 class ObjLoader {
   public:
-    explicit ObjLoader(const std::string &filePath);
+    // Texture maps of the materials are registered in textures, which their indices refer to
+    ObjLoader(const std::string &filePath, TextureCache &textures);
 
     const std::vector<ObjObject>      &getObjects() const;
     std::vector<std::shared_ptr<Mesh>> getMeshes() const;
 
+    // .mtl files the OBJ named with mtllib, whether they could be read or not
+    const std::vector<std::string> &getMaterialFiles() const;
+
+    // Meshes of one object, one per material, sharing the object's vertex buffer
+    std::vector<std::shared_ptr<Mesh>> getObjectMeshes(size_t objectIndex) const;
+
   private:
+    TextureCache                                 &_textures;
     std::vector<glm::vec3>                        _positions;
     std::vector<glm::vec3>                        _normals;
     std::vector<glm::vec2>                        _texCoords;
     std::vector<ObjObject>                        _objects;
     std::unordered_map<std::string, unsigned int> _vertexCache;
     std::unordered_map<std::string, Material>     _materials;
+    std::vector<std::string>                      _materialFiles;
     std::string                                   _currentMaterialName;
+    std::string                                   _currentObjectName; // from the last `o`
+    unsigned int                                  _currentSmoothingGroup;
+
+    // Per vertex and per triangle of the current object, to generate missing normals
+    std::vector<unsigned int>  _vertexPositionIds;
+    std::vector<unsigned char> _vertexNeedsNormal;
+    std::vector<unsigned int>  _triangleSmoothingGroups;
     SubMesh                                       _currentSubMesh;
     ObjObject                                     _currentObject;
 
     void         _parseObjFile(const std::string &filePath);
     void         _startNewObject();
+    void         _finishObject();
+    void         _generateNormals();
+    bool         _needsTangents() const;
+    std::vector<unsigned int> _gatherIndices() const;
+    void                      _scatterIndices(const std::vector<unsigned int> &indices);
     void         _processFaceData(const std::vector<std::string> &data);
     unsigned int _parseIndex(const std::string &index, size_t size) const;
-    unsigned int _addVertex(const std::string &key, const glm::vec3 &pos, const glm::vec3 &normal,
+    unsigned int _addVertex(const glm::vec3 &pos, const glm::vec3 &normal,
                             const glm::vec2 &texCoords);
     void _loadMaterialFile(const std::string &objFilePath, const std::string &mtllibFilename);
+    void _parseTextureStatement(std::istringstream &lineStream, const std::string &mtlParentPath,
+                                Material &material, MaterialMap map);
 };
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Runs body(begin, end) on contiguous chunks of [0, count) as jobs of the default JobSystem, and
+// returns once all of them are done. There are a few chunks per thread so that workers finishing
+// early steal the rest, but chunks never get smaller than minChunk items; when that leaves a
+// single chunk it runs on the calling thread. The caller runs chunks too while it waits, so
+// bodies may call parallelFor themselves. Bodies must not throw.
+void parallelFor(size_t count, size_t minChunk,
+                 const std::function<void(size_t begin, size_t end)> &body);
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "struct.h"
+#include <chrono>
+#include <cstdint>
+
+// Named CPU and GPU timings of the sections of each frame. CPU times come from a steady clock,
+// GPU times from glQueryCounter timestamps, which unlike GL_TIME_ELAPSED queries may nest. The
+// queries of a frame are read back FRAME_LATENCY frames later, when the GPU is long done with
+// them, so reading never stalls; while a frame's results are somehow not ready yet it stays
+// pending and the frames that would reuse its queries are not profiled.
+class Profiler {
+  public:
+    static const size_t FRAME_LATENCY = 4;
+
+    // One section of the last frame read back, in the order sections began
+    struct Timing {
+        const char  *name;
+        unsigned int depth; // nesting level, 0 for the whole frame
+        double       cpuMilliseconds;
+        double       gpuMilliseconds;
+    };
+
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    // Open and close the "frame" section every other section nests in. Sections outside a frame
+    // are ignored.
+    void beginFrame();
+    void endFrame();
+
+    // name must outlive the profiler, such as a string literal. Prefer ProfileScope.
+    void beginScope(const char *name);
+    void endScope();
+
+    // Reads back the frames still in flight, waiting for the GPU; for the end of a run
+    void flush();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    const std::vector<Timing> &getTimings() const;
+
+    // Keeps every frame read back from now on for writeTrace
+    void startCapture();
+
+    // Writes the captured frames as Chrome trace events (chrome://tracing, Perfetto), CPU and
+    // GPU sections on separate tracks of a shared timeline
+    void writeTrace(const std::string &path) const;
+
+  private:
+    static const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+    struct Section {
+        const char  *name;
+        unsigned int depth;
+        int64_t      cpuBegin, cpuEnd; // nanoseconds since _epoch
+    };
+
+    struct Frame {
+        std::vector<Section> sections;
+        std::vector<GLuint>  queries; // begin and end timestamps of each section
+        bool                 pending = false;
+    };
+
+    struct TraceEvent {
+        const char *name;
+        bool        gpu;
+        int64_t     begin, end; // nanoseconds since _epoch
+    };
+
+    bool                                  _enabled;
+    bool                                  _inFrame;
+    bool                                  _capturing;
+    size_t                                _frameIndex;
+    Frame                                 _frames[FRAME_LATENCY];
+    std::vector<unsigned int>             _openSections;
+    std::vector<Timing>                   _timings;
+    std::vector<TraceEvent>               _trace;
+    std::chrono::steady_clock::time_point _epoch;
+    int64_t _gpuOffset; // GPU timestamp minus CPU time, to put both on one timeline
+    bool    _gpuOffsetSet;
+
+    int64_t     _now() const;
+    bool        _readBack(Frame &frame); // false, and the frame stays pending, if not ready
+    static bool _isAvailable(GLuint query);
+};
+
+// Times the enclosing block as one section
+class ProfileScope {
+  public:
+    ProfileScope(Profiler &profiler, const char *name) : _profiler(profiler) {
+        _profiler.beginScope(name);
+    }
+    ~ProfileScope() { _profiler.endScope(); }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+  private:
+    Profiler &_profiler;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Profiler.h"
+#include "struct.h"
+
+class Shader;
+
+// Draws the last timings of a Profiler over the current framebuffer: one line per section,
+// indented by nesting depth, with CPU and GPU milliseconds and a bar as long as the GPU time.
+// Text uses a built-in 3x5 pixel font, so no font file or library is needed.
+class ProfilerOverlay {
+  public:
+    ProfilerOverlay();
+    ~ProfilerOverlay();
+
+    ProfilerOverlay(const ProfilerOverlay &) = delete;
+    ProfilerOverlay &operator=(const ProfilerOverlay &) = delete;
+
+    // Loads the shaders on first use; throws std::runtime_error when they fail to build
+    void draw(const Profiler &profiler);
+
+  private:
+    struct OverlayVertex {
+        glm::vec2    position; // pixels from the top-left corner
+        glm::vec2    cell;     // 0..1 across the glyph
+        glm::vec3    color;
+        unsigned int glyph; // 3x5 bitmap, bit 14 is the top-left pixel
+    };
+
+    std::unique_ptr<Shader>    _shader;
+    unsigned int               _vao;
+    unsigned int               _vbo;
+    size_t                     _vboCapacity; // in vertices
+    std::vector<OverlayVertex> _vertices;
+
+    void _load();
+    void _addQuad(float x, float y, float width, float height, const glm::vec3 &color,
+                  unsigned int glyph);
+    void _addText(float x, float y, const std::string &text, const glm::vec3 &color);
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Maps a float to an unsigned key with the same order, negative values and -0 included
+uint32_t floatToSortableKey(float value);
+
+// Stable sort of values by their 32-bit keys, both reordered together: least significant digit
+// first, 8 bits per pass. Each pass histograms and scatters contiguous chunks in parallel; the
+// offsets of every chunk come from one prefix sum over all chunk histograms, so equal keys keep
+// their order. Passes where all keys share the digit are skipped.
+void radixSort(std::vector<uint32_t> &keys, std::vector<unsigned int> &values);
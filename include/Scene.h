@@ -1,12 +1,20 @@
 #pragma once
 
+#include "Bvh.h"
+#include "ModelLoader.h"
+#include "Profiler.h"
+#include "SceneGraph.h"
+#include "TextureCache.h"
 #include "struct.h"
 
 // Forward declarations
 class Shader;
+class ShaderPermutations;
 class Camera;
 class Mesh;
 class Texture;
+class ProfilerOverlay;
+class FileWatcher;
 
 class Scene {
   public:
@@ -16,9 +24,79 @@ class Scene {
     Scene(const Scene &) = delete;
     Scene &operator=(const Scene &) = delete;
 
-    void addMesh(const std::shared_ptr<Mesh> &mesh);
+    // Places one instance of the mesh; move it afterwards with setInstanceTransform()
+    size_t addMesh(const std::shared_ptr<Mesh> &mesh, const glm::mat4 &transform = glm::mat4(1.0f));
+
+    // Places a copy of a mesh. Only the instance record is stored: every instance of a mesh shares
+    // its geometry and is drawn in the same instanced draw when it uses the same material and LOD.
+    // This overload gives the instance its own root node with the transform as local transform.
+    size_t addInstance(const std::shared_ptr<Mesh> &mesh, const glm::mat4 &transform,
+                       int material = -1,
+                       unsigned int flags = INSTANCE_VISIBLE | INSTANCE_PICKABLE);
+
+    // Places a copy of a mesh that follows an existing scene graph node
+    size_t addInstance(const std::shared_ptr<Mesh> &mesh, unsigned int node, int material = -1,
+                       unsigned int flags = INSTANCE_VISIBLE | INSTANCE_PICKABLE);
+
+    // Loads an OBJ model and places it at each transform under a new root node, with a child node
+    // per object or group so that parts can be moved on their own. Placements share the meshes,
+    // and materials equal to ones already in the scene share their entry. Returns once the model
+    // is in the scene; failures are logged and reported by the handle.
+    ModelHandle loadModel(const std::string &path, const std::vector<glm::mat4> &placements =
+                                                       std::vector<glm::mat4>(1, glm::mat4(1.0f)));
+
+    // Same, but parsing, mesh building and texture decoding happen on loader threads, several
+    // models at a time, and the call returns at once. update() uploads what is ready within the
+    // upload budget and adds each object as soon as its meshes are on the GPU, so the model
+    // appears piece by piece.
+    ModelHandle loadModelAsync(const std::string &path,
+                               const std::vector<glm::mat4> &placements =
+                                   std::vector<glm::mat4>(1, glm::mat4(1.0f)));
+
+    // Waits for every model loading in the background and uploads the rest of them at once
+    void finishLoading();
+
+    // Bytes update() may send to the GPU per frame for models loading in the background. Meshes
+    // are sent in slices; a texture goes whole once some budget is left.
+    void   setUploadBudget(size_t bytesPerFrame);
+    size_t getUploadBudget() const;
+    size_t getLoadingModelCount() const;
+
+    // Models parsed at the same time by loadModelAsync, at most
+    void   setLoaderThreadCount(size_t threadCount);
+    size_t getLoaderThreadCount() const;
+
+    // Watches the files of the scene's shaders, models and textures, those added later included,
+    // and reloads in update() whatever changed on disk. A shader is recompiled and swapped in by
+    // a later update() once linked; a model is parsed again in the background and its new meshes
+    // swapped in under the same nodes, object by object as they upload; a texture is decoded
+    // again in the background and replaced in the cache. Until a reload succeeds the old resource
+    // stays. Throws std::runtime_error when files cannot be watched.
+    void setHotReloadEnabled(bool enabled);
+    bool isHotReloadEnabled() const;
+
+    // Registers a material instances can use in place of their mesh's own and returns its index;
+    // a material equal to one already registered gets that one's index
+    size_t addMaterial(const Material &material);
+
+    // Textures the materials of this scene's meshes refer to; give it to ObjLoader
+    TextureCache       &getTextureCache();
+    const TextureCache &getTextureCache() const;
+
+    // Sets the local transform of the instance's node, moving every instance attached to it
+    void            setInstanceTransform(size_t instance, const glm::mat4 &transform);
+    void            setInstanceMaterial(size_t instance, int material);
+    void            setInstanceFlags(size_t instance, unsigned int flags);
+    const Instance &getInstance(size_t instance) const;
+    size_t          getInstanceCount() const;
+
     void addTexture(const std::shared_ptr<Texture> &texture);
     void addShader(const std::shared_ptr<Shader> &shader);
+
+    // Program variants meshes are drawn with, each material getting the cheapest one: only the
+    // texture maps that bound and the lighting its illum asks for. Without them the first shader
+    // given to addShader draws every material.
+    void setMaterialShaders(const std::shared_ptr<ShaderPermutations> &shaders);
     void addCamera(const std::shared_ptr<Camera> &camera);
 
     void setActiveCamera(size_t index);
@@ -28,16 +106,178 @@ class Scene {
     std::shared_ptr<Camera>               getActiveCamera() const;
     std::vector<std::shared_ptr<Camera>> &getCameras();
 
-    void update(float deltaTime);
+    void setViewportSize(int width, int height);
+
+    // Framebuffer render() draws into and leaves bound; 0, the default, is the window
+    void setTargetFramebuffer(GLuint framebuffer);
+    void setLodEnabled(bool enabled);
+    bool isLodEnabled() const;
+    void setMeshletCullingEnabled(bool enabled);
+    bool isMeshletCullingEnabled() const;
+
+    // Transparent instances are drawn back to front after the opaque ones by default. Weighted
+    // blended OIT instead accumulates them in any order into an offscreen target, which skips the
+    // sort and per-instance draws at the cost of approximate ordering.
+    void setWeightedOitEnabled(bool enabled);
+    bool isWeightedOitEnabled() const;
+
+    // render() times its clear, culling, opaque and transparent passes here; the caller opens and
+    // closes the frames around it
+    Profiler &getProfiler();
+
+    // Draws the profiler timings over the frame at the end of render()
+    void setProfilerOverlayEnabled(bool enabled);
+    bool isProfilerOverlayEnabled() const;
+
+    SceneGraph       &getSceneGraph();
+    const SceneGraph &getSceneGraph() const;
+
+    const RenderStats &getRenderStats() const;
+    const Bvh         &getBvh() const;
+
+    // World bounds of every instance, empty for an empty scene
+    AABB getBounds();
+
+    // Nearest triangle along a world-space ray: mesh boxes through the scene hierarchy, then the
+    // triangle hierarchy of each candidate mesh in its object space
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, RaycastHit &hit,
+                 float maxDistance = FLT_MAX);
+
+    // Uploads the parts of loading models and propagates scene graph changes to the instances;
+    // render() and raycast() also do the latter
+    void update();
     void render();
 
   private:
-    std::vector<std::shared_ptr<Mesh>>    _meshes;
+    // Instances of one mesh and LOD with the same material, drawn together
+    struct DrawItem {
+        unsigned int mesh;
+        int          material;
+        unsigned int lod;
+        unsigned int instance;
+        unsigned int features; // of the material's shader variant, sorted on first
+    };
+
+    // Program drawing materials of some features, with the handles of the uniforms it is given
+    struct MaterialShader {
+        std::shared_ptr<Shader> shader;
+        int                     view, projection, viewPosition, lightDirection;
+        int                     mapTextures[MAP_COUNT]; // sampler of each slot
+    };
+
+    std::vector<std::shared_ptr<Mesh>>             _meshes; // every mesh with instances, once
+    std::unordered_map<const Mesh *, unsigned int> _meshIds;
+    std::vector<Instance>                          _instances;
+    std::vector<Material>                          _materials;
+    std::unordered_map<std::string, size_t>        _materialIndices; // by the material's bytes
+    TextureCache                                   _textureCache;
+
+    SceneGraph                             _sceneGraph;
+    std::vector<std::vector<unsigned int>> _nodeInstances; // node -> instances following it
+    std::vector<unsigned int>              _changedNodes;
     std::vector<std::shared_ptr<Texture>> _textures;
     std::vector<std::shared_ptr<Shader>>  _shaders;
     std::vector<std::shared_ptr<Camera>>  _cameras;
 
+    // Material shader variants by feature bits, with a null shader for one that failed to build
+    std::shared_ptr<ShaderPermutations>              _materialShaders;
+    std::unordered_map<unsigned int, MaterialShader> _shaderVariants;
+
     size_t _activeCameraIndex;
 
-    void _renderMeshes();
+    GLuint      _targetFramebuffer;
+    int         _viewportWidth;
+    int         _viewportHeight;
+    bool        _lodEnabled;
+    bool        _meshletCullingEnabled;
+    bool        _weightedOitEnabled;
+    bool        _profilerOverlayEnabled;
+    float       _lodPixelThreshold;
+    RenderStats _stats;
+
+    Profiler                         _profiler;
+    std::unique_ptr<ProfilerOverlay> _profilerOverlay;
+
+    // Models loading in the background, and the part update() is uploading
+    ModelLoader                _modelLoader;
+    std::unique_ptr<ModelPart> _uploadPart;
+    size_t                     _uploadBudget; // bytes per frame
+    size_t                     _loadingModels;
+    size_t                     _reloadingTextures;
+    std::vector<ModelHandle>   _models; // loaded, each replaced by its latest reload
+
+    std::unique_ptr<FileWatcher> _fileWatcher; // null unless hot reload is enabled
+
+    // Shaders whose reload is linking, with the file that changed
+    std::vector<std::pair<std::shared_ptr<Shader>, std::string>> _reloadingShaders;
+
+    // Hierarchy over the world bounds of _instances, rebuilt when instances are added and refit
+    // when they move
+    Bvh                        _bvh;
+    bool                       _bvhDirty;
+    std::vector<AABB>          _instanceBounds;
+    std::vector<unsigned char> _instanceMoved;
+    std::vector<unsigned int>  _changedInstances;
+    std::vector<unsigned int>  _visibleInstances;
+
+    // Model matrices of the visible instances, grouped by draw batch and streamed every frame
+    unsigned int           _instanceBuffer;
+    size_t                 _instanceBufferCapacity; // in matrices
+    std::vector<glm::mat4> _instanceData;
+    std::vector<DrawItem>  _drawItems;       // opaque batches, then the transparent queue
+    size_t                 _opaqueItemCount; // start of the transparent queue in _drawItems
+
+    // Transparent queue scratch: view depth keys and the order radix sorting them gives
+    std::vector<DrawItem>     _transparentItems;
+    std::vector<uint32_t>     _depthKeys;
+    std::vector<unsigned int> _depthOrder;
+
+    // Weighted blended OIT accumulation target, sized like the viewport on first use
+    unsigned int            _oitFramebuffer;
+    unsigned int            _oitAccumTexture;     // RGBA16F, premultiplied color and weight
+    unsigned int            _oitRevealageTexture; // R16F, product of (1 - alpha)
+    unsigned int            _oitDepthBuffer;
+    int                     _oitWidth, _oitHeight;
+    unsigned int            _emptyVao; // fullscreen triangle, generated in the vertex shader
+    std::shared_ptr<Shader> _oitCompositeShader;
+
+    // MaterialBlock of the material shaders, rewritten whenever the drawn material changes
+    unsigned int _materialBuffer;
+
+    void   _registerMesh(const std::shared_ptr<Mesh> &mesh);
+    void   _releaseUnusedMeshes();
+    void   _uploadModels(size_t budget);
+    bool   _uploadModelPart(ModelPart &part, size_t &budget);
+    void   _reloadTexture(ModelPart &part);
+    void   _addModelObject(ModelLoad &load, const ModelPart &part,
+                           const std::vector<int> &materials);
+    void   _finishModel(const ModelHandle &load);
+    void   _watchFiles();
+    void   _reloadChangedFiles();
+    void   _finishShaderReloads();
+    void   _forgetFailedVariants();
+    void   _reloadModel(const ModelHandle &model);
+    void   _updateTransforms();
+    void   _markInstanceMoved(size_t instance);
+    void   _updateBvh();
+    size_t _selectLod(const Mesh &mesh, const glm::mat4 &transform, const Camera &camera) const;
+    void   _buildDrawItems(const Camera &camera);
+    void   _uploadInstances();
+    bool   _isTransparent(const DrawItem &item) const;
+    void   _renderMeshes();
+    void   _drawItemRange(size_t begin, size_t end, const Camera &camera, bool weightedOit);
+    bool   _createOitTargets();
+    void   _deleteOitTargets();
+    bool   _beginWeightedOit();
+    void   _compositeWeightedOit();
+
+    std::vector<std::shared_ptr<Shader>> _getAllShaders() const;
+
+    const MaterialShader *_getMaterialShader(unsigned int features);
+    const MaterialShader &_cacheMaterialShader(unsigned int                   features,
+                                               const std::shared_ptr<Shader> &shader);
+    void                  _setFrameUniforms(const MaterialShader &shader,
+                                            const Camera         &camera) const;
+    unsigned int          _bindMaterialMaps(const Material &material) const;
+    void                  _uploadMaterial(const Material &material) const;
 };
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "struct.h"
+#include <climits>
+
+// Transform hierarchy stored as flat arrays indexed by node. A node is always created after its
+// parent, so parents come before their children and one forward pass over the arrays updates
+// world matrices top-down. Only nodes whose local transform changed, and their descendants, are
+// recomputed.
+class SceneGraph {
+  public:
+    static const unsigned int NO_PARENT = UINT_MAX;
+
+    SceneGraph();
+
+    unsigned int createNode(unsigned int parent = NO_PARENT,
+                            const glm::mat4 &localTransform = glm::mat4(1.0f),
+                            const std::string &name = "");
+
+    void               setLocalTransform(unsigned int node, const glm::mat4 &localTransform);
+    const glm::mat4   &getLocalTransform(unsigned int node) const;
+    const glm::mat4   &getWorldTransform(unsigned int node) const; // as of the last update()
+    unsigned int       getParent(unsigned int node) const;
+    const std::string &getName(unsigned int node) const;
+    size_t             getNodeCount() const;
+
+    // Recomputes the world matrices of dirty subtrees and appends every node it touched
+    void update(std::vector<unsigned int> &changedNodes);
+
+  private:
+    std::vector<unsigned int>  _parents;
+    std::vector<glm::mat4>     _localTransforms;
+    std::vector<glm::mat4>     _worldTransforms;
+    std::vector<unsigned char> _dirty;
+    std::vector<std::string>   _names;
+    size_t                     _firstDirty; // nodes before it are all clean
+
+    void _checkNode(unsigned int node) const;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "struct.h"
+
+// Models, their placements and the cameras of a scene, read from a text file with one statement
+// per line:
+//   model <name> <path>                   OBJ file, relative to the manifest; may contain spaces
+//   instance <name> <x y z> [<yaw pitch roll> [<scale> | <sx sy sz>]]    angles in degrees
+//   camera <x y z> <yaw> <pitch>
+// Blank lines and # comments are skipped. Each model is loaded once however many instances it
+// has; one without instance lines is placed once at the origin.
+class SceneManifest {
+  public:
+    struct Model {
+        std::string            name;
+        std::string            path;
+        std::vector<glm::mat4> placements;
+    };
+
+    // Throws std::runtime_error, with the line, on anything it does not understand
+    explicit SceneManifest(const std::string &path);
+
+    const std::vector<Model>      &getModels() const;
+    const std::vector<CameraPose> &getCameras() const;
+
+  private:
+    std::vector<Model>      _models;
+    std::vector<CameraPose> _cameras;
+
+    void _parseLine(const std::string &line, const std::string &directory);
+};
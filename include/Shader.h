@@ -2,9 +2,12 @@
 #pragma once
 
 #include "struct.h"
+#include <cstdint>
+#include <unordered_set>
 
 typedef unsigned int GLenum;
 typedef int          GLint;
+typedef unsigned int GLuint;
 
 class Shader {
   public:
@@ -19,13 +22,75 @@ class Shader {
     Shader(Shader &&other) noexcept;
     Shader &operator=(Shader &&other) noexcept;
 
-    void addShaderFromFile(const std::string &filePath, GLenum shaderType);
+    // Stages are compiled by link(), which reports their errors. A file may pull others in with
+    // #include "file", relative to itself, and is given the defines, "NAME" or "NAME VALUE",
+    // right after its #version line; those whose name is not a word of the source, comments
+    // aside, are left out, so that they do not make otherwise equal programs differ.
+    void addShaderFromFile(const std::string &filePath, GLenum shaderType,
+                           const std::vector<std::string> &defines = std::vector<std::string>());
     void addShaderFromSource(const std::string &sourceCode, GLenum shaderType);
 
+    // Hash of the stages added since the last link(), types and final sources; programs built
+    // from stages of equal hashes are the same
+    uint64_t getSourceHash() const;
+
+    // Compiles and links the stages, throwing std::runtime_error on errors. beginLink() only
+    // hands the work to the driver, which may run it on its own threads; finishLink() then waits
+    // for it, reports errors like link() and saves the binary. The program must be finished
+    // before use().
     void link();
+    void beginLink();
+    void finishLink();
+    bool isLinking() const;
+
+    // Whether finishLink() would return without waiting; always true without parallel compiling
+    bool isLinkDone() const;
+
+    // Lets the driver compile and link on threads of its own when it has
+    // KHR_parallel_shader_compile, or the ARB version, for the current context. getProcAddress is
+    // the loader given to GLAD. Returns whether it is available.
+    static bool enableParallelCompile(void *(*getProcAddress)(const char *name));
+
+    // Directory where link() saves linked programs as driver binaries, keyed on a hash of the
+    // stage sources and the GL vendor, renderer and version, and loads them back instead of
+    // compiling. A binary the driver rejects is compiled over and replaced. Empty, the default,
+    // disables the cache.
+    static void               setBinaryCacheDirectory(const std::string &directory);
+    static const std::string &getBinaryCacheDirectory();
+
+    // Compiles and links the files this program was built from again, as beginLink() does, while
+    // the current program stays in use; finishReload() swaps the result in, so the Shader keeps
+    // its identity for whoever holds it. A reload started over a pending one replaces it. On an
+    // error, which is logged, the current program stays and false is returned.
+    bool reload();
+    bool isReloading() const;
+    bool isReloadDone() const; // whether finishReload() would return without waiting
+    bool finishReload();
+
+    // Files given to addShaderFromFile, in order, then the files they include
+    std::vector<std::string> getFiles() const;
 
     void use() const;
 
+    // The setters look uniforms up in a table reflected from the linked program, and refreshed
+    // when it is reloaded, instead of asking the driver. A uniform the program does not use, or
+    // given a value of another type, is skipped without a GL call. A name the sources never
+    // declare, or a type mismatch, is warned about once.
+    //
+    // A handle stands for a name and stays valid across reload(); setting through it costs no
+    // lookup at all.
+    int getUniformHandle(const std::string &name) const;
+
+    void setBool(int uniform, bool value) const;
+    void setInt(int uniform, int value) const;
+    void setFloat(int uniform, float value) const;
+    void setVec2(int uniform, const glm::vec2 &value) const;
+    void setVec3(int uniform, const glm::vec3 &value) const;
+    void setVec4(int uniform, const glm::vec4 &value) const;
+    void setMat2(int uniform, const glm::mat2 &mat) const;
+    void setMat3(int uniform, const glm::mat3 &mat) const;
+    void setMat4(int uniform, const glm::mat4 &mat) const;
+
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
@@ -43,11 +108,86 @@ class Shader {
     void setMat3(const std::string &name, const glm::mat3 &mat) const;
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
 
+    // Binds a uniform block or a shader storage block to a buffer binding point, kept across
+    // reload(). An inactive block is skipped, an undeclared one warned about once.
+    void bindUniformBlock(const std::string &name, GLuint binding);
+    void bindStorageBlock(const std::string &name, GLuint binding);
+
+    // Bytes the block's buffer must hold, -1 when the program has no such active block
+    GLint getUniformBlockSize(const std::string &name) const;
+    GLint getStorageBlockSize(const std::string &name) const;
+
   private:
+    struct SourceFile {
+        std::string              path;
+        GLenum                   type;
+        std::vector<std::string> defines;
+    };
+
+    struct Stage {
+        std::string source;
+        GLenum      type;
+    };
+
+    // Active uniform of the linked program, as the driver reports it
+    struct ActiveUniform {
+        GLint  location;
+        GLenum type;
+        GLint  size; // array length, 1 for a single value
+    };
+
+    // Uniform asked for by name; a handle indexes _uniforms
+    struct Uniform {
+        std::string name;
+        GLint       location; // -1 when the program does not use it
+        GLenum      type;
+        bool        declared; // named in the sources, so inactive rather than misspelled
+        bool        warned;
+    };
+
+    struct Block {
+        GLuint index;
+        GLint  size;    // bytes
+        GLint  binding; // -1 until bound here
+    };
+
     unsigned int              ID;
     std::vector<unsigned int> shaderIDs;
-
-    void _checkCompileErrors(unsigned int shader, const std::string &type) const;
+    std::vector<SourceFile>   _files;
+    std::vector<std::string>  _includes;
+    std::vector<Stage>        _stages; // added, not compiled yet
+    bool                      _linking;
+    std::string               _binaryPath; // to save the linked program to, empty for none
+    uint64_t                  _binaryKey;
+    std::unique_ptr<Shader>   _reload; // program reload() is building, null when none
+
+    std::unordered_set<std::string>               _identifiers; // words of the last sources
+    std::unordered_map<std::string, ActiveUniform> _activeUniforms;
+    std::unordered_map<std::string, Block>         _uniformBlocks;
+    std::unordered_map<std::string, Block>         _storageBlocks;
+    mutable std::vector<Uniform>                   _uniforms;
+    mutable std::unordered_map<std::string, int>   _uniformHandles;
+    std::unordered_set<std::string>               _warnedBlocks;
+
+    static std::string _binaryCacheDirectory;
+    static bool        _parallelCompile;
+
+    void     _compileStage(const Stage &stage);
+    void     _deleteStages();
+    void     _collectIdentifiers();
+    void     _reflect();
+    void     _readBlocks(GLenum programInterface, std::unordered_map<std::string, Block> &blocks);
+    void     _refreshUniform(Uniform &uniform) const;
+    bool     _isDeclared(const std::string &name) const;
+    GLint    _locate(int uniform, GLenum type) const;
+    void     _bindBlock(std::unordered_map<std::string, Block> &blocks, const std::string &name,
+                        GLuint binding, bool storage);
+    void     _checkCompileErrors(unsigned int shader, const std::string &type) const;
+    uint64_t _getBinaryKey() const;
+    bool     _loadBinary(const std::string &path, uint64_t key);
+    void     _saveBinary(const std::string &path, uint64_t key) const;
 
     std::string _loadShaderSource(const std::string &filePath) const;
+    std::string _preprocess(const std::string &source, const std::string &filePath,
+                            const std::vector<std::string> &defines, int depth);
 };
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "struct.h"
+#include <cstdint>
+
+class Shader;
+
+typedef unsigned int GLenum;
+
+// Variants of one shader program: the same stage files built with different sets of defines, each
+// the first time it is asked for. Variants whose final sources come out equal, the defines their
+// files never mention being left out, share one program.
+class ShaderPermutations {
+  public:
+    // Stage files, read again for each new variant
+    void addStage(const std::string &path, GLenum type);
+
+    // Starts building a variant likely needed soon, without waiting for the driver
+    void prepare(const std::vector<std::string> &defines);
+
+    // Whether get() would return without waiting for the driver, starting the variant like
+    // prepare() when it was never asked for
+    bool isReady(const std::vector<std::string> &defines);
+
+    // Program built with the defines, "NAME" or "NAME VALUE", in any order, waiting for it if
+    // prepare() started it. Null when it does not compile or link, which is logged the first time
+    // and not tried again until forgetFailures().
+    std::shared_ptr<Shader> get(const std::vector<std::string> &defines);
+
+    // Distinct programs built so far, for reloading them as their files change
+    const std::vector<std::shared_ptr<Shader>> &getPrograms() const;
+    size_t                                      getVariantCount() const; // asked for, built or not
+
+    // Stage files, then those the programs built include
+    std::vector<std::string> getFiles() const;
+
+    // Lets get() try the variants that failed again, once their files changed
+    void forgetFailures();
+
+  private:
+    struct Stage {
+        std::string path;
+        GLenum      type;
+    };
+
+    std::vector<Stage>                                       _stages;
+    std::unordered_map<std::string, std::shared_ptr<Shader>> _variants; // by sorted defines
+    std::unordered_map<uint64_t, std::shared_ptr<Shader>>    _programsBySource;
+    std::vector<std::shared_ptr<Shader>>                     _programs;
+
+    std::shared_ptr<Shader> _begin(const std::vector<std::string> &defines, std::string &key);
+    void                    _forget(const std::shared_ptr<Shader> &program);
+};
@@ -2,9 +2,18 @@
 
 #include "struct.h"
 
+// Pixels decoded from an image file, ready for the Texture constructor to upload
+struct TextureImage {
+    int                            width = 0;
+    int                            height = 0;
+    int                            channels = 0;
+    std::shared_ptr<unsigned char> pixels; // null when nothing was decoded
+};
+
 class Texture {
   public:
     Texture(const std::string &path, GLenum textureType = GL_TEXTURE_2D, bool flip = true);
+    explicit Texture(const TextureImage &image, GLenum textureType = GL_TEXTURE_2D);
     ~Texture();
 
     // Delete copy constructor and copy assignment operator
@@ -24,10 +33,11 @@ class Texture {
 
     unsigned int getID() const { return ID; }
 
+    // Decodes an image file without touching GL, so it can run on any thread. Throws, after
+    // logging the path, when the file cannot be decoded.
+    static TextureImage decode(const std::string &path, bool flip = true);
+
   private:
     unsigned int ID;
     GLenum       type;
-
-    unsigned char *_loadImage(const std::string &path, int &width, int &height, int &nrChannels,
-                              bool flip);
 };
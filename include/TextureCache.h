@@ -0,0 +1,39 @@
+#pragma once
+
+#include "struct.h"
+
+// Textures referenced by materials, one per file path. Paths are registered while parsing, which
+// needs no GL context, and each texture is uploaded the first time it is bound.
+class TextureCache {
+  public:
+    // Index of the texture at path, registering it on first sight
+    int add(const std::string &path);
+
+    // Index of the texture at path, NO_TEXTURE when it is not registered
+    int find(const std::string &path) const;
+
+    // Binds the texture to a unit, loading it first if needed. Returns false, after reporting the
+    // error once, when the file could not be loaded.
+    bool bind(int texture, unsigned int unit) const;
+
+    // Loads every registered texture now rather than on first bind, so the decode and upload
+    // cost lands at load time instead of in the first frames. Needs a GL context.
+    void loadAll() const;
+
+    // Hands over a texture uploaded elsewhere, such as by a model loaded in the background; a
+    // null texture marks it as failed. isLoaded() tells whether either already happened.
+    void set(int texture, const std::shared_ptr<Texture> &loaded);
+    bool isLoaded(int texture) const;
+
+    const std::string &getPath(int texture) const;
+    size_t             getCount() const;
+
+  private:
+    std::vector<std::string>             _paths;
+    std::unordered_map<std::string, int> _indices;
+
+    mutable std::vector<std::shared_ptr<Texture>> _textures;
+    mutable std::vector<unsigned char>            _failed;
+
+    bool _load(size_t index) const;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "struct.h"
+#include <atomic>
+
+// Ray-casting hierarchy over the triangles of one mesh. Built as a binned SAH binary tree (large
+// subtrees on worker threads), then collapsed into 4-wide nodes whose child boxes are stored as
+// structure of arrays so one ray is tested against all four children with SSE.
+class TriangleBvh {
+  public:
+    struct Hit {
+        unsigned int triangle = 0; // index of the triangle in the source index list
+        float        distance = FLT_MAX;
+        glm::vec2    barycentrics = glm::vec2(0.0f); // weights of the triangle's 2nd and 3rd corner
+    };
+
+    TriangleBvh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices);
+
+    // Nearest hit closer than maxDistance; the direction does not need to be normalized, distances
+    // are expressed in multiples of it
+    bool intersect(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+                   Hit &hit) const;
+
+    size_t getNodeCount() const;
+
+  private:
+    struct BuildNode {
+        AABB         bounds;
+        unsigned int leftFirst; // first child for inner nodes, first triangle slot for leaves
+        unsigned int count;     // triangle count of a leaf, 0 for inner nodes
+    };
+
+    struct Node {
+        float        minX[4], minY[4], minZ[4];
+        float        maxX[4], maxY[4], maxZ[4];
+        unsigned int children[4]; // node index, or first triangle slot when counts[i] > 0
+        unsigned int counts[4];   // triangles of a leaf child, 0 for inner or empty children
+    };
+
+    // Triangle stored as its first corner and two edges, in leaf order
+    struct Triangle {
+        glm::vec3 v0, edge1, edge2;
+    };
+
+    std::vector<Node>         _nodes;
+    std::vector<Triangle>     _triangles;
+    std::vector<unsigned int> _triangleIds;
+
+    // Build-time state, released once the 4-wide nodes exist
+    std::vector<BuildNode>    _buildNodes;
+    std::atomic<unsigned int> _buildNodeCount;
+    std::vector<AABB>         _slotBounds;
+    std::vector<glm::vec3>    _centroids;
+
+    void _buildRecursive(unsigned int nodeIndex, unsigned int parallelDepth);
+    bool _split(unsigned int nodeIndex);
+    void _collapse();
+};
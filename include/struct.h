@@ -3,6 +3,9 @@
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 #include <array>
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -10,6 +13,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -22,6 +26,105 @@ struct Vertex {
     glm::vec3 position;
     glm::vec2 texCoords;
     glm::vec3 normal;
+    glm::vec4 tangent; // xyz tangent, w bitangent sign; zero when the mesh has no normal map
+};
+
+// Contiguous slice of an index buffer drawn with a single base vertex
+struct DrawRange {
+    unsigned int first = 0;      // first index in the element buffer
+    unsigned int count = 0;      // number of indices
+    int          baseVertex = 0; // added to every index by glDrawElementsBaseVertex
+};
+
+// One level of detail of a mesh: a triangle list over the shared vertex array
+struct LodLevel {
+    std::vector<unsigned int> indices;
+    float                     error = 0.0f; // object-space deviation from LOD 0
+    std::vector<DrawRange>    drawRanges;   // where the level lives in the element buffer
+};
+
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    void grow(const glm::vec3 &point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void grow(const AABB &other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+    bool      empty() const { return min.x > max.x; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    float     surfaceArea() const {
+        glm::vec3 extent = max - min;
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float     radius = 0.0f;
+};
+
+// Cluster of at most 64 vertices and 124 triangles, culled as a unit against the view frustum
+// and against its normal cone (backfacing clusters)
+struct Meshlet {
+    unsigned int   firstIndex = 0; // into the LOD 0 index list
+    unsigned int   indexCount = 0;
+    BoundingSphere bounds;
+    glm::vec3      coneApex = glm::vec3(0.0f);
+    glm::vec3      coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    float          coneCutoff = 2.0f; // above 1 the cone never culls
+};
+
+// Planes stored as (normal, distance), pointing inwards
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Counters reset at the start of every Scene::render
+struct RenderStats {
+    size_t drawCalls = 0;
+    size_t trianglesDrawn = 0;
+    size_t trianglesFullDetail = 0; // what LOD 0 everywhere would have drawn
+    size_t meshletsDrawn = 0;
+    size_t meshletsCulled = 0;
+    size_t instancesCulled = 0;
+    size_t transparentInstances = 0; // drawn after the opaque ones, with blending
+};
+
+enum InstanceFlags : unsigned int {
+    INSTANCE_VISIBLE = 1u << 0,  // drawn by Scene::render
+    INSTANCE_PICKABLE = 1u << 1, // hit by Scene::raycast
+};
+
+// One placement of a mesh in the scene. Instances only reference the mesh, so any number of them
+// share its GPU geometry and are drawn together in instanced draws.
+struct Instance {
+    std::shared_ptr<Mesh> mesh;
+    unsigned int          node = 0;                    // scene graph node the instance follows
+    glm::mat4             transform = glm::mat4(1.0f); // world transform of the node
+    int                   material = -1; // index into the scene's materials, -1 for the mesh's own
+    unsigned int          flags = INSTANCE_VISIBLE | INSTANCE_PICKABLE;
+};
+
+// Camera position and orientation, at one frame of a benchmark path or from a scene manifest
+struct CameraPose {
+    glm::vec3 position;
+    float     yaw;
+    float     pitch;
+};
+
+// Nearest scene triangle along a ray, as returned by Scene::raycast
+struct RaycastHit {
+    std::shared_ptr<Mesh> mesh;
+    size_t                instance = 0;
+    unsigned int          triangle = 0; // triangle of mesh->getIndices()
+    glm::vec2             barycentrics = glm::vec2(0.0f);
+    float                 distance = FLT_MAX; // in multiples of the ray direction
+    glm::vec3             position = glm::vec3(0.0f);
 };
 
 struct SubMesh {
@@ -35,18 +138,55 @@ struct ObjObject {
     std::vector<SubMesh> subMeshes;
 };
 
+// Texture slots of a Material
+enum MaterialMap : unsigned int {
+    MAP_DIFFUSE,  // map_Kd
+    MAP_SPECULAR, // map_Ks
+    MAP_OPACITY,  // map_d
+    MAP_NORMAL,   // map_Bump, bump, norm
+    MAP_COUNT
+};
+
+static const int NO_TEXTURE = -1;
+
+// Plain data laid out like the std140 MaterialBlock of shaders/material.glsl (each vec3 shares a
+// vec4 slot with the scalar after it, the texture indices are an ivec4), so materials are copied
+// to its uniform buffer as is and compared with memcmp. Textures are indices into the TextureCache
+// the material was loaded with; the name stays with the mesh.
 struct Material {
-    std::string                      name;
-    glm::vec3                        ambient = glm::vec3(0.0f);
-    glm::vec3                        diffuse = glm::vec3(0.0f);
-    glm::vec3                        specular = glm::vec3(0.0f);
-    float                            shininess = 32.0f;
-    std::string                      diffuseMapPath;
-    mutable std::shared_ptr<Texture> diffuseTexture;
+    glm::vec3 ambient = glm::vec3(0.0f);  // Ka
+    float     shininess = 32.0f;          // Ns
+    glm::vec3 diffuse = glm::vec3(0.8f);  // Kd, light grey without an MTL
+    float     opacity = 1.0f;             // d, or 1 - Tr
+    glm::vec3 specular = glm::vec3(0.0f); // Ks
+    int       illum = 2;                  // illumination model: 0 color, 1 diffuse, 2 specular
+    glm::vec3 emissive = glm::vec3(0.0f); // Ke
+    float     bumpScale = 1.0f;           // -bm of the normal map
+    glm::vec4 mapTransforms[MAP_COUNT] = { // xy scale (-s), zw offset (-o) of each texture slot
+        glm::vec4(1.0f, 1.0f, 0.0f, 0.0f), glm::vec4(1.0f, 1.0f, 0.0f, 0.0f),
+        glm::vec4(1.0f, 1.0f, 0.0f, 0.0f), glm::vec4(1.0f, 1.0f, 0.0f, 0.0f)};
+    glm::ivec4 maps = glm::ivec4(NO_TEXTURE); // TextureCache index of each slot, one per lane
+
+    bool hasMap(MaterialMap map) const { return maps[static_cast<int>(map)] != NO_TEXTURE; }
 };
 
+static_assert(MAP_COUNT == 4 && std::is_standard_layout<Material>::value &&
+                  sizeof(Material) == 144,
+              "Material must keep its std140-compatible layout");
+static_assert(offsetof(Material, ambient) == 0 && offsetof(Material, shininess) == 12 &&
+                  offsetof(Material, diffuse) == 16 && offsetof(Material, opacity) == 28 &&
+                  offsetof(Material, specular) == 32 && offsetof(Material, illum) == 44 &&
+                  offsetof(Material, emissive) == 48 && offsetof(Material, bumpScale) == 60 &&
+                  offsetof(Material, mapTransforms) == 64 && offsetof(Material, maps) == 128,
+              "Material members must sit at their std140 offsets in MaterialBlock");
+
+inline bool operator==(const Material &a, const Material &b) {
+    return std::memcmp(&a, &b, sizeof(Material)) == 0;
+}
+inline bool operator!=(const Material &a, const Material &b) { return !(a == b); }
+
 void        framebuffer_size_callback(GLFWwindow *window, int width, int height);
-GLFWwindow *initGLFW();
+GLFWwindow *initGLFW(int width, int height);
 bool        initGLAD();
 void        createBuffers(unsigned int &VAO, unsigned int &VBO, unsigned int &EBO);
 void        mouse_callback(GLFWwindow *window, double xpos, double ypos);
@@ -1,11 +1,19 @@
+#include "include/Benchmark.h"
 #include "include/Camera.h"
+#include "include/HeadlessContext.h"
 #include "include/InputHandler.h"
-#include "include/Mesh.h"
-#include "include/ObjLoader.h"
+#include "include/LoadStats.h"
+#include "include/Logger.h"
 #include "include/Scene.h"
+#include "include/SceneManifest.h"
 #include "include/Shader.h"
+#include "include/ShaderPermutations.h"
 #include "include/struct.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 
@@ -18,6 +26,7 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
 
     Scene *scene = static_cast<Scene *>(glfwGetWindowUserPointer(window));
     if (scene) {
+        scene->setViewportSize(width, height);
         float aspectRatio = static_cast<float>(width) / static_cast<float>(height);
         for (auto &camera : scene->getCameras()) {
             if (camera) {
@@ -39,6 +48,16 @@ static void fps_counter(GLFWwindow *window) {
 
         std::ostringstream oss;
         oss << " [FPS: " << fps << " Frame time: " << ms_per_frame << "(ms)]";
+
+        Scene *scene = static_cast<Scene *>(glfwGetWindowUserPointer(window));
+        if (scene) {
+            const RenderStats &stats = scene->getRenderStats();
+            oss << " [Triangles: " << stats.trianglesDrawn << " (" << stats.trianglesFullDetail
+                << " without LOD), LOD: " << (scene->isLodEnabled() ? "on" : "off")
+                << ", Draw calls: " << stats.drawCalls << ", Meshlets: " << stats.meshletsDrawn
+                << " drawn / " << stats.meshletsCulled << " culled, Instances culled: "
+                << stats.instancesCulled << "]";
+        }
         glfwSetWindowTitle(window, oss.str().c_str());
         frame_count = 0;
     }
@@ -46,15 +65,15 @@ static void fps_counter(GLFWwindow *window) {
 }
 
 // Initialize GLFW and create a window
-GLFWwindow *initGLFW() {
+GLFWwindow *initGLFW(int width, int height) {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    GLFWwindow *window = glfwCreateWindow(800, 600, "Scop", NULL, NULL);
+    GLFWwindow *window = glfwCreateWindow(width, height, "Scop", NULL, NULL);
     if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
+        LogMessage(LOG_ERROR) << "Failed to create GLFW window";
         glfwTerminate();
         return nullptr;
     }
@@ -65,75 +84,287 @@ GLFWwindow *initGLFW() {
 // Initialize GLAD
 bool initGLAD() {
     if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+        LogMessage(LOG_ERROR) << "Failed to initialize GLAD";
         return false;
     }
+    Shader::enableParallelCompile(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
     return true;
 }
 
-static std::vector<std::shared_ptr<Mesh>> loadMeshesFromObj(const std::string &filePath) {
-    ObjLoader objLoader(filePath);
-    auto      meshes = objLoader.getMeshes();
-
-    int meshIndex = 0;
-    for (const auto &meshPtr : meshes) {
-        std::cout << "Mesh #" << meshIndex << std::endl;
+// Command line options. Without --headless a window opens; without --headless or --benchmark
+// --frames is ignored.
+struct Options {
+    bool        help = false;
+    bool        headless = false;
+    int         width = 800;
+    int         height = 600;
+    int         frames = 0; // 0 picks the mode's default: 1 headless, 600 for a benchmark
+    std::string output;     // headless frames are written to <output>_<frame>.ppm
+    std::string benchmark;  // JSON report of a benchmark run
+    std::string cameraPath; // poses the benchmark camera follows instead of an orbit
+    std::string recordPath; // window camera poses are recorded there
+    std::string trace;      // Chrome trace of the profiled frames
+    std::string loadReport; // JSON per-stage cost of loading the models
+    bool        verbose = false;
+    bool        hotReload = false;
+    std::string scene = "scenes/default.scene";
+    std::string model;                         // loaded alone, instead of the scene, when set
+    int         loadThreads = 0;               // 0 lets the loader pick
+    std::string shaderCache = ".shader_cache"; // empty to always compile
+};
+
+static const int DEFAULT_HEADLESS_FRAMES = 1;
+static const int DEFAULT_BENCHMARK_FRAMES = 600;
+
+static void printUsage(const char *program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --scene <file>     scene manifest to load (default scenes/default.scene)\n"
+              << "  --model <path>     load this OBJ file alone instead of a scene\n"
+              << "  --load-threads <n> models loaded in parallel (default up to 4; a benchmark\n"
+              << "                     or load report loads them one after the other)\n"
+              << "  --width <pixels>   viewport width (default 800)\n"
+              << "  --height <pixels>  viewport height (default 600)\n"
+              << "  --headless         render offscreen through EGL, without a window\n"
+              << "  --frames <count>   frames to render (default 1 headless, 600 benchmark)\n"
+              << "  --output <prefix>  headless: write every frame to <prefix>_<frame>.ppm\n"
+              << "  --benchmark <json> fly the camera along a fixed path, write a report\n"
+              << "  --camera-path <f>  benchmark: follow the poses in f instead of an orbit\n"
+              << "  --record-path <f>  window: record the camera poses to f\n"
+              << "  --trace <json>     write the profiled frames as a Chrome trace\n"
+              << "  --load-report <f>  write the per-stage cost of loading the models as JSON\n"
+              << "  --shader-cache <d> keep linked shader binaries in d (default .shader_cache,\n"
+              << "                     \"\" to always compile)\n"
+              << "  --hot-reload       reload models, textures and shaders as their files change\n"
+              << "  --verbose          log every object and mesh while loading\n"
+              << "  --help             show this message" << std::endl;
+}
 
-        const auto &vertices = meshPtr->getVertices();
-        const auto &indices = meshPtr->getIndices();
-        const auto &material = meshPtr->getMaterial();
+static bool parsePositive(const std::string &text, int &value) {
+    char *end = nullptr;
+    long  parsed = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || parsed <= 0 || parsed > 1 << 20) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
 
-        if (material.name.empty()) {
-            std::cout << "  Material: (No material assigned)" << std::endl;
+static bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        bool        hasValue = i + 1 < argc;
+        if (argument == "--help") {
+            options.help = true;
+        } else if (argument == "--headless") {
+            options.headless = true;
+        } else if (argument == "--verbose") {
+            options.verbose = true;
+        } else if (argument == "--hot-reload") {
+            options.hotReload = true;
+        } else if (argument == "--scene" && hasValue) {
+            options.scene = argv[++i];
+        } else if (argument == "--model" && hasValue) {
+            options.model = argv[++i];
+        } else if (argument == "--output" && hasValue) {
+            options.output = argv[++i];
+        } else if (argument == "--benchmark" && hasValue) {
+            options.benchmark = argv[++i];
+        } else if (argument == "--camera-path" && hasValue) {
+            options.cameraPath = argv[++i];
+        } else if (argument == "--record-path" && hasValue) {
+            options.recordPath = argv[++i];
+        } else if (argument == "--shader-cache" && hasValue) {
+            options.shaderCache = argv[++i];
+        } else if (argument == "--trace" && hasValue) {
+            options.trace = argv[++i];
+        } else if (argument == "--load-report" && hasValue) {
+            options.loadReport = argv[++i];
+        } else if ((argument == "--width" || argument == "--height" || argument == "--frames" ||
+                    argument == "--load-threads") &&
+                   hasValue) {
+            int &value = argument == "--width"    ? options.width
+                         : argument == "--height" ? options.height
+                         : argument == "--frames" ? options.frames
+                                                  : options.loadThreads;
+            if (!parsePositive(argv[++i], value)) {
+                std::cerr << "Invalid value for " << argument << ": " << argv[i] << std::endl;
+                return false;
+            }
         } else {
-            std::cout << "  Material Name: " << material.name << std::endl;
-            std::cout << "    Ambient: (" << material.ambient.r << ", " << material.ambient.g
-                      << ", " << material.ambient.b << ")" << std::endl;
-            std::cout << "    Diffuse: (" << material.diffuse.r << ", " << material.diffuse.g
-                      << ", " << material.diffuse.b << ")" << std::endl;
-            std::cout << "    Specular: (" << material.specular.r << ", " << material.specular.g
-                      << ", " << material.specular.b << ")" << std::endl;
-            std::cout << "    Shininess: " << material.shininess << std::endl;
-            std::cout << "    Diffuse Map Path: " << material.diffuseMapPath << std::endl;
+            std::cerr << "Unknown or incomplete option: " << argument << std::endl;
+            printUsage(argv[0]);
+            return false;
         }
+    }
+    return true;
+}
 
-        std::cout << "  Number of Vertices: " << vertices.size() << std::endl;
-        std::cout << "  Number of Indices: " << indices.size() << std::endl;
+// The model given alone, or else the scene manifest
+static const std::string &getSource(const Options &options) {
+    return options.model.empty() ? options.scene : options.model;
+}
 
-        size_t maxVerticesToShow = std::min(vertices.size(), static_cast<size_t>(5));
-        for (size_t i = 0; i < maxVerticesToShow; ++i) {
-            const auto &vertex = vertices[i];
-            std::cout << "    Vertex " << i << ": Position(" << vertex.position.x << ", "
-                      << vertex.position.y << ", " << vertex.position.z << "), "
-                      << "Normal(" << vertex.normal.x << ", " << vertex.normal.y << ", "
-                      << vertex.normal.z << "), "
-                      << "TexCoords(" << vertex.texCoords.x << ", " << vertex.texCoords.y << ")"
-                      << std::endl;
+// Loads every model before the first frame. Load stages are only collected on the calling thread,
+// so for the load report and the benchmark the models load there, one after the other, instead of
+// in parallel on the loader threads.
+static void loadModels(Scene &scene, const Options &options,
+                       const std::vector<SceneManifest::Model> &models, LoadStats &loadStats) {
+    bool   collectStages = !options.loadReport.empty() || !options.benchmark.empty();
+    size_t instances = 0;
+    auto   start = std::chrono::steady_clock::now();
+    if (!collectStages) {
+        for (const auto &model : models) {
+            scene.loadModelAsync(model.path, model.placements);
+            instances += model.placements.size();
+        }
+        scene.finishLoading();
+    } else {
+        loadStats.start();
+        for (const auto &model : models) {
+            scene.loadModel(model.path, model.placements);
+            instances += model.placements.size();
         }
-        if (vertices.size() > maxVerticesToShow) {
-            std::cout << "    ... (" << vertices.size() - maxVerticesToShow << " more vertices)"
-                      << std::endl;
+        loadStats.stop();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    size_t threads = collectStages ? 1 : std::min(scene.getLoaderThreadCount(), models.size());
+    LogMessage(LOG_INFO) << "Loaded " << models.size() << " model(s), " << instances
+                         << " instance(s), in " << elapsed.count() << " ms on " << threads
+                         << " loader thread(s)";
+
+    if (!collectStages) {
+        return;
+    }
+    if (Logger::isEnabled(LOG_INFO)) {
+        std::ostringstream summary;
+        loadStats.printSummary(summary);
+        std::string text = summary.str();
+        Logger::write(LOG_INFO, text.substr(0, text.size() - 1));
+    }
+    if (!options.loadReport.empty()) {
+        try {
+            loadStats.writeJson(options.loadReport, getSource(options));
+        } catch (const std::runtime_error &e) {
+            LogMessage(LOG_ERROR) << e.what();
+        }
+    }
+}
+
+// Shader, cameras and models shared by the window and headless modes
+static bool setupScene(Scene &scene, const Options &options, LoadStats &loadStats) {
+    // Variants are prepared as materials arrive and compile while the models load. The plainest
+    // one is checked once they are in, so that a broken shader stops here rather than leaving
+    // every mesh undrawn.
+    auto shaders = std::make_shared<ShaderPermutations>();
+    shaders->addStage("shaders/vertex.glsl", GL_VERTEX_SHADER);
+    shaders->addStage("shaders/fragment.glsl", GL_FRAGMENT_SHADER);
+    shaders->prepare(std::vector<std::string>());
+    scene.setMaterialShaders(shaders);
+
+    // A model given alone is placed once at the origin and seen from the default cameras
+    std::vector<SceneManifest::Model> models;
+    std::vector<CameraPose>           poses;
+    if (options.model.empty()) {
+        try {
+            SceneManifest manifest(options.scene);
+            models = manifest.getModels();
+            poses = manifest.getCameras();
+        } catch (const std::runtime_error &e) {
+            LogMessage(LOG_ERROR) << e.what();
+            return false;
         }
+    } else {
+        SceneManifest::Model model;
+        model.name = options.model;
+        model.path = options.model;
+        model.placements.push_back(glm::mat4(1.0f));
+        models.push_back(model);
+    }
+    if (poses.empty()) {
+        CameraPose pose = {glm::vec3(0.0f, 0.0f, 3.0f), -90.0f, 0.0f};
+        poses.assign(2, pose);
+    }
 
-        size_t maxTrianglesToShow = std::min(indices.size() / 3, static_cast<size_t>(5));
-        for (size_t i = 0; i < maxTrianglesToShow * 3; i += 3) {
-            std::cout << "    Triangle " << i / 3 << ": Indices(" << indices[i] << ", "
-                      << indices[i + 1] << ", " << indices[i + 2] << ")" << std::endl;
+    float aspectRatio = static_cast<float>(options.width) / static_cast<float>(options.height);
+    for (const auto &pose : poses) {
+        auto camera = std::make_shared<Camera>(pose.position, glm::vec3(0.0f, 1.0f, 0.0f),
+                                               pose.yaw, pose.pitch);
+        camera->setAspectRatio(aspectRatio);
+        scene.addCamera(camera);
+    }
+    scene.setActiveCamera(0);
+
+    scene.setViewportSize(options.width, options.height);
+    if (options.loadThreads > 0) {
+        scene.setLoaderThreadCount(static_cast<size_t>(options.loadThreads));
+    }
+
+    // The window shows the models piece by piece as they load; the other modes measure or render
+    // them from the first frame, so they wait for all of them
+    if (!options.headless && options.benchmark.empty() && options.loadReport.empty()) {
+        for (const auto &model : models) {
+            scene.loadModelAsync(model.path, model.placements);
         }
-        if (indices.size() / 3 > maxTrianglesToShow) {
-            std::cout << "    ... (" << (indices.size() / 3) - maxTrianglesToShow
-                      << " more triangles)" << std::endl;
+    } else {
+        loadModels(scene, options, models, loadStats);
+    }
+    if (!shaders->get(std::vector<std::string>())) {
+        return false;
+    }
+
+    if (options.hotReload) {
+        try {
+            scene.setHotReloadEnabled(true);
+        } catch (const std::runtime_error &e) {
+            LogMessage(LOG_ERROR) << "Hot reload disabled: " << e.what();
         }
+    }
+    if (!options.trace.empty()) {
+        scene.getProfiler().startCapture();
+    }
+    return true;
+}
 
-        ++meshIndex;
+static void writeTrace(Scene &scene, const Options &options) {
+    if (options.trace.empty()) {
+        return;
     }
+    try {
+        scene.getProfiler().flush();
+        scene.getProfiler().writeTrace(options.trace);
+        LogMessage(LOG_INFO) << "Trace written to " << options.trace;
+    } catch (const std::runtime_error &e) {
+        LogMessage(LOG_ERROR) << e.what();
+    }
+}
 
-    return meshes;
+static int runBenchmark(Scene &scene, const Options &options, const LoadStats &loadStats,
+                        const std::function<void()> &endFrame) {
+    try {
+        Benchmark benchmark(scene, static_cast<size_t>(options.frames ? options.frames
+                                                                       : DEFAULT_BENCHMARK_FRAMES));
+        if (options.cameraPath.empty()) {
+            benchmark.generateOrbit();
+        } else {
+            benchmark.loadPath(options.cameraPath);
+        }
+        for (const auto &stage : loadStats.getStages()) {
+            benchmark.addLoadStage(stage);
+        }
+        benchmark.run(endFrame);
+        benchmark.writeReport(options.benchmark, getSource(options), options.width,
+                              options.height);
+        LogMessage(LOG_INFO) << "Benchmark report written to " << options.benchmark;
+    } catch (const std::runtime_error &e) {
+        LogMessage(LOG_ERROR) << "Benchmark failed: " << e.what();
+        return -1;
+    }
+    return 0;
 }
 
-int main() {
+static int runWindow(const Options &options) {
     // Initialize GLFW
-    GLFWwindow *window = initGLFW();
+    GLFWwindow *window = initGLFW(options.width, options.height);
     if (!window)
         return -1;
 
@@ -142,58 +373,43 @@ int main() {
         return -1;
 
     // Set viewport
-    glViewport(0, 0, 800, 600);
+    glViewport(0, 0, options.width, options.height);
 
+    int status = 0;
     {
-        // Create shader program
-        Scene scene;
-
-        // class Shader shader;
-        auto shader = std::make_shared<Shader>();
-
-        shader->addShaderFromFile("shaders/vertex.glsl", GL_VERTEX_SHADER);
-        shader->addShaderFromFile("shaders/fragment.glsl", GL_FRAGMENT_SHADER);
-
-        try {
-            shader->link();
-        } catch (const std::runtime_error &e) {
-            std::cerr << e.what() << std::endl;
+        Scene     scene;
+        LoadStats loadStats;
+        if (!setupScene(scene, options, loadStats)) {
             return -1;
         }
 
-        scene.addShader(shader);
-
-        auto camera = std::make_shared<Camera>(glm::vec3(0.0f, 0.0f, 3.0f));
-        camera->setAspectRatio(800.0f / 600.0f);
-        scene.addCamera(camera);
-        scene.setActiveCamera(0);
-
-        auto camera2 = std::make_shared<Camera>(glm::vec3(0.0f, 0.0f, 3.0f)); // Camera 2
-        camera2->setAspectRatio(800.0f / 600.0f);
-        scene.addCamera(camera2);
-
         glfwSetWindowUserPointer(window, &scene);
-
         glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
         InputHandler::initialize(window, &scene);
 
-        std::string files = "Models/BugattiV2/untitled.obj";
+        // Disable VSync
+        glfwSwapInterval(0);
+
+        std::unique_ptr<CameraRecorder> recorder;
         try {
-            auto meshes = loadMeshesFromObj(files);
-            for (auto &mesh : meshes) {
-                scene.addMesh(mesh);
+            if (!options.recordPath.empty()) {
+                recorder.reset(new CameraRecorder(options.recordPath));
             }
-            std::cout << "Model loaded successfully: " << files << std::endl;
-        } catch (const std::exception &e) {
-            std::cerr << "Failed to load the model: " << e.what() << std::endl;
+        } catch (const std::runtime_error &e) {
+            LogMessage(LOG_ERROR) << e.what();
         }
 
-        // Disable VSync
-        glfwSwapInterval(0);
-
         // Render loop
-        while (!glfwWindowShouldClose(window)) {
+        if (!options.benchmark.empty()) {
+            status = runBenchmark(scene, options, loadStats, [window]() {
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            });
+        }
+        Profiler &profiler = scene.getProfiler();
+        while (options.benchmark.empty() && !glfwWindowShouldClose(window)) {
+            profiler.beginFrame();
 
             float currentFrame = static_cast<float>(glfwGetTime());
             deltaTime = currentFrame - lastFrame;
@@ -202,16 +418,92 @@ int main() {
             // Input processing
             InputHandler::processInput(deltaTime);
 
+            scene.update();
             scene.render();
 
+            if (recorder) {
+                const Camera &camera = *scene.getActiveCamera();
+                CameraPose    pose = {camera.getPosition(), camera.getYaw(), camera.getPitch()};
+                recorder->record(pose);
+            }
+
             fps_counter(window);
 
             // Swap buffers and poll events
-            glfwSwapBuffers(window);
+            {
+                ProfileScope present(profiler, "present");
+                glfwSwapBuffers(window);
+            }
             glfwPollEvents();
+            profiler.endFrame();
         }
+        writeTrace(scene, options);
     }
     glfwDestroyWindow(window);
     glfwTerminate();
+    return status;
+}
+
+// Renders the frames offscreen
+static int runHeadless(const Options &options) {
+    try {
+        HeadlessContext context(options.width, options.height);
+        Scene           scene;
+        LoadStats       loadStats;
+        if (!setupScene(scene, options, loadStats)) {
+            return -1;
+        }
+        context.bind();
+        scene.setTargetFramebuffer(context.getFramebuffer());
+
+        if (!options.benchmark.empty()) {
+            int status = runBenchmark(scene, options, loadStats, []() {});
+            writeTrace(scene, options);
+            return status;
+        }
+
+        Profiler &profiler = scene.getProfiler();
+        int       frames = options.frames ? options.frames : DEFAULT_HEADLESS_FRAMES;
+        auto      start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            profiler.beginFrame();
+            scene.update();
+            scene.render();
+            if (!options.output.empty()) {
+                ProfileScope       present(profiler, "present");
+                std::ostringstream path;
+                path << options.output << "_" << std::setw(4) << std::setfill('0') << frame
+                     << ".ppm";
+                context.writeImage(path.str());
+            }
+            profiler.endFrame();
+        }
+        glFinish();
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        LogMessage(LOG_INFO) << "Rendered " << frames << " frame(s) at " << options.width << "x"
+                             << options.height << " in " << elapsed.count() << " ms";
+        writeTrace(scene, options);
+    } catch (const std::runtime_error &e) {
+        LogMessage(LOG_ERROR) << "Headless rendering failed: " << e.what();
+        return -1;
+    }
     return 0;
 }
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.help) {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    Logger::start(options.verbose ? LOG_VERBOSE : LOG_INFO);
+    Shader::setBinaryCacheDirectory(options.shaderCache);
+    int status = options.headless ? runHeadless(options) : runWindow(options);
+    Logger::stop();
+    return status;
+}
@@ -1,9 +1,73 @@
-#version 460 core
-out vec4 FragColor;
+#version 450 core
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out float Revealage; // WEIGHTED_OIT only
 
+in vec3 FragPosition;
+in vec3 Normal;
+#ifdef HAS_NORMAL_MAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#endif
 in vec2 TexCoord;
 
+#include "material.glsl"
+
+uniform vec3 viewPosition;
+uniform vec3 lightDirection; // towards the light, normalized
+
 void main()
 {
-    FragColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    vec3 normal = normalize(Normal);
+#ifdef HAS_NORMAL_MAP
+    // Re-orthogonalize the interpolated frame before bringing the sampled normal to world
+    vec3 tangent = normalize(Tangent - normal * dot(normal, Tangent));
+    vec3 bitangent = normalize(Bitangent);
+    vec3 mapped = sampleMap(normalMap, MAP_NORMAL, TexCoord).rgb * 2.0 - 1.0;
+    mapped.xy *= material.bumpScale;
+    normal = normalize(mat3(tangent, bitangent, normal) * mapped);
+#endif
+    if (!gl_FrontFacing) {
+        normal = -normal;
+    }
+
+    vec3  albedo = material.diffuse;
+    float opacity = material.opacity;
+#ifdef HAS_DIFFUSE_MAP
+    vec4 texel = sampleMap(diffuseMap, MAP_DIFFUSE, TexCoord);
+    albedo *= texel.rgb;
+    opacity *= texel.a;
+#endif
+#ifdef HAS_OPACITY_MAP
+    opacity *= sampleMap(opacityMap, MAP_OPACITY, TexCoord).r;
+#endif
+
+    vec3 color = material.emissive;
+#ifdef UNLIT
+    color += albedo;
+#else
+    vec3  viewDirection = normalize(viewPosition - FragPosition);
+    float diffuse = max(dot(normal, lightDirection), 0.0);
+    color += material.ambient * albedo + diffuse * albedo;
+#ifdef SPECULAR
+    vec3 specularColor = material.specular;
+#ifdef HAS_SPECULAR_MAP
+    specularColor *= sampleMap(specularMap, MAP_SPECULAR, TexCoord).rgb;
+#endif
+    if (diffuse > 0.0) {
+        vec3 halfway = normalize(lightDirection + viewDirection);
+        color += pow(max(dot(normal, halfway), 0.0), material.shininess) * specularColor;
+    }
+#endif
+#endif
+
+#ifdef WEIGHTED_OIT
+    // Weight from McGuire and Bavoil: favors near and opaque fragments, kept in fp16 range
+    float depth = 1.0 - gl_FragCoord.z * 0.9;
+    float coverage = pow(min(1.0, opacity * 10.0) + 0.01, 3.0);
+    float weight = clamp(coverage * 1e8 * depth * depth * depth, 1e-2, 3e3);
+    FragColor = vec4(color * opacity, opacity) * weight;
+    Revealage = opacity;
+#else
+    FragColor = vec4(color, opacity);
+#endif
 }
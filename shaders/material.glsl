@@ -0,0 +1,34 @@
+// Material of the mesh being drawn. Scene builds a variant of the program per set of features a
+// material uses: HAS_DIFFUSE_MAP, HAS_SPECULAR_MAP, HAS_OPACITY_MAP and HAS_NORMAL_MAP for each
+// texture bound, UNLIT for illum 0 and SPECULAR for illum 2 and up, so that nothing absent is
+// sampled or branched on.
+
+// Texture slots, indices into mapTransforms and maps
+const int MAP_DIFFUSE = 0;
+const int MAP_SPECULAR = 1;
+const int MAP_OPACITY = 2;
+const int MAP_NORMAL = 3;
+
+// Member for member the Material struct of include/struct.h, uploaded as is once per material
+layout(std140) uniform MaterialBlock {
+    vec3  ambient;
+    float shininess;
+    vec3  diffuse;
+    float opacity;
+    vec3  specular;
+    int   illum;
+    vec3  emissive;
+    float bumpScale;
+    vec4  mapTransforms[4]; // xy scale, zw offset of each slot
+    ivec4 maps;             // TextureCache indices, unused here
+} material;
+
+uniform sampler2D diffuseMap;
+uniform sampler2D specularMap;
+uniform sampler2D opacityMap;
+uniform sampler2D normalMap;
+
+vec4 sampleMap(sampler2D map, int slot, vec2 texCoord) {
+    vec4 transform = material.mapTransforms[slot];
+    return texture(map, texCoord * transform.xy + transform.zw);
+}
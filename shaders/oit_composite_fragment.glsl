@@ -0,0 +1,17 @@
+#version 450 core
+out vec4 FragColor;
+
+uniform sampler2D accumTexture;
+uniform sampler2D revealageTexture;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(revealageTexture, texel, 0).r;
+    if (revealage >= 1.0) {
+        discard; // no transparent fragment here
+    }
+    vec4 accum = texelFetch(accumTexture, texel, 0);
+    vec3 average = accum.rgb / max(accum.a, 1e-5);
+    FragColor = vec4(average, 1.0 - revealage);
+}
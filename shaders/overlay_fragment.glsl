@@ -0,0 +1,17 @@
+#version 450 core
+in vec2 Cell;
+in vec3 Color;
+flat in uint Glyph;
+
+out vec4 FragColor;
+
+void main()
+{
+    // 3x5 bitmap, row-major from the top-left pixel down to bit 0
+    ivec2 pixel = min(ivec2(Cell * vec2(3.0, 5.0)), ivec2(2, 4));
+    uint bit = uint(14 - (pixel.y * 3 + pixel.x));
+    if (((Glyph >> bit) & 1u) == 0u) {
+        discard;
+    }
+    FragColor = vec4(Color, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 450 core
+layout(location = 0) in vec2 aPosition;
+layout(location = 1) in vec2 aCell;
+layout(location = 2) in vec3 aColor;
+layout(location = 3) in uint aGlyph;
+
+out vec2 Cell;
+out vec3 Color;
+flat out uint Glyph;
+
+uniform vec2 viewportSize;
+
+void main()
+{
+    vec2 ndc = aPosition / viewportSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    Cell = aCell;
+    Color = aColor;
+    Glyph = aGlyph;
+}
@@ -1,14 +1,31 @@
-#version 460 core
+#version 450 core
 layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in mat4 aModel; // per instance, from the scene's instance buffer
+layout(location = 7) in vec4 aTangent; // xyz tangent, w bitangent sign
 
+out vec3 FragPosition;
+out vec3 Normal;
+#ifdef HAS_NORMAL_MAP
+out vec3 Tangent;
+out vec3 Bitangent;
+#endif
 out vec2 TexCoord;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+    vec4 worldPosition = aModel * vec4(aPos, 1.0);
+    mat3 normalMatrix = transpose(inverse(mat3(aModel)));
+
+    FragPosition = worldPosition.xyz;
+    Normal = normalMatrix * aNormal;
+#ifdef HAS_NORMAL_MAP
+    Tangent = mat3(aModel) * aTangent.xyz;
+    Bitangent = cross(Normal, Tangent) * aTangent.w;
+#endif
     TexCoord = aTexCoord;
+    gl_Position = projection * view * worldPosition;
 }
@@ -0,0 +1,221 @@
+#include "../include/Benchmark.h"
+#include "../include/Camera.h"
+#include "../include/Json.h"
+#include "../include/Scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <unistd.h>
+
+const size_t Benchmark::GPU_QUERY_LATENCY;
+
+static std::string glString(GLenum name) {
+    const GLubyte *value = glGetString(name);
+    return value ? reinterpret_cast<const char *>(value) : "unknown";
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+    return sorted[std::min(std::max(rank, static_cast<size_t>(1)), sorted.size()) - 1];
+}
+
+static void writeDistribution(std::ostream &out, const std::string &name,
+                              const std::vector<double> &values, bool last = false) {
+    std::vector<double> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (double value : sorted) {
+        sum += value;
+    }
+    double mean = sorted.empty() ? 0.0 : sum / static_cast<double>(sorted.size());
+    out << "  " << jsonString(name) << ": {\"mean\": " << mean
+        << ", \"p50\": " << percentile(sorted, 0.50) << ", \"p95\": " << percentile(sorted, 0.95)
+        << ", \"p99\": " << percentile(sorted, 0.99)
+        << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << "}" << (last ? "\n" : ",\n");
+}
+
+// Resident set size now and at its peak, in kilobytes
+static void memoryUsage(long &residentKb, long &peakResidentKb) {
+    peakResidentKb = LoadStats::getProcessPeakRssKb();
+
+    long          pages = 0, residentPages = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> residentPages;
+    residentKb = residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+Benchmark::Benchmark(Scene &scene, size_t frameCount)
+    : _scene(scene),
+      _frameCount(std::max(frameCount, static_cast<size_t>(1))) {}
+
+void Benchmark::loadPath(const std::string &path) {
+    std::ifstream file(path.c_str());
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open camera path: " + path);
+    }
+    std::vector<CameraPose> poses;
+    std::string             line;
+    while (std::getline(file, line)) {
+        std::istringstream lineStream(line);
+        CameraPose         pose;
+        if (lineStream >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yaw >>
+            pose.pitch) {
+            poses.push_back(pose);
+        }
+    }
+    if (poses.empty()) {
+        throw std::runtime_error("Camera path has no poses: " + path);
+    }
+    _path.swap(poses);
+    _pathSource = path;
+}
+
+// The camera backs off until the bounding sphere of the scene fills the vertical field of view,
+// and circles it slightly above its center
+void Benchmark::generateOrbit() {
+    static const size_t ORBIT_POSE_COUNT = 64;
+
+    AABB      bounds = _scene.getBounds();
+    glm::vec3 center = bounds.empty() ? glm::vec3(0.0f) : bounds.center();
+    float     radius = bounds.empty() ? 1.0f : glm::length(bounds.max - bounds.min) * 0.5f;
+    float     fieldOfView = glm::radians(_scene.getActiveCamera()->getFieldOfView());
+    float     distance = std::max(radius, 0.1f) / sinf(fieldOfView * 0.5f);
+
+    Camera camera;
+    _path.clear();
+    for (size_t i = 0; i <= ORBIT_POSE_COUNT; ++i) {
+        float angle =
+            glm::radians(360.0f) * static_cast<float>(i) / static_cast<float>(ORBIT_POSE_COUNT);
+        camera.setPosition(center + glm::vec3(cosf(angle), 0.3f, sinf(angle)) * distance);
+        camera.lookAt(center);
+        CameraPose pose = {camera.getPosition(), camera.getYaw(), camera.getPitch()};
+        _path.push_back(pose);
+    }
+    _pathSource = "orbit";
+}
+
+void Benchmark::addLoadStage(const LoadStage &stage) { _loadStages.push_back(stage); }
+
+void Benchmark::run(const std::function<void()> &endFrame) {
+    if (_path.empty()) {
+        generateOrbit();
+    }
+    std::shared_ptr<Camera> camera = _scene.getActiveCamera();
+    Profiler               &profiler = _scene.getProfiler();
+    _cpuMilliseconds.clear();
+    _gpuMilliseconds.clear();
+    _drawCalls.clear();
+    _triangles.clear();
+
+    GLuint queries[GPU_QUERY_LATENCY];
+    glGenQueries(GPU_QUERY_LATENCY, queries);
+    auto readGpuTime = [&](size_t frame) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[frame % GPU_QUERY_LATENCY], GL_QUERY_RESULT, &nanoseconds);
+        _gpuMilliseconds.push_back(static_cast<double>(nanoseconds) / 1e6);
+    };
+
+    for (size_t frame = 0; frame < _frameCount; ++frame) {
+        if (frame >= GPU_QUERY_LATENCY) {
+            readGpuTime(frame - GPU_QUERY_LATENCY);
+        }
+        CameraPose pose = _poseAt(frame);
+        camera->setPosition(pose.position);
+        camera->setOrientation(pose.yaw, pose.pitch);
+
+        auto start = std::chrono::steady_clock::now();
+        profiler.beginFrame();
+        glBeginQuery(GL_TIME_ELAPSED, queries[frame % GPU_QUERY_LATENCY]);
+        _scene.update();
+        _scene.render();
+        glEndQuery(GL_TIME_ELAPSED);
+        {
+            ProfileScope present(profiler, "present");
+            endFrame();
+        }
+        profiler.endFrame();
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        const RenderStats &stats = _scene.getRenderStats();
+        _cpuMilliseconds.push_back(elapsed.count());
+        _drawCalls.push_back(static_cast<double>(stats.drawCalls));
+        _triangles.push_back(static_cast<double>(stats.trianglesDrawn));
+    }
+    for (size_t frame = _frameCount > GPU_QUERY_LATENCY ? _frameCount - GPU_QUERY_LATENCY : 0;
+         frame < _frameCount; ++frame) {
+        readGpuTime(frame);
+    }
+    glDeleteQueries(GPU_QUERY_LATENCY, queries);
+}
+
+void Benchmark::writeReport(const std::string &path, const std::string &model, int width,
+                            int height) const {
+    std::ofstream out(path.c_str());
+    if (!out.is_open()) {
+        throw std::runtime_error("Cannot write benchmark report: " + path);
+    }
+
+    double loadTotal = 0.0;
+    out << "{\n"
+        << "  \"model\": " << jsonString(model) << ",\n"
+        << "  \"renderer\": " << jsonString(glString(GL_RENDERER)) << ",\n"
+        << "  \"glVersion\": " << jsonString(glString(GL_VERSION)) << ",\n"
+        << "  \"width\": " << width << ",\n"
+        << "  \"height\": " << height << ",\n"
+        << "  \"frames\": " << _frameCount << ",\n"
+        << "  \"cameraPath\": " << jsonString(_pathSource) << ",\n"
+        << "  \"loadMs\": {";
+    for (size_t i = 0; i < _loadStages.size(); ++i) {
+        out << (i ? ", " : "") << jsonString(_loadStages[i].name) << ": "
+            << _loadStages[i].milliseconds;
+        loadTotal += _loadStages[i].milliseconds;
+    }
+    out << (_loadStages.empty() ? "" : ", ") << "\"total\": " << loadTotal << "},\n";
+
+    writeDistribution(out, "cpuFrameMs", _cpuMilliseconds);
+    writeDistribution(out, "gpuFrameMs", _gpuMilliseconds);
+    writeDistribution(out, "drawCalls", _drawCalls);
+    writeDistribution(out, "triangles", _triangles);
+
+    long residentKb = 0, peakResidentKb = 0;
+    memoryUsage(residentKb, peakResidentKb);
+    out << "  \"memoryKb\": {\"resident\": " << residentKb
+        << ", \"peakResident\": " << peakResidentKb << "}\n"
+        << "}\n";
+}
+
+// Poses are spread evenly over the frames and interpolated linearly in between, turning the
+// short way around
+CameraPose Benchmark::_poseAt(size_t frame) const {
+    if (_path.size() == 1 || _frameCount == 1) {
+        return _path.front();
+    }
+    float position = static_cast<float>(frame) * static_cast<float>(_path.size() - 1) /
+                     static_cast<float>(_frameCount - 1);
+    size_t index = std::min(static_cast<size_t>(position), _path.size() - 2);
+    float  t = position - static_cast<float>(index);
+
+    const CameraPose &a = _path[index];
+    const CameraPose &b = _path[index + 1];
+    float             yawDelta = std::remainder(b.yaw - a.yaw, 360.0f);
+    CameraPose        pose = {glm::mix(a.position, b.position, t), a.yaw + yawDelta * t,
+                              a.pitch + (b.pitch - a.pitch) * t};
+    return pose;
+}
+
+CameraRecorder::CameraRecorder(const std::string &path) : _file(path.c_str()) {
+    if (!_file.is_open()) {
+        throw std::runtime_error("Cannot write camera path: " + path);
+    }
+}
+
+void CameraRecorder::record(const CameraPose &pose) {
+    _file << pose.position.x << " " << pose.position.y << " " << pose.position.z << " "
+          << pose.yaw << " " << pose.pitch << "\n";
+}
@@ -0,0 +1,330 @@
+#include "../include/Bvh.h"
+#include "../include/Culling.h"
+#include <algorithm>
+#include <cmath>
+
+static const unsigned int BIN_COUNT = 16;
+static const unsigned int MAX_LEAF_ITEMS = 4;
+
+// Past this share of changed items, one full bottom-up sweep beats walking up from every leaf
+static const size_t FULL_REFIT_DIVISOR = 8;
+
+static float rayBoxDistance(const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                            const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                            float maxDistance) {
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 tMin = glm::min(t0, t1);
+    glm::vec3 tMax = glm::max(t0, t1);
+    float     enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+    float     exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+    return enter <= exit ? enter : FLT_MAX;
+}
+
+Bvh::Bvh() {}
+
+const std::vector<Bvh::Node> &Bvh::getNodes() const { return _nodes; }
+
+size_t Bvh::getItemCount() const { return _items.size(); }
+
+void Bvh::build(const std::vector<AABB> &bounds) {
+    _nodes.clear();
+    _parents.clear();
+    _items.resize(bounds.size());
+    _itemLeafs.resize(bounds.size());
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        _items[i] = static_cast<unsigned int>(i);
+    }
+    if (bounds.empty()) {
+        return;
+    }
+
+    _nodes.reserve(bounds.size() * 2);
+    _parents.reserve(bounds.size() * 2);
+    _slotBounds = bounds;
+    _centroids.resize(bounds.size());
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        _centroids[i] = bounds[i].center();
+    }
+
+    Node root;
+    root.leftFirst = 0;
+    root.count = static_cast<unsigned int>(bounds.size());
+    _nodes.push_back(root);
+    _parents.push_back(0);
+    _updateNodeBounds(0, _slotBounds, false);
+
+    std::vector<unsigned int> stack(1, 0);
+    while (!stack.empty()) {
+        unsigned int nodeIndex = stack.back();
+        stack.pop_back();
+
+        size_t before = _nodes.size();
+        _subdivide(nodeIndex);
+        if (_nodes.size() != before) {
+            stack.push_back(_nodes[nodeIndex].leftFirst);
+            stack.push_back(_nodes[nodeIndex].leftFirst + 1);
+        }
+    }
+
+    for (unsigned int nodeIndex = 0; nodeIndex < _nodes.size(); ++nodeIndex) {
+        const Node &node = _nodes[nodeIndex];
+        for (unsigned int i = 0; i < node.count; ++i) {
+            _itemLeafs[_items[node.leftFirst + i]] = nodeIndex;
+        }
+    }
+    std::vector<AABB>().swap(_slotBounds);
+    std::vector<glm::vec3>().swap(_centroids);
+}
+
+void Bvh::_updateNodeBounds(unsigned int nodeIndex, const std::vector<AABB> &bounds,
+                            bool byItem) {
+    Node &node = _nodes[nodeIndex];
+    AABB  box;
+    for (unsigned int i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+        box.grow(bounds[byItem ? _items[i] : i]);
+    }
+    node.boundsMin = box.min;
+    node.boundsMax = box.max;
+}
+
+SahSplit findSahSplit(const std::vector<AABB> &slotBounds, const std::vector<glm::vec3> &centroids,
+                      unsigned int first, unsigned int count) {
+    SahSplit split;
+
+    AABB centroidBounds;
+    for (unsigned int i = first; i < first + count; ++i) {
+        centroidBounds.grow(centroids[i]);
+    }
+
+    // Small nodes get fewer bins: a handful of items cannot use sixteen split planes
+    unsigned int binCount = std::max(2u, std::min(BIN_COUNT, count));
+
+    for (int axis = 0; axis < 3; ++axis) {
+        float lower = centroidBounds.min[axis];
+        float upper = centroidBounds.max[axis];
+        if (!(upper > lower)) {
+            continue;
+        }
+
+        AABB         binBounds[BIN_COUNT];
+        unsigned int binCounts[BIN_COUNT] = {};
+        float        scale = static_cast<float>(binCount) / (upper - lower);
+        for (unsigned int i = first; i < first + count; ++i) {
+            unsigned int bin = std::min(
+                binCount - 1, static_cast<unsigned int>((centroids[i][axis] - lower) * scale));
+            binCounts[bin]++;
+            binBounds[bin].grow(slotBounds[i]);
+        }
+
+        // Sweep from both sides to get the area and count left and right of each plane
+        float        leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+        unsigned int leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+        AABB         leftBox, rightBox;
+        unsigned int leftSum = 0, rightSum = 0;
+        for (unsigned int i = 0; i < binCount - 1; ++i) {
+            leftSum += binCounts[i];
+            leftCount[i] = leftSum;
+            leftBox.grow(binBounds[i]);
+            leftArea[i] = leftBox.empty() ? 0.0f : leftBox.surfaceArea();
+            rightSum += binCounts[binCount - 1 - i];
+            rightCount[binCount - 2 - i] = rightSum;
+            rightBox.grow(binBounds[binCount - 1 - i]);
+            rightArea[binCount - 2 - i] = rightBox.empty() ? 0.0f : rightBox.surfaceArea();
+        }
+        for (unsigned int i = 0; i < binCount - 1; ++i) {
+            float cost = static_cast<float>(leftCount[i]) * leftArea[i] +
+                         static_cast<float>(rightCount[i]) * rightArea[i];
+            if (leftCount[i] > 0 && rightCount[i] > 0 && cost < split.cost) {
+                split.cost = cost;
+                split.axis = axis;
+                split.position = lower + static_cast<float>(i + 1) / scale;
+            }
+        }
+    }
+    return split;
+}
+
+unsigned int partitionSlots(const SahSplit &split, unsigned int first, unsigned int count,
+                            std::vector<unsigned int> &items, std::vector<AABB> &slotBounds,
+                            std::vector<glm::vec3> &centroids) {
+    unsigned int i = first;
+    unsigned int j = first + count - 1;
+    while (i <= j) {
+        if (centroids[i][split.axis] < split.position) {
+            i++;
+        } else {
+            std::swap(items[i], items[j]);
+            std::swap(slotBounds[i], slotBounds[j]);
+            std::swap(centroids[i], centroids[j]);
+            if (j == 0) {
+                break;
+            }
+            j--;
+        }
+    }
+    return i - first;
+}
+
+// Splits a leaf at the best SAH plane, or leaves it alone when no split beats the cost of
+// intersecting all of its items
+void Bvh::_subdivide(unsigned int nodeIndex) {
+    Node node = _nodes[nodeIndex];
+    if (node.count <= 1) {
+        return;
+    }
+
+    SahSplit split = findSahSplit(_slotBounds, _centroids, node.leftFirst, node.count);
+
+    AABB nodeBox;
+    nodeBox.min = node.boundsMin;
+    nodeBox.max = node.boundsMax;
+    float leafCost = static_cast<float>(node.count) * nodeBox.surfaceArea();
+    if (split.axis < 0 || (node.count <= MAX_LEAF_ITEMS && split.cost >= leafCost)) {
+        return;
+    }
+
+    unsigned int leftCount =
+        partitionSlots(split, node.leftFirst, node.count, _items, _slotBounds, _centroids);
+    if (leftCount == 0 || leftCount == node.count) {
+        return;
+    }
+
+    unsigned int leftIndex = static_cast<unsigned int>(_nodes.size());
+    Node         left, right;
+    left.leftFirst = node.leftFirst;
+    left.count = leftCount;
+    right.leftFirst = node.leftFirst + leftCount;
+    right.count = node.count - leftCount;
+    _nodes.push_back(left);
+    _nodes.push_back(right);
+    _parents.push_back(nodeIndex);
+    _parents.push_back(nodeIndex);
+
+    _nodes[nodeIndex].leftFirst = leftIndex;
+    _nodes[nodeIndex].count = 0;
+    _updateNodeBounds(leftIndex, _slotBounds, false);
+    _updateNodeBounds(leftIndex + 1, _slotBounds, false);
+}
+
+void Bvh::_refitNode(unsigned int nodeIndex, const std::vector<AABB> &bounds) {
+    Node &node = _nodes[nodeIndex];
+    if (node.count > 0) {
+        _updateNodeBounds(nodeIndex, bounds, true);
+        return;
+    }
+    const Node &left = _nodes[node.leftFirst];
+    const Node &right = _nodes[node.leftFirst + 1];
+    node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+    node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+}
+
+void Bvh::refit(const std::vector<AABB> &bounds, const std::vector<unsigned int> &changedItems) {
+    if (_nodes.empty() || changedItems.empty()) {
+        return;
+    }
+
+    if (changedItems.size() * FULL_REFIT_DIVISOR >= _items.size()) {
+        for (size_t i = _nodes.size(); i-- > 0;) {
+            _refitNode(static_cast<unsigned int>(i), bounds);
+        }
+        return;
+    }
+
+    for (unsigned int item : changedItems) {
+        unsigned int nodeIndex = _itemLeafs[item];
+        _refitNode(nodeIndex, bounds);
+        while (nodeIndex != 0) {
+            nodeIndex = _parents[nodeIndex];
+            _refitNode(nodeIndex, bounds);
+        }
+    }
+}
+
+void Bvh::queryFrustum(const Frustum &frustum, std::vector<unsigned int> &items) const {
+    if (_nodes.empty()) {
+        return;
+    }
+
+    // Nodes found entirely inside the frustum are expanded without further plane tests
+    std::vector<std::pair<unsigned int, bool>> stack;
+    stack.push_back(std::make_pair(0u, false));
+    while (!stack.empty()) {
+        unsigned int nodeIndex = stack.back().first;
+        bool         inside = stack.back().second;
+        stack.pop_back();
+
+        const Node &node = _nodes[nodeIndex];
+        if (!inside) {
+            AABB box;
+            box.min = node.boundsMin;
+            box.max = node.boundsMax;
+            FrustumTest test = aabbInFrustum(frustum, box);
+            if (test == FRUSTUM_OUTSIDE) {
+                continue;
+            }
+            inside = test == FRUSTUM_INSIDE;
+        }
+
+        if (node.count > 0) {
+            items.insert(items.end(), _items.begin() + node.leftFirst,
+                         _items.begin() + node.leftFirst + node.count);
+        } else {
+            stack.push_back(std::make_pair(node.leftFirst, inside));
+            stack.push_back(std::make_pair(node.leftFirst + 1, inside));
+        }
+    }
+}
+
+void Bvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+                  const std::function<float(unsigned int, float)> &visitor) const {
+    if (_nodes.empty()) {
+        return;
+    }
+
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    if (rayBoxDistance(origin, inverseDirection, _nodes[0].boundsMin, _nodes[0].boundsMax,
+                       maxDistance) >= FLT_MAX) {
+        return;
+    }
+
+    std::vector<std::pair<unsigned int, float>> stack;
+    stack.push_back(std::make_pair(0u, 0.0f));
+    while (!stack.empty()) {
+        unsigned int nodeIndex = stack.back().first;
+        float        entry = stack.back().second;
+        stack.pop_back();
+        if (entry > maxDistance) {
+            continue;
+        }
+
+        const Node &node = _nodes[nodeIndex];
+        if (node.count > 0) {
+            for (unsigned int i = 0; i < node.count; ++i) {
+                maxDistance =
+                    std::min(maxDistance, visitor(_items[node.leftFirst + i], maxDistance));
+            }
+            continue;
+        }
+
+        // Push the farther child first so the nearer one is visited next
+        const Node &left = _nodes[node.leftFirst];
+        const Node &right = _nodes[node.leftFirst + 1];
+        float       leftDistance = rayBoxDistance(origin, inverseDirection, left.boundsMin,
+                                                  left.boundsMax, maxDistance);
+        float       rightDistance = rayBoxDistance(origin, inverseDirection, right.boundsMin,
+                                                   right.boundsMax, maxDistance);
+        unsigned int nearChild = node.leftFirst;
+        unsigned int farChild = node.leftFirst + 1;
+        if (rightDistance < leftDistance) {
+            std::swap(leftDistance, rightDistance);
+            std::swap(nearChild, farChild);
+        }
+        if (rightDistance < FLT_MAX) {
+            stack.push_back(std::make_pair(farChild, rightDistance));
+        }
+        if (leftDistance < FLT_MAX) {
+            stack.push_back(std::make_pair(nearChild, leftDistance));
+        }
+    }
+}
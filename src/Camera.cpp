@@ -1,4 +1,6 @@
 #include "../include/Camera.h"
+#include <algorithm>
+#include <cmath>
 
 Camera::Camera(const glm::vec3 &position, const glm::vec3 &up, float yaw, float pitch)
     : _position(position),
@@ -67,6 +69,30 @@ void Camera::setPosition(const glm::vec3 &position) { _position = position; }
 
 glm::vec3 Camera::getPosition() const { return _position; }
 
+glm::vec3 Camera::getFront() const { return _front; }
+
+void Camera::setOrientation(float yaw, float pitch) {
+    _yaw = yaw;
+    _pitch = pitch;
+    _updateCameraVectors();
+}
+
+float Camera::getYaw() const { return _yaw; }
+
+float Camera::getPitch() const { return _pitch; }
+
+// Inverse of _updateCameraVectors: the yaw and pitch whose front vector points at target
+void Camera::lookAt(const glm::vec3 &target) {
+    glm::vec3 direction = target - _position;
+    float     length = glm::length(direction);
+    if (length <= FLT_MIN) {
+        return;
+    }
+    direction /= length;
+    setOrientation(glm::degrees(atan2f(direction.z, direction.x)),
+                   glm::degrees(asinf(std::max(-1.0f, std::min(1.0f, direction.y)))));
+}
+
 void Camera::setFieldOfView(float fov) { _fieldOfView = fov; }
 
 float Camera::getFieldOfView() const { return _fieldOfView; }
@@ -75,6 +101,8 @@ void Camera::setAspectRatio(float aspectRatio) { _aspectRatio = aspectRatio; }
 
 float Camera::getAspectRatio() const { return _aspectRatio; }
 
+float Camera::getNearPlane() const { return _nearPlane; }
+
 void Camera::_updateCameraVectors() {
     // Calculate the new front vector
     glm::vec3 newFront;
@@ -0,0 +1,69 @@
+#include "../include/Culling.h"
+
+// Gribb/Hartmann plane extraction: each plane is a sum or difference of the matrix rows
+Frustum extractFrustum(const glm::mat4 &viewProjection) {
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i],
+                            viewProjection[3][i]);
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // left
+    frustum.planes[1] = rows[3] - rows[0]; // right
+    frustum.planes[2] = rows[3] + rows[1]; // bottom
+    frustum.planes[3] = rows[3] - rows[1]; // top
+    frustum.planes[4] = rows[3] + rows[2]; // near
+    frustum.planes[5] = rows[3] - rows[2]; // far
+    return frustum;
+}
+
+// Tests the corner furthest along each plane normal (outside if even that one is behind) and the
+// nearest one (fully inside if every nearest corner is in front)
+FrustumTest aabbInFrustum(const Frustum &frustum, const AABB &box) {
+    FrustumTest result = FRUSTUM_INSIDE;
+    for (const auto &plane : frustum.planes) {
+        glm::vec3 farCorner(plane.x >= 0.0f ? box.max.x : box.min.x,
+                            plane.y >= 0.0f ? box.max.y : box.min.y,
+                            plane.z >= 0.0f ? box.max.z : box.min.z);
+        glm::vec3 nearCorner(plane.x >= 0.0f ? box.min.x : box.max.x,
+                             plane.y >= 0.0f ? box.min.y : box.max.y,
+                             plane.z >= 0.0f ? box.min.z : box.max.z);
+        if (glm::dot(glm::vec3(plane), farCorner) + plane.w < 0.0f) {
+            return FRUSTUM_OUTSIDE;
+        }
+        if (glm::dot(glm::vec3(plane), nearCorner) + plane.w < 0.0f) {
+            result = FRUSTUM_INTERSECTS;
+        }
+    }
+    return result;
+}
+
+AABB transformAABB(const AABB &box, const glm::mat4 &matrix) {
+    if (box.empty()) {
+        return box;
+    }
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(box.center(), 1.0f));
+    glm::vec3 halfExtent = (box.max - box.min) * 0.5f;
+    glm::vec3 extent(0.0f);
+    for (int column = 0; column < 3; ++column) {
+        extent += glm::abs(glm::vec3(matrix[column])) * halfExtent[column];
+    }
+    AABB result;
+    result.min = center - extent;
+    result.max = center + extent;
+    return result;
+}
+
+// Planes are left unnormalized so they stay exact when pulled back into object space; the distance
+// is compared against the radius scaled by each plane's normal length instead
+bool sphereInFrustum(const Frustum &frustum, const glm::vec3 &center, float radius) {
+    for (const auto &plane : frustum.planes) {
+        glm::vec3 normal(plane);
+        float     distance = glm::dot(normal, center) + plane.w;
+        if (distance < -radius * glm::length(normal)) {
+            return false;
+        }
+    }
+    return true;
+}
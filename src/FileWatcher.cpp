@@ -0,0 +1,90 @@
+#include "../include/FileWatcher.h"
+#include "../include/Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef SCOP_HAS_INOTIFY
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Splits a path into its directory, "." when it has none, and its file name
+static void splitPath(const std::string &path, std::string &directory, std::string &name) {
+    size_t pos = path.find_last_of('/');
+    if (pos == std::string::npos) {
+        directory = ".";
+        name = path;
+    } else {
+        directory = pos == 0 ? "/" : path.substr(0, pos);
+        name = path.substr(pos + 1);
+    }
+}
+
+FileWatcher::FileWatcher() : _fd(-1) {
+#ifdef SCOP_HAS_INOTIFY
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_fd < 0) {
+        throw std::runtime_error(std::string("Cannot initialize inotify: ") + strerror(errno));
+    }
+#else
+    throw std::runtime_error("Built without inotify, files cannot be watched");
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef SCOP_HAS_INOTIFY
+    close(_fd); // removes the watches too
+#endif
+}
+
+// Every file of a directory shares its watch, which inotify gives back for the same directory
+void FileWatcher::watch(const std::string &path) {
+    if (_paths.count(path)) {
+        return;
+    }
+#ifdef SCOP_HAS_INOTIFY
+    std::string directory;
+    std::string name;
+    splitPath(path, directory, name);
+    int watch = inotify_add_watch(_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch < 0) {
+        LogMessage(LOG_WARNING) << "Cannot watch " << path << ": " << strerror(errno);
+        return;
+    }
+    _directoryFiles[watch].push_back(path);
+    _paths.insert(path);
+#endif
+}
+
+bool FileWatcher::isWatched(const std::string &path) const { return _paths.count(path) != 0; }
+
+std::vector<std::string> FileWatcher::poll() {
+    std::vector<std::string> changed;
+#ifdef SCOP_HAS_INOTIFY
+    alignas(inotify_event) char buffer[4096];
+    ssize_t                     length;
+    while ((length = read(_fd, buffer, sizeof(buffer))) > 0) {
+        ssize_t offset = 0;
+        while (offset < length) {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            auto files = _directoryFiles.find(event->wd);
+            if (event->len == 0 || files == _directoryFiles.end()) {
+                continue;
+            }
+            for (const auto &path : files->second) {
+                std::string directory;
+                std::string name;
+                splitPath(path, directory, name);
+                if (name == event->name &&
+                    std::find(changed.begin(), changed.end(), path) == changed.end()) {
+                    changed.push_back(path);
+                }
+            }
+        }
+    }
+#endif
+    return changed;
+}
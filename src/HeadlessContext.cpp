@@ -0,0 +1,177 @@
+#include "../include/HeadlessContext.h"
+#include "../include/Logger.h"
+#include "../include/Shader.h"
+#include <fstream>
+
+#ifdef SCOP_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+HeadlessContext::HeadlessContext(int width, int height)
+    : _display(nullptr),
+      _context(nullptr),
+      _framebuffer(0),
+      _colorBuffer(0),
+      _depthBuffer(0),
+      _width(std::max(width, 1)),
+      _height(std::max(height, 1)) {
+    // The destructor does not run for a constructor that throws
+    try {
+        _createContext();
+        _createFramebuffer();
+    } catch (const std::runtime_error &) {
+        _destroy();
+        throw;
+    }
+}
+
+HeadlessContext::~HeadlessContext() { _destroy(); }
+
+// Releases whatever was created so far; GL objects only exist once the context is current
+void HeadlessContext::_destroy() {
+    if (_framebuffer != 0)
+        glDeleteFramebuffers(1, &_framebuffer);
+    if (_colorBuffer != 0)
+        glDeleteRenderbuffers(1, &_colorBuffer);
+    if (_depthBuffer != 0)
+        glDeleteRenderbuffers(1, &_depthBuffer);
+    _framebuffer = _colorBuffer = _depthBuffer = 0;
+#ifdef SCOP_HAS_EGL
+    EGLDisplay display = _display;
+    if (!display) {
+        return;
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (_context) {
+        eglDestroyContext(display, _context);
+    }
+    eglTerminate(display);
+    _display = _context = nullptr;
+#endif
+}
+
+void HeadlessContext::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glViewport(0, 0, _width, _height);
+}
+
+GLuint HeadlessContext::getFramebuffer() const { return _framebuffer; }
+
+int HeadlessContext::getWidth() const { return _width; }
+
+int HeadlessContext::getHeight() const { return _height; }
+
+void HeadlessContext::writeImage(const std::string &path) const {
+    size_t rowSize = static_cast<size_t>(_width) * 3;
+    std::vector<unsigned char> pixels(rowSize * static_cast<size_t>(_height));
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot write image: " + path);
+    }
+    file << "P6\n" << _width << " " << _height << "\n255\n";
+    // OpenGL rows start at the bottom
+    for (size_t row = static_cast<size_t>(_height); row-- > 0;) {
+        file.write(reinterpret_cast<const char *>(&pixels[row * rowSize]),
+                   static_cast<std::streamsize>(rowSize));
+    }
+}
+
+#ifdef SCOP_HAS_EGL
+// The surfaceless platform needs no GPU device or display server; older drivers only offer the
+// default display
+static EGLDisplay openDisplay() {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+        EGLDisplay display =
+            getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY) {
+            return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+#endif
+
+// Asks for the 4.6 core profile the window gets, then 4.5, the most llvmpipe offers
+void HeadlessContext::_createContext() {
+#ifdef SCOP_HAS_EGL
+    EGLDisplay display = openDisplay();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        throw std::runtime_error("Failed to initialize an EGL display");
+    }
+    _display = display;
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        throw std::runtime_error("EGL display does not support desktop OpenGL");
+    }
+
+    // The default surface type is a window, which surfaceless displays have no config for
+    static const EGLint CONFIG_ATTRIBUTES[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                               EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig           config;
+    EGLint              configCount = 0;
+    if (!eglChooseConfig(display, CONFIG_ATTRIBUTES, &config, 1, &configCount) ||
+        configCount == 0) {
+        throw std::runtime_error("No EGL config supports desktop OpenGL");
+    }
+
+    static const EGLint MINOR_VERSIONS[] = {6, 5};
+    EGLContext          context = EGL_NO_CONTEXT;
+    for (EGLint minor : MINOR_VERSIONS) {
+        const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                            4,
+                                            EGL_CONTEXT_MINOR_VERSION,
+                                            minor,
+                                            EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                            EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                            EGL_NONE};
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context != EGL_NO_CONTEXT) {
+            break;
+        }
+    }
+    if (context == EGL_NO_CONTEXT) {
+        throw std::runtime_error("Failed to create an OpenGL 4.5+ core context with EGL");
+    }
+    _context = context;
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        throw std::runtime_error("EGL surfaceless contexts are not supported");
+    }
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+        throw std::runtime_error("Failed to initialize GLAD");
+    }
+    Shader::enableParallelCompile(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+    LogMessage(LOG_INFO) << "Headless OpenGL " << glGetString(GL_VERSION) << " on "
+                         << glGetString(GL_RENDERER);
+#else
+    throw std::runtime_error("Scop was built without EGL, headless mode is unavailable");
+#endif
+}
+
+// Depth and stencil share a format with a default window framebuffer, so the same depth blits
+// work on both
+void HeadlessContext::_createFramebuffer() {
+    glGenRenderbuffers(1, &_colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, _width, _height);
+    glGenRenderbuffers(1, &_depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, _width, _height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER,
+                              _depthBuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Offscreen framebuffer is incomplete");
+    }
+}
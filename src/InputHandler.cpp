@@ -1,5 +1,7 @@
 #include "../include/InputHandler.h"
 #include "../include/Camera.h"
+#include "../include/Logger.h"
+#include "../include/Mesh.h"
 #include "../include/Scene.h"
 
 const float EPSILON = 1e-6f;
@@ -13,6 +15,7 @@ float                  InputHandler::_mouseDeltaX = 0.0f;
 float                  InputHandler::_mouseDeltaY = 0.0f;
 float                  InputHandler::_scrollOffset = 0.0f;
 bool                   InputHandler::_firstMouse = true;
+bool                   InputHandler::_pickRequested = false;
 std::array<bool, 1024> InputHandler::_keys;
 
 void InputHandler::initialize(GLFWwindow *win, Scene *scene) {
@@ -28,6 +31,7 @@ void InputHandler::initialize(GLFWwindow *win, Scene *scene) {
     // Set GLFW callbacks
     glfwSetCursorPosCallback(_window, mouseCallback);
     glfwSetScrollCallback(_window, scrollCallback);
+    glfwSetMouseButtonCallback(_window, mouseButtonCallback);
 
     // Disable cursor
     glfwSetInputMode(_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -64,6 +68,46 @@ void InputHandler::processInput(float deltaTime) {
         _keys.at(GLFW_KEY_2) = false;
     }
 
+    // Toggle level of detail selection to compare triangle counts
+    if (glfwGetKey(_window, GLFW_KEY_L) == GLFW_PRESS) {
+        if (!_keys.at(GLFW_KEY_L)) {
+            _scene->setLodEnabled(!_scene->isLodEnabled());
+            _keys.at(GLFW_KEY_L) = true;
+        }
+    } else {
+        _keys.at(GLFW_KEY_L) = false;
+    }
+
+    // Toggle per-meshlet frustum and cone culling
+    if (glfwGetKey(_window, GLFW_KEY_M) == GLFW_PRESS) {
+        if (!_keys.at(GLFW_KEY_M)) {
+            _scene->setMeshletCullingEnabled(!_scene->isMeshletCullingEnabled());
+            _keys.at(GLFW_KEY_M) = true;
+        }
+    } else {
+        _keys.at(GLFW_KEY_M) = false;
+    }
+
+    // Toggle weighted blended order-independent transparency
+    if (glfwGetKey(_window, GLFW_KEY_O) == GLFW_PRESS) {
+        if (!_keys.at(GLFW_KEY_O)) {
+            _scene->setWeightedOitEnabled(!_scene->isWeightedOitEnabled());
+            _keys.at(GLFW_KEY_O) = true;
+        }
+    } else {
+        _keys.at(GLFW_KEY_O) = false;
+    }
+
+    // Toggle the profiler overlay
+    if (glfwGetKey(_window, GLFW_KEY_P) == GLFW_PRESS) {
+        if (!_keys.at(GLFW_KEY_P)) {
+            _scene->setProfilerOverlayEnabled(!_scene->isProfilerOverlayEnabled());
+            _keys.at(GLFW_KEY_P) = true;
+        }
+    } else {
+        _keys.at(GLFW_KEY_P) = false;
+    }
+
     // Movement keys
     if (glfwGetKey(_window, GLFW_KEY_W) == GLFW_PRESS)
         camera->processKeyboard(FORWARD, deltaTime);
@@ -91,6 +135,11 @@ void InputHandler::processInput(float deltaTime) {
         _scrollOffset = 0.0f;
     }
 
+    if (_pickRequested) {
+        _pick(*camera);
+        _pickRequested = false;
+    }
+
     // if numkey 1 is press switch to wireframe mode
     if (glfwGetKey(_window, GLFW_KEY_1) == GLFW_PRESS) {
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -121,3 +170,24 @@ void InputHandler::scrollCallback(GLFWwindow *window, double xoffset, double yof
     (void)xoffset;
     _scrollOffset = static_cast<float>(yoffset);
 }
+
+void InputHandler::mouseButtonCallback(GLFWwindow *window, int button, int action, int mods) {
+    (void)window;
+    (void)mods;
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+        _pickRequested = true;
+    }
+}
+
+// The cursor is captured by the camera, so picking shoots a ray through the center of the screen
+void InputHandler::_pick(const Camera &camera) {
+    RaycastHit hit;
+    if (!_scene->raycast(camera.getPosition(), camera.getFront(), hit)) {
+        LogMessage(LOG_INFO) << "Pick: nothing under the crosshair";
+        return;
+    }
+    LogMessage(LOG_INFO) << "Pick: triangle " << hit.triangle << " of instance " << hit.instance
+                         << " ('" << hit.mesh->getMaterialName() << "') at (" << hit.position.x
+                         << ", " << hit.position.y << ", " << hit.position.z << "), distance "
+                         << hit.distance;
+}
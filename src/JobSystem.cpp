@@ -0,0 +1,192 @@
+#include "../include/JobSystem.h"
+#include <algorithm>
+
+// Rounds an idle worker looks for work before going to sleep
+static const int IDLE_SPINS = 64;
+
+const int64_t JobSystem::Deque::CAPACITY;
+
+thread_local JobSystem *JobSystem::_threadSystem = nullptr;
+thread_local size_t     JobSystem::_threadIndex = 0;
+
+JobSystem::Deque::Deque() : _top(0), _bottom(0) {
+    for (auto &slot : _buffer) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+bool JobSystem::Deque::push(Job *job) {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_acquire);
+    if (bottom - top >= CAPACITY) {
+        return false;
+    }
+    _buffer[bottom & (CAPACITY - 1)].store(job, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+// Claims the bottom job; when it is also the top one, races the thieves for it
+JobSystem::Job *JobSystem::Deque::pop() {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = _top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job *job = _buffer[bottom & (CAPACITY - 1)].load(std::memory_order_acquire);
+    if (top == bottom) {
+        if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job *JobSystem::Deque::steal() {
+    int64_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = _bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+        return nullptr;
+    }
+    Job *job = _buffer[top & (CAPACITY - 1)].load(std::memory_order_acquire);
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+        return nullptr; // another thief or the owner got it
+    }
+    return job;
+}
+
+JobSystem::JobSystem(size_t workerCount)
+    : _queuedJobs(0),
+      _sleepingWorkers(0),
+      _stopping(false) {
+    for (size_t i = 0; i < workerCount; ++i) {
+        _deques.emplace_back(new Deque());
+    }
+    for (size_t i = 0; i < workerCount; ++i) {
+        _workers.emplace_back(&JobSystem::_workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stopping = true;
+    }
+    _wakeUp.notify_all();
+    for (auto &worker : _workers) {
+        worker.join();
+    }
+    for (auto &deque : _deques) {
+        while (Job *job = deque->steal()) {
+            delete job;
+        }
+    }
+    for (Job *job : _sharedJobs) {
+        delete job;
+    }
+}
+
+JobSystem &JobSystem::getDefault() {
+    static JobSystem system(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return system;
+}
+
+void JobSystem::run(std::function<void()> job, JobCounter *counter) {
+    if (counter) {
+        counter->_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Counted before it can be taken, so the count never drops below the jobs really queued
+    Job *queued = new Job{std::move(job), counter};
+    _queuedJobs.fetch_add(1);
+    if (_threadSystem == this) {
+        if (!_deques[_threadIndex]->push(queued)) {
+            _queuedJobs.fetch_sub(1);
+            _execute(queued); // deque full: running it now still makes progress
+            return;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(_sharedMutex);
+        _sharedJobs.push_back(queued);
+    }
+    _wakeWorker();
+}
+
+void JobSystem::wait(JobCounter &counter) {
+    while (!counter.isDone()) {
+        if (Job *job = _findJob()) {
+            _execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+size_t JobSystem::getWorkerCount() const { return _workers.size(); }
+
+void JobSystem::_workerLoop(size_t index) {
+    _threadSystem = this;
+    _threadIndex = index;
+    int idleRounds = 0;
+    while (!_stopping) {
+        if (Job *job = _findJob()) {
+            _execute(job);
+            idleRounds = 0;
+        } else if (++idleRounds < IDLE_SPINS) {
+            std::this_thread::yield();
+        } else {
+            // Counting this worker as asleep before checking for jobs pairs with run() counting
+            // the job before checking for sleepers, so one of them always sees the other
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _sleepingWorkers.fetch_add(1);
+            _wakeUp.wait(lock, [this]() { return _queuedJobs.load() > 0 || _stopping; });
+            _sleepingWorkers.fetch_sub(1);
+            idleRounds = 0;
+        }
+    }
+}
+
+// Own deque first, then jobs from outside the pool, then the other workers' deques
+JobSystem::Job *JobSystem::_findJob() {
+    bool isWorker = _threadSystem == this;
+    Job *job = isWorker ? _deques[_threadIndex]->pop() : nullptr;
+    if (!job && _queuedJobs.load(std::memory_order_relaxed) > 0) {
+        {
+            std::lock_guard<std::mutex> lock(_sharedMutex);
+            if (!_sharedJobs.empty()) {
+                job = _sharedJobs.front();
+                _sharedJobs.pop_front();
+            }
+        }
+        size_t start = isWorker ? _threadIndex + 1 : 0;
+        for (size_t i = 0; !job && i < _deques.size(); ++i) {
+            job = _deques[(start + i) % _deques.size()]->steal();
+        }
+    }
+    if (job) {
+        _queuedJobs.fetch_sub(1);
+    }
+    return job;
+}
+
+void JobSystem::_execute(Job *job) {
+    job->function();
+    if (job->counter) {
+        job->counter->_pending.fetch_sub(1, std::memory_order_release);
+    }
+    delete job;
+}
+
+void JobSystem::_wakeWorker() {
+    if (_sleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _wakeUp.notify_one();
+    }
+}
@@ -0,0 +1,202 @@
+#include "../include/LoadStats.h"
+#include "../include/Json.h"
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <sys/resource.h>
+
+// Memory is sampled at most this often inside a stage, getrusage being a system call
+static const std::chrono::milliseconds MEMORY_SAMPLE_PERIOD(1);
+
+#ifdef SCOP_COUNT_ALLOCATIONS
+// Per thread, so that the render, logger and worker threads are not charged to the load stages
+static thread_local uint64_t allocationCount = 0;
+
+void *operator new(std::size_t size) {
+    ++allocationCount;
+    void *memory = std::malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+#endif
+
+thread_local LoadStats      *LoadStats::_active = nullptr;
+thread_local LoadStageScope *LoadStageScope::_current = nullptr;
+
+static double megabytesPerSecond(uint64_t bytes, double milliseconds) {
+    return milliseconds > 0.0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) /
+                                    (milliseconds / 1000.0)
+                              : 0.0;
+}
+
+// Allocation counts as reported, left out when they are not counted
+static std::string allocationText(uint64_t allocations) {
+    return LoadStats::countsAllocations() ? std::to_string(allocations) : std::string();
+}
+
+static std::string allocationJson(uint64_t allocations) {
+    return LoadStats::countsAllocations() ? std::to_string(allocations) : std::string("null");
+}
+
+LoadStats::LoadStats()
+    : _totalMilliseconds(0.0),
+      _startAllocations(0),
+      _totalAllocations(0),
+      _peakRssKb(0) {}
+
+void LoadStats::start() {
+    _stages.clear();
+    _start = _lastMemorySample = Clock::now();
+    _startAllocations = getAllocationCount();
+    _active = this;
+}
+
+void LoadStats::stop() {
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - _start;
+    _totalMilliseconds = elapsed.count();
+    _totalAllocations = getAllocationCount() - _startAllocations;
+    _peakRssKb = getProcessPeakRssKb();
+    if (_active == this) {
+        _active = nullptr;
+    }
+}
+
+const std::vector<LoadStage> &LoadStats::getStages() const { return _stages; }
+
+double LoadStats::getTotalMilliseconds() const { return _totalMilliseconds; }
+
+uint64_t LoadStats::getTotalAllocations() const { return _totalAllocations; }
+
+long LoadStats::getPeakRssKb() const { return _peakRssKb; }
+
+void LoadStats::printSummary(std::ostream &out) const {
+    std::ios::fmtflags flags = out.flags();
+    out << std::left << std::setw(16) << "Load stage" << std::right << std::setw(11) << "ms"
+        << std::setw(11) << "MB" << std::setw(11) << "MB/s" << std::setw(12)
+        << (countsAllocations() ? "allocs" : "") << std::setw(14) << "peak RSS MB" << "\n"
+        << std::fixed << std::setprecision(2);
+    double accounted = 0.0;
+    for (const LoadStage &stage : _stages) {
+        out << std::left << std::setw(16) << stage.name << std::right << std::setw(11)
+            << stage.milliseconds << std::setw(11)
+            << static_cast<double>(stage.bytes) / (1024.0 * 1024.0) << std::setw(11)
+            << megabytesPerSecond(stage.bytes, stage.milliseconds) << std::setw(12)
+            << allocationText(stage.allocations) << std::setw(14)
+            << static_cast<double>(stage.peakRssKb) / 1024.0 << "\n";
+        accounted += stage.milliseconds;
+    }
+    out << std::left << std::setw(16) << "other" << std::right << std::setw(11)
+        << std::max(_totalMilliseconds - accounted, 0.0) << "\n"
+        << std::left << std::setw(16) << "total" << std::right << std::setw(11)
+        << _totalMilliseconds << std::setw(34) << allocationText(_totalAllocations)
+        << std::setw(14) << static_cast<double>(_peakRssKb) / 1024.0 << std::endl;
+    out.flags(flags);
+}
+
+void LoadStats::writeJson(const std::string &path, const std::string &model) const {
+    std::ofstream out(path.c_str());
+    if (!out.is_open()) {
+        throw std::runtime_error("Cannot write load report: " + path);
+    }
+    out << "{\n"
+        << "  \"model\": " << jsonString(model) << ",\n"
+        << "  \"totalMs\": " << _totalMilliseconds << ",\n"
+        << "  \"allocations\": " << allocationJson(_totalAllocations) << ",\n"
+        << "  \"peakRssKb\": " << _peakRssKb << ",\n"
+        << "  \"stages\": [";
+    for (size_t i = 0; i < _stages.size(); ++i) {
+        const LoadStage &stage = _stages[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": " << jsonString(stage.name)
+            << ", \"ms\": " << stage.milliseconds << ", \"bytes\": " << stage.bytes
+            << ", \"mbPerSecond\": " << megabytesPerSecond(stage.bytes, stage.milliseconds)
+            << ", \"allocations\": " << allocationJson(stage.allocations)
+            << ", \"peakRssKb\": " << stage.peakRssKb << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+uint64_t LoadStats::getAllocationCount() {
+#ifdef SCOP_COUNT_ALLOCATIONS
+    return allocationCount;
+#else
+    return 0;
+#endif
+}
+
+long LoadStats::getProcessPeakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+bool LoadStats::countsAllocations() {
+#ifdef SCOP_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t LoadStats::_stageIndex(const char *name) {
+    for (size_t i = 0; i < _stages.size(); ++i) {
+        if (_stages[i].name == name) {
+            return i;
+        }
+    }
+    LoadStage stage = {name, 0.0, 0, 0, 0};
+    _stages.push_back(stage);
+    return _stages.size() - 1;
+}
+
+void LoadStats::_sampleMemory(LoadStage &stage, Clock::time_point now, bool force) {
+    if (force || now - _lastMemorySample >= MEMORY_SAMPLE_PERIOD) {
+        _lastMemorySample = now;
+        stage.peakRssKb = getProcessPeakRssKb();
+    }
+}
+
+LoadStageScope::LoadStageScope(const char *name, uint64_t bytes)
+    : _stats(LoadStats::_active),
+      _stage(0),
+      _bytes(bytes),
+      _startAllocations(0),
+      _childTime(0),
+      _childAllocations(0),
+      _parent(nullptr) {
+    if (!_stats) {
+        return;
+    }
+    _stage = _stats->_stageIndex(name);
+    _start = LoadStats::Clock::now();
+    _startAllocations = LoadStats::getAllocationCount();
+    _parent = _current;
+    _current = this;
+}
+
+LoadStageScope::~LoadStageScope() {
+    if (!_stats) {
+        return;
+    }
+    LoadStats::Clock::time_point now = LoadStats::Clock::now();
+    LoadStats::Clock::duration   elapsed = now - _start;
+    uint64_t allocations = LoadStats::getAllocationCount() - _startAllocations;
+    _current = _parent;
+    if (_parent) {
+        _parent->_childTime += elapsed;
+        _parent->_childAllocations += allocations;
+    }
+
+    std::chrono::duration<double, std::milli> exclusive = elapsed - _childTime;
+    LoadStage                                &stage = _stats->_stages[_stage];
+    stage.milliseconds += exclusive.count();
+    stage.bytes += _bytes;
+    stage.allocations += allocations - _childAllocations;
+    _stats->_sampleMemory(stage, now, !_parent || stage.peakRssKb == 0);
+}
+
+void LoadStageScope::addBytes(uint64_t bytes) { _bytes += bytes; }
@@ -0,0 +1,153 @@
+#include "../include/Logger.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// How long the writer sleeps when the ring is empty; bounds the delay before a message shows
+static const std::chrono::milliseconds WRITER_IDLE_SLEEP(2);
+
+// Logger::_state bits: whether the writer runs, then how many write() calls are queueing
+static const size_t RUNNING = 1;
+static const size_t WRITE_STEP = 2;
+
+const size_t Logger::RING_SIZE;
+
+Logger::Slot        Logger::_ring[RING_SIZE];
+std::atomic<size_t> Logger::_enqueuePosition(0);
+size_t              Logger::_dequeuePosition = 0;
+std::atomic<int>    Logger::_level(LOG_INFO);
+std::atomic<size_t> Logger::_state(0);
+std::atomic<size_t> Logger::_dropped(0);
+std::thread         Logger::_writer;
+
+void Logger::start(LogLevel level) {
+    if (_state & RUNNING) {
+        return;
+    }
+    setLevel(level);
+    for (size_t i = 0; i < RING_SIZE; ++i) {
+        _ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _enqueuePosition.store(0, std::memory_order_relaxed);
+    _dequeuePosition = 0;
+    _dropped = 0;
+    _state.fetch_or(RUNNING);
+    _writer = std::thread(_writerLoop);
+}
+
+// Once RUNNING is cleared no write() starts queueing, but those that saw it set may still be
+// filling their slot; the last drain waits for them so that none of their messages is lost
+void Logger::stop() {
+    if (!(_state & RUNNING)) {
+        return;
+    }
+    _state.fetch_and(~RUNNING);
+    _writer.join();
+    while (_state.load() != 0) {
+        std::this_thread::yield();
+    }
+    _drain();
+    if (_dropped) {
+        std::fprintf(stderr, "Warning: %zu log messages dropped\n", _dropped.load());
+    }
+}
+
+void Logger::setLevel(LogLevel level) { _level = level; }
+
+LogLevel Logger::getLevel() { return static_cast<LogLevel>(_level.load()); }
+
+bool Logger::isEnabled(LogLevel level) { return level <= _level.load(std::memory_order_relaxed); }
+
+void Logger::write(LogLevel level, std::string message) {
+    if (!isEnabled(level)) {
+        return;
+    }
+    if (_state.load() & RUNNING) {
+        if (_state.fetch_add(WRITE_STEP) & RUNNING) {
+            _enqueue(level, message);
+            _state.fetch_sub(WRITE_STEP);
+            return;
+        }
+        _state.fetch_sub(WRITE_STEP);
+    }
+    _output(level, message + "\n");
+}
+
+// A producer claims a position whose slot the writer has released, fills it, then publishes it
+// by bumping its sequence; the writer consumes slots in position order
+void Logger::_enqueue(LogLevel level, std::string &message) {
+    size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot    &slot = _ring[position & (RING_SIZE - 1)];
+        size_t   sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (_enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                       std::memory_order_relaxed)) {
+                slot.level = level;
+                slot.message.swap(message);
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return;
+            }
+        } else if (difference < 0) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = _enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t Logger::getDroppedCount() { return _dropped.load(); }
+
+void Logger::_writerLoop() {
+    while (_state.load(std::memory_order_relaxed) & RUNNING) {
+        if (!_drain()) {
+            std::this_thread::sleep_for(WRITER_IDLE_SLEEP);
+        }
+    }
+}
+
+// Consecutive messages to the same stream are written and flushed together
+bool Logger::_drain() {
+    std::string batch;
+    LogLevel    batchLevel = LOG_INFO;
+    bool        wrote = false;
+    for (;;) {
+        Slot  &slot = _ring[_dequeuePosition & (RING_SIZE - 1)];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != _dequeuePosition + 1) {
+            break;
+        }
+        bool toStderr = slot.level <= LOG_WARNING;
+        if (!batch.empty() && toStderr != (batchLevel <= LOG_WARNING)) {
+            _output(batchLevel, batch);
+            batch.clear();
+        }
+        batchLevel = slot.level;
+        batch += slot.message;
+        batch += '\n';
+        slot.message.clear();
+        slot.sequence.store(_dequeuePosition + RING_SIZE, std::memory_order_release);
+        _dequeuePosition++;
+        wrote = true;
+    }
+    if (!batch.empty()) {
+        _output(batchLevel, batch);
+    }
+    return wrote;
+}
+
+void Logger::_output(LogLevel level, const std::string &text) {
+    std::FILE *stream = level <= LOG_WARNING ? stderr : stdout;
+    std::fwrite(text.data(), 1, text.size(), stream);
+    std::fflush(stream);
+}
+
+LogMessage::LogMessage(LogLevel level) : _level(level), _enabled(Logger::isEnabled(level)) {}
+
+LogMessage::~LogMessage() {
+    if (_enabled) {
+        Logger::write(_level, _stream.str());
+    }
+}
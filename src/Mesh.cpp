@@ -1,15 +1,82 @@
 #include "../include/Mesh.h"
+#include "../include/Culling.h"
+#include "../include/LoadStats.h"
+#include "../include/MeshSimplifier.h"
+#include "../include/MeshletBuilder.h"
 #include "../include/glad/glad.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Largest vertex span a 16-bit index can address relative to its range's base vertex
+static const unsigned int MAX_SHORT_INDEX_SPAN = 0xFFFF;
+
+// First of the four attribute locations holding the per-instance model matrix, one column each
+static const GLuint INSTANCE_MODEL_LOCATION = 3;
+
+// Vertex tangent, placed after the instance matrix columns
+static const GLuint TANGENT_LOCATION = 7;
+
+// Coarser levels stop once they would fall under this many indices
+static const size_t MIN_LOD_INDEX_COUNT = 64 * 3;
+
+// Below this many triangles per range, the extra draw calls cost more than 16-bit indices save
+static const size_t MIN_TRIANGLES_PER_SHORT_RANGE = 1024;
+
+// Greedily cut the triangle list into runs whose indices span at most 64K vertices, so each run
+// can be stored as 16-bit offsets from its own base vertex. Returns nothing if a single triangle
+// is already too wide.
+static std::vector<DrawRange> buildShortRanges(const std::vector<unsigned int> &indices) {
+    std::vector<DrawRange> ranges;
+    DrawRange              current;
+    unsigned int           minIndex = UINT_MAX;
+    unsigned int           maxIndex = 0;
+
+    for (size_t i = 0; i + 3 <= indices.size(); i += 3) {
+        unsigned int triMin = std::min(indices[i], std::min(indices[i + 1], indices[i + 2]));
+        unsigned int triMax = std::max(indices[i], std::max(indices[i + 1], indices[i + 2]));
+        unsigned int newMin = std::min(minIndex, triMin);
+        unsigned int newMax = std::max(maxIndex, triMax);
+
+        if (current.count > 0 && newMax - newMin > MAX_SHORT_INDEX_SPAN) {
+            current.baseVertex = static_cast<int>(minIndex);
+            ranges.push_back(current);
+            current = DrawRange();
+            current.first = static_cast<unsigned int>(i);
+            newMin = triMin;
+            newMax = triMax;
+        }
+        if (newMax - newMin > MAX_SHORT_INDEX_SPAN) {
+            return std::vector<DrawRange>();
+        }
+        minIndex = newMin;
+        maxIndex = newMax;
+        current.count += 3;
+    }
+    if (current.count > 0) {
+        current.baseVertex = static_cast<int>(minIndex);
+        ranges.push_back(current);
+    }
+    return ranges;
+}
 
 Mesh::Mesh(const std::shared_ptr<std::vector<Vertex>> &vertices,
            const std::vector<unsigned int>            &indices)
     : _vertices(vertices),
-      _indices(indices),
+      _lods(1),
       _VAO(0),
       _VBO(0),
       _EBO(0),
-      _modelMatrix(glm::mat4(1.0f)) {
-    _setupMesh();
+      _indirectBuffer(0),
+      _indexType(GL_UNSIGNED_INT),
+      _uploadedBytes(0),
+      _uploaded(false) {
+    _lods[0].indices = indices;
+    _computeBounds();
+    _buildIndexData();
 }
 
 Mesh::~Mesh() {
@@ -20,17 +87,34 @@ Mesh::~Mesh() {
         glDeleteBuffers(1, &_VBO);
     if (_EBO != 0)
         glDeleteBuffers(1, &_EBO);
+    if (_indirectBuffer != 0)
+        glDeleteBuffers(1, &_indirectBuffer);
 }
 
 Mesh::Mesh(Mesh &&other) noexcept
     : _vertices(std::move(other._vertices)),
-      _indices(std::move(other._indices)),
+      _lods(std::move(other._lods)),
+      _material(std::move(other._material)),
+      _materialName(std::move(other._materialName)),
       _VAO(other._VAO),
       _VBO(other._VBO),
-      _EBO(other._EBO) {
+      _EBO(other._EBO),
+      _indirectBuffer(other._indirectBuffer),
+      _indexType(other._indexType),
+      _bounds(other._bounds),
+      _boundingSphere(other._boundingSphere),
+      _meshlets(std::move(other._meshlets)),
+      _meshletCullData(std::move(other._meshletCullData)),
+      _meshletRanges(std::move(other._meshletRanges)),
+      _meshletRangeOffsets(std::move(other._meshletRangeOffsets)),
+      _triangleBvh(std::move(other._triangleBvh)),
+      _indexData(std::move(other._indexData)),
+      _uploadedBytes(other._uploadedBytes),
+      _uploaded(other._uploaded) {
     other._VAO = 0;
     other._VBO = 0;
     other._EBO = 0;
+    other._indirectBuffer = 0;
 }
 
 Mesh &Mesh::operator=(Mesh &&other) noexcept {
@@ -42,39 +126,113 @@ Mesh &Mesh::operator=(Mesh &&other) noexcept {
             glDeleteBuffers(1, &_VBO);
         if (_EBO != 0)
             glDeleteBuffers(1, &_EBO);
+        if (_indirectBuffer != 0)
+            glDeleteBuffers(1, &_indirectBuffer);
 
         // Transfer ownership
         _vertices = std::move(other._vertices);
-        _indices = std::move(other._indices);
+        _lods = std::move(other._lods);
+        _material = std::move(other._material);
+        _materialName = std::move(other._materialName);
         _VAO = other._VAO;
         _VBO = other._VBO;
         _EBO = other._EBO;
+        _indirectBuffer = other._indirectBuffer;
+        _indexType = other._indexType;
+        _bounds = other._bounds;
+        _boundingSphere = other._boundingSphere;
+        _meshlets = std::move(other._meshlets);
+        _meshletCullData = std::move(other._meshletCullData);
+        _meshletRanges = std::move(other._meshletRanges);
+        _meshletRangeOffsets = std::move(other._meshletRangeOffsets);
+        _triangleBvh = std::move(other._triangleBvh);
+        _indexData = std::move(other._indexData);
+        _uploadedBytes = other._uploadedBytes;
+        _uploaded = other._uploaded;
 
         other._VAO = 0;
         other._VBO = 0;
         other._EBO = 0;
+        other._indirectBuffer = 0;
     }
     return *this;
 }
 
-void Mesh::_setupMesh() {
+// Sends bytes [offset, offset + size) of data to the buffer bound to target, allocating its
+// storage on the first slice
+static void uploadSlice(GLenum target, const unsigned char *data, size_t totalSize, size_t offset,
+                        size_t size) {
+    LoadStageScope upload("gpu upload", size);
+    if (offset == 0 && size == totalSize) {
+        glBufferData(target, static_cast<GLsizeiptr>(size), data, GL_STATIC_DRAW);
+        return;
+    }
+    if (offset == 0) {
+        glBufferData(target, static_cast<GLsizeiptr>(totalSize), nullptr, GL_STATIC_DRAW);
+    }
+    glBufferSubData(target, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size),
+                    data + offset);
+}
+
+bool Mesh::upload(size_t &budget) {
+    if (_uploaded) {
+        return true;
+    }
+    if (_VAO == 0) {
+        _createBuffers();
+    }
+
+    size_t vertexBytes = _getVertexBytes();
+    glBindVertexArray(_VAO);
+    if (_uploadedBytes < vertexBytes && budget > 0) {
+        size_t size = std::min(budget, vertexBytes - _uploadedBytes);
+        glBindBuffer(GL_ARRAY_BUFFER, _VBO);
+        uploadSlice(GL_ARRAY_BUFFER, reinterpret_cast<const unsigned char *>(_vertices->data()),
+                    vertexBytes, _uploadedBytes, size);
+        _uploadedBytes += size;
+        budget -= size;
+    }
+    if (_uploadedBytes >= vertexBytes && _uploadedBytes < vertexBytes + _indexData.size() &&
+        budget > 0) {
+        size_t offset = _uploadedBytes - vertexBytes;
+        size_t size = std::min(budget, _indexData.size() - offset);
+        uploadSlice(GL_ELEMENT_ARRAY_BUFFER, _indexData.data(), _indexData.size(), offset, size);
+        _uploadedBytes += size;
+        budget -= size;
+    }
+    glBindVertexArray(0);
+    if (_uploadedBytes < vertexBytes + _indexData.size()) {
+        return false;
+    }
+
+    if (!_meshlets.empty() && _indirectBuffer == 0) {
+        glGenBuffers(1, &_indirectBuffer);
+    }
+    std::vector<unsigned char>().swap(_indexData);
+    _uploaded = true;
+    return true;
+}
+
+void Mesh::upload() {
+    size_t budget = SIZE_MAX;
+    upload(budget);
+}
+
+bool Mesh::isUploaded() const { return _uploaded; }
+
+size_t Mesh::_getVertexBytes() const { return _vertices->size() * sizeof(Vertex); }
+
+// Buffers without storage yet; upload() allocates it with the first slice
+void Mesh::_createBuffers() {
     // Generate buffers and arrays
     glGenVertexArrays(1, &_VAO);
     glGenBuffers(1, &_VBO);
     glGenBuffers(1, &_EBO);
 
-    // Bind _VAO
+    // Bind _VAO, which keeps the index buffer binding
     glBindVertexArray(_VAO);
-
-    // Load vertex data
     glBindBuffer(GL_ARRAY_BUFFER, _VBO);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(_vertices->size() * sizeof(Vertex)),
-                 _vertices->data(), GL_STATIC_DRAW);
-    // Load index data
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 static_cast<GLsizeiptr>(_indices.size() * sizeof(unsigned int)), _indices.data(),
-                 GL_STATIC_DRAW);
 
     // Set vertex attribute pointers
     // Position attribute
@@ -92,26 +250,328 @@ void Mesh::_setupMesh() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
                           reinterpret_cast<void *>(offsetof(Vertex, texCoords)));
 
+    // Tangent attribute
+    glEnableVertexAttribArray(TANGENT_LOCATION);
+    glVertexAttribPointer(TANGENT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<void *>(offsetof(Vertex, tangent)));
+
     // Unbind _VAO
     glBindVertexArray(0);
 }
 
-void Mesh::draw() const {
-    // Bind _VAO and draw elements
+// Index data changed: what upload() already sent of it is stale. A mesh that could be drawn is
+// sent again right away so it stays drawable.
+void Mesh::_updateIndices() {
+    _buildIndexData();
+    if (_VAO == 0) {
+        return;
+    }
+    _uploadedBytes = std::min(_uploadedBytes, _getVertexBytes());
+    if (_uploaded) {
+        _uploaded = false;
+        upload();
+    }
+}
+
+// Lays out every LOD back to back for one index buffer: as 16-bit offsets when each level's draw
+// ranges fit in 64K vertices, and as plain 32-bit indices otherwise
+void Mesh::_buildIndexData() {
+    size_t totalIndexCount = 0;
+    bool   useShortIndices = true;
+
+    std::vector<std::vector<DrawRange>> shortRanges(_lods.size());
+    for (size_t lod = 0; lod < _lods.size(); ++lod) {
+        const std::vector<unsigned int> &indices = _lods[lod].indices;
+        size_t                           triangleCount = indices.size() / 3;
+
+        shortRanges[lod] = buildShortRanges(indices);
+        if (shortRanges[lod].empty() ||
+            shortRanges[lod].size() * MIN_TRIANGLES_PER_SHORT_RANGE >
+                std::max(triangleCount, MIN_TRIANGLES_PER_SHORT_RANGE)) {
+            useShortIndices = false;
+        }
+        totalIndexCount += indices.size();
+    }
+
+    if (useShortIndices) {
+        std::vector<uint16_t> shortIndices;
+        shortIndices.reserve(totalIndexCount);
+        for (size_t lod = 0; lod < _lods.size(); ++lod) {
+            unsigned int lodFirst = static_cast<unsigned int>(shortIndices.size());
+            for (auto &range : shortRanges[lod]) {
+                unsigned int base = static_cast<unsigned int>(range.baseVertex);
+                for (unsigned int i = range.first; i < range.first + range.count; ++i) {
+                    shortIndices.push_back(static_cast<uint16_t>(_lods[lod].indices[i] - base));
+                }
+                range.first += lodFirst;
+            }
+            _lods[lod].drawRanges = shortRanges[lod];
+        }
+        _indexData.resize(shortIndices.size() * sizeof(uint16_t));
+        std::memcpy(_indexData.data(), shortIndices.data(), _indexData.size());
+        _indexType = GL_UNSIGNED_SHORT;
+    } else {
+        std::vector<unsigned int> indices;
+        indices.reserve(totalIndexCount);
+        for (auto &lod : _lods) {
+            DrawRange range;
+            range.first = static_cast<unsigned int>(indices.size());
+            range.count = static_cast<unsigned int>(lod.indices.size());
+            lod.drawRanges.assign(1, range);
+            indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+        }
+        _indexData.resize(indices.size() * sizeof(unsigned int));
+        std::memcpy(_indexData.data(), indices.data(), _indexData.size());
+        _indexType = GL_UNSIGNED_INT;
+    }
+
+    // Clip every meshlet against the LOD 0 ranges so it is drawn with the right base vertex
+    _meshletRanges.clear();
+    _meshletRangeOffsets.assign(1, 0);
+    const std::vector<DrawRange> &lodRanges = _lods[0].drawRanges;
+    size_t                        rangeIndex = 0;
+    for (const auto &meshlet : _meshlets) {
+        unsigned int end = meshlet.firstIndex + meshlet.indexCount;
+        while (rangeIndex < lodRanges.size() &&
+               lodRanges[rangeIndex].first + lodRanges[rangeIndex].count <= meshlet.firstIndex) {
+            rangeIndex++;
+        }
+        for (size_t r = rangeIndex; r < lodRanges.size() && lodRanges[r].first < end; ++r) {
+            DrawRange range = lodRanges[r];
+            range.first = std::max(range.first, meshlet.firstIndex);
+            range.count = std::min(lodRanges[r].first + lodRanges[r].count, end) - range.first;
+            _meshletRanges.push_back(range);
+        }
+        _meshletRangeOffsets.push_back(static_cast<unsigned int>(_meshletRanges.size()));
+    }
+}
+
+void Mesh::_computeBounds() {
+    const std::vector<unsigned int> &indices = _lods[0].indices;
+    if (indices.empty()) {
+        return;
+    }
+
+    _bounds = AABB();
+    for (unsigned int index : indices) {
+        _bounds.grow((*_vertices)[index].position);
+    }
+    _boundingSphere.center = _bounds.center();
+    _boundingSphere.radius = 0.0f;
+    for (unsigned int index : indices) {
+        _boundingSphere.radius =
+            std::max(_boundingSphere.radius,
+                     glm::length((*_vertices)[index].position - _boundingSphere.center));
+    }
+}
+
+void Mesh::buildLods(size_t maxLevels) {
+    _lods.resize(1);
+
+    MeshSimplifier simplifier(*_vertices, _lods[0].indices);
+    while (_lods.size() < maxLevels) {
+        size_t target = _lods.back().indices.size() / 2;
+        target -= target % 3;
+        if (target < MIN_LOD_INDEX_COUNT) {
+            break;
+        }
+
+        LodLevel level;
+        level.indices = simplifier.simplify(target, FLT_MAX);
+        level.error = simplifier.getError();
+
+        // Stop once locked borders and seams keep the simplifier from making real progress
+        if (level.indices.size() * 10 > _lods.back().indices.size() * 9) {
+            break;
+        }
+        _lods.push_back(level);
+    }
+    _updateIndices();
+}
+
+void Mesh::buildMeshlets() {
+    _meshlets = MeshletBuilder::build(*_vertices, _lods[0].indices);
+    _triangleBvh.reset(); // triangle order changed
+
+    MeshletCullData &data = _meshletCullData;
+    data = MeshletCullData();
+    for (const auto &meshlet : _meshlets) {
+        data.centerX.push_back(meshlet.bounds.center.x);
+        data.centerY.push_back(meshlet.bounds.center.y);
+        data.centerZ.push_back(meshlet.bounds.center.z);
+        data.radius.push_back(meshlet.bounds.radius);
+        data.apexX.push_back(meshlet.coneApex.x);
+        data.apexY.push_back(meshlet.coneApex.y);
+        data.apexZ.push_back(meshlet.coneApex.z);
+        data.axisX.push_back(meshlet.coneAxis.x);
+        data.axisY.push_back(meshlet.coneAxis.y);
+        data.axisZ.push_back(meshlet.coneAxis.z);
+        data.cutoff.push_back(meshlet.coneCutoff);
+    }
+    _updateIndices();
+}
+
+void Mesh::setInstanceBuffer(GLuint instanceBuffer) {
+    glBindVertexArray(_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (GLuint column = 0; column < 4; ++column) {
+        glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+        glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE,
+                              sizeof(glm::mat4),
+                              reinterpret_cast<void *>(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+    }
+    glBindVertexArray(0);
+}
+
+void Mesh::drawMeshlets(const glm::mat4 &modelMatrix, const glm::mat4 &viewProjection,
+                        const glm::vec3 &cameraPosition, unsigned int baseInstance,
+                        RenderStats &stats) const {
+    // Cull in object space: the frustum planes of the full MVP matrix and the camera pulled back
+    // through the model matrix. Mirroring transforms flip facing, so cones are skipped for them.
+    Frustum   frustum = extractFrustum(viewProjection * modelMatrix);
+    glm::vec3 camera = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(cameraPosition, 1.0f));
+    bool      useCones = glm::determinant(glm::mat3(modelMatrix)) > 0.0f;
+
+    float planeLengths[6];
+    for (size_t p = 0; p < 6; ++p) {
+        planeLengths[p] = glm::length(glm::vec3(frustum.planes[p]));
+    }
+
+    // Spheres first, then cones, each a branch-free pass over a few of the arrays so that the
+    // compiler can vectorize it: one pass over all eleven would need more run-time aliasing
+    // checks against the byte stores than GCC allows
+    const MeshletCullData &data = _meshletCullData;
+    size_t                 count = _meshlets.size();
+    _meshletVisibility.resize(count);
+    unsigned char *visibility = _meshletVisibility.data();
+    const float   *centerX = data.centerX.data(), *centerY = data.centerY.data();
+    const float   *centerZ = data.centerZ.data(), *radius = data.radius.data();
+    for (size_t i = 0; i < count; ++i) {
+        bool visible = true;
+        for (size_t p = 0; p < 6; ++p) {
+            const glm::vec4 &plane = frustum.planes[p];
+            float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] +
+                             plane.w;
+            visible = visible & (distance >= -radius[i] * planeLengths[p]);
+        }
+        visibility[i] = static_cast<unsigned char>(visible);
+    }
+
+    if (useCones) {
+        const float *apexX = data.apexX.data(), *apexY = data.apexY.data();
+        const float *apexZ = data.apexZ.data(), *cutoff = data.cutoff.data();
+        const float *axisX = data.axisX.data(), *axisY = data.axisY.data();
+        const float *axisZ = data.axisZ.data();
+        for (size_t i = 0; i < count; ++i) {
+            float dx = apexX[i] - camera.x;
+            float dy = apexY[i] - camera.y;
+            float dz = apexZ[i] - camera.z;
+            float facing = dx * axisX[i] + dy * axisY[i] + dz * axisZ[i];
+            // facing < cutoff * |d| without the square root, as the cutoff is never negative
+            float cutoffSquared = cutoff[i] * cutoff[i] * (dx * dx + dy * dy + dz * dz);
+            bool  frontFacing = (facing < 0.0f) | (facing * facing < cutoffSquared);
+            visibility[i] = static_cast<unsigned char>(visibility[i] & frontFacing);
+        }
+    }
+
+    // Gather the surviving ranges, merging neighbours that share a base vertex
+    _indirectCommands.clear();
+    unsigned int lastEnd = UINT_MAX;
+    for (size_t i = 0; i < count; ++i) {
+        if (!_meshletVisibility[i]) {
+            stats.meshletsCulled++;
+            continue;
+        }
+        stats.meshletsDrawn++;
+        stats.trianglesDrawn += _meshlets[i].indexCount / 3;
+        for (unsigned int r = _meshletRangeOffsets[i]; r < _meshletRangeOffsets[i + 1]; ++r) {
+            const DrawRange &range = _meshletRanges[r];
+            if (range.first == lastEnd && range.baseVertex == _indirectCommands.back().baseVertex) {
+                _indirectCommands.back().count += range.count;
+            } else {
+                DrawElementsIndirectCommand command;
+                command.count = range.count;
+                command.instanceCount = 1;
+                command.firstIndex = range.first;
+                command.baseVertex = range.baseVertex;
+                command.baseInstance = baseInstance;
+                _indirectCommands.push_back(command);
+            }
+            lastEnd = range.first + range.count;
+        }
+    }
+    if (_indirectCommands.empty()) {
+        return;
+    }
+
+    // Indirect commands rather than glMultiDrawElementsBaseVertex, which has no base instance
+    glBindVertexArray(_VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 static_cast<GLsizeiptr>(_indirectCommands.size() *
+                                         sizeof(DrawElementsIndirectCommand)),
+                 _indirectCommands.data(), GL_STREAM_DRAW);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, _indexType, nullptr,
+                                static_cast<GLsizei>(_indirectCommands.size()), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+    stats.drawCalls++;
+}
+
+void Mesh::draw(size_t lod, unsigned int instanceCount, unsigned int baseInstance) const {
+    size_t indexSize = _indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+
+    // Bind _VAO and draw each index range of the level from its own base vertex
     glBindVertexArray(_VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(_indices.size()), GL_UNSIGNED_INT,
-                   reinterpret_cast<void *>(static_cast<uintptr_t>(0)));
+    for (const auto &range : _lods.at(lod).drawRanges) {
+        glDrawElementsInstancedBaseVertexBaseInstance(
+            GL_TRIANGLES, static_cast<GLsizei>(range.count), _indexType,
+            reinterpret_cast<void *>(static_cast<uintptr_t>(range.first * indexSize)),
+            static_cast<GLsizei>(instanceCount), range.baseVertex, baseInstance);
+    }
     glBindVertexArray(0);
 }
 
-void Mesh::setModelMatrix(const glm::mat4 &modelMatrix) { _modelMatrix = modelMatrix; }
+void Mesh::buildTriangleBvh() {
+    _triangleBvh.reset(new TriangleBvh(*_vertices, _lods[0].indices));
+}
 
-const glm::mat4 &Mesh::getModelMatrix() const { return _modelMatrix; }
+bool Mesh::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+                   TriangleBvh::Hit &hit) const {
+    if (!_triangleBvh) {
+        _triangleBvh.reset(new TriangleBvh(*_vertices, _lods[0].indices));
+    }
+    return _triangleBvh->intersect(origin, direction, maxDistance, hit);
+}
 
-void Mesh::setMaterial(const Material &material) { _material = material; }
+void Mesh::setMaterial(const Material &material, const std::string &name) {
+    _material = material;
+    _materialName = name;
+}
 
 const std::vector<Vertex> &Mesh::getVertices() const { return *_vertices; }
 
-const std::vector<unsigned int> &Mesh::getIndices() const { return _indices; }
+const std::vector<unsigned int> &Mesh::getIndices() const { return _lods[0].indices; }
 
 const Material &Mesh::getMaterial() const { return _material; }
+
+const std::string &Mesh::getMaterialName() const { return _materialName; }
+
+GLenum Mesh::getIndexType() const { return _indexType; }
+
+const std::vector<DrawRange> &Mesh::getDrawRanges(size_t lod) const {
+    return _lods.at(lod).drawRanges;
+}
+
+size_t Mesh::getLodCount() const { return _lods.size(); }
+
+float Mesh::getLodError(size_t lod) const { return _lods.at(lod).error; }
+
+size_t Mesh::getTriangleCount(size_t lod) const { return _lods.at(lod).indices.size() / 3; }
+
+const BoundingSphere &Mesh::getBoundingSphere() const { return _boundingSphere; }
+
+const AABB &Mesh::getBounds() const { return _bounds; }
+
+const std::vector<Meshlet> &Mesh::getMeshlets() const { return _meshlets; }
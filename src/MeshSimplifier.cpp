@@ -0,0 +1,294 @@
+#include "../include/MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+struct PositionKey {
+    uint32_t bits[3];
+
+    bool operator==(const PositionKey &other) const {
+        return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+    }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey &key) const {
+        return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+    }
+};
+
+uint64_t edgeKey(unsigned int a, unsigned int b) {
+    if (a > b) {
+        std::swap(a, b);
+    }
+    return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+} // namespace
+
+MeshSimplifier::MeshSimplifier(const std::vector<Vertex>       &vertices,
+                               const std::vector<unsigned int> &indices)
+    : _vertices(vertices),
+      _indices(indices),
+      _error(0.0) {
+    _classifyVertices();
+    _computeQuadrics();
+}
+
+float MeshSimplifier::getError() const { return static_cast<float>(_error); }
+
+std::vector<unsigned int> MeshSimplifier::simplify(size_t targetIndexCount, float maxError) {
+    double maxCost = static_cast<double>(maxError) * static_cast<double>(maxError);
+    while (_indices.size() > targetIndexCount) {
+        if (!_collapsePass(targetIndexCount / 3, maxCost)) {
+            break;
+        }
+    }
+    return _indices;
+}
+
+// Vertices sharing a position get the same position id; a position used by several vertices is a
+// seam. Positions on an edge that is not shared by exactly two triangles lie on a border. Both
+// are locked in place.
+void MeshSimplifier::_classifyVertices() {
+    std::unordered_map<PositionKey, unsigned int, PositionKeyHash> firstVertex;
+    std::vector<unsigned int>                                      positionUses(_vertices.size(), 0);
+
+    _positionIds.resize(_vertices.size());
+    _locked.assign(_vertices.size(), false);
+    for (size_t i = 0; i < _vertices.size(); ++i) {
+        PositionKey key;
+        std::memcpy(key.bits, &_vertices[i].position, sizeof(key.bits));
+        auto inserted = firstVertex.insert(std::make_pair(key, static_cast<unsigned int>(i)));
+        _positionIds[i] = inserted.first->second;
+        positionUses[_positionIds[i]]++;
+    }
+    for (size_t i = 0; i < _vertices.size(); ++i) {
+        if (positionUses[_positionIds[i]] > 1) {
+            _locked[i] = true;
+        }
+    }
+
+    std::unordered_map<uint64_t, unsigned int> edgeUses;
+    for (size_t i = 0; i + 3 <= _indices.size(); i += 3) {
+        for (size_t e = 0; e < 3; ++e) {
+            unsigned int a = _positionIds[_indices[i + e]];
+            unsigned int b = _positionIds[_indices[i + (e + 1) % 3]];
+            edgeUses[edgeKey(a, b)]++;
+        }
+    }
+    std::vector<bool> lockedPositions(_vertices.size(), false);
+    for (const auto &edge : edgeUses) {
+        if (edge.second != 2) {
+            lockedPositions[static_cast<size_t>(edge.first >> 32)] = true;
+            lockedPositions[static_cast<size_t>(edge.first & 0xFFFFFFFFu)] = true;
+        }
+    }
+    for (size_t i = 0; i < _vertices.size(); ++i) {
+        if (lockedPositions[_positionIds[i]]) {
+            _locked[i] = true;
+        }
+    }
+}
+
+// Accumulates the area-weighted plane quadric of every triangle on its three corner positions
+void MeshSimplifier::_computeQuadrics() {
+    Quadric zero;
+    std::memset(&zero, 0, sizeof(zero));
+    _quadrics.assign(_vertices.size(), zero);
+
+    for (size_t i = 0; i + 3 <= _indices.size(); i += 3) {
+        const glm::vec3 &p0 = _vertices[_indices[i]].position;
+        const glm::vec3 &p1 = _vertices[_indices[i + 1]].position;
+        const glm::vec3 &p2 = _vertices[_indices[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float     length = glm::length(normal);
+        if (length <= FLT_MIN) {
+            continue;
+        }
+        normal /= length;
+
+        double nx = static_cast<double>(normal.x);
+        double ny = static_cast<double>(normal.y);
+        double nz = static_cast<double>(normal.z);
+        double d = -static_cast<double>(glm::dot(normal, p0));
+        double w = static_cast<double>(length) * 0.5;
+
+        for (size_t c = 0; c < 3; ++c) {
+            Quadric &q = _quadrics[_positionIds[_indices[i + c]]];
+            q.a00 += w * nx * nx;
+            q.a01 += w * nx * ny;
+            q.a02 += w * nx * nz;
+            q.a11 += w * ny * ny;
+            q.a12 += w * ny * nz;
+            q.a22 += w * nz * nz;
+            q.b0 += w * nx * d;
+            q.b1 += w * ny * d;
+            q.b2 += w * nz * d;
+            q.c += w * d * d;
+            q.w += w;
+        }
+    }
+}
+
+// Mean squared distance from the target position to the planes merged into both endpoints
+double MeshSimplifier::_collapseCost(unsigned int from, unsigned int to) const {
+    const Quadric &qa = _quadrics[_positionIds[from]];
+    const Quadric &qb = _quadrics[_positionIds[to]];
+    double         x = static_cast<double>(_vertices[to].position.x);
+    double         y = static_cast<double>(_vertices[to].position.y);
+    double         z = static_cast<double>(_vertices[to].position.z);
+
+    double a00 = qa.a00 + qb.a00, a01 = qa.a01 + qb.a01, a02 = qa.a02 + qb.a02;
+    double a11 = qa.a11 + qb.a11, a12 = qa.a12 + qb.a12, a22 = qa.a22 + qb.a22;
+    double b0 = qa.b0 + qb.b0, b1 = qa.b1 + qb.b1, b2 = qa.b2 + qb.b2;
+    double w = qa.w + qb.w;
+
+    double error = x * (a00 * x + a01 * y + a02 * z) + y * (a01 * x + a11 * y + a12 * z) +
+                   z * (a02 * x + a12 * y + a22 * z) + 2.0 * (b0 * x + b1 * y + b2 * z) + qa.c +
+                   qb.c;
+    if (w <= 0.0) {
+        return 0.0;
+    }
+    return std::max(error / w, 0.0);
+}
+
+// Rejects a collapse that would turn any surviving triangle around `from` upside down
+bool MeshSimplifier::_flipsTriangles(unsigned int from, unsigned int to,
+                                     const std::vector<unsigned int> &adjacencyOffsets,
+                                     const std::vector<unsigned int> &adjacency,
+                                     const std::vector<unsigned int> &remap) const {
+    const glm::vec3 &target = _vertices[to].position;
+
+    for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a) {
+        size_t       triangle = adjacency[a] * size_t(3);
+        unsigned int corners[3] = {remap[_indices[triangle]], remap[_indices[triangle + 1]],
+                                   remap[_indices[triangle + 2]]};
+        if (corners[0] == to || corners[1] == to || corners[2] == to) {
+            continue;
+        }
+
+        glm::vec3 before[3], after[3];
+        for (size_t c = 0; c < 3; ++c) {
+            before[c] = _vertices[corners[c]].position;
+            after[c] = corners[c] == from ? target : before[c];
+        }
+        glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(n0, n1) <= 1e-2f * glm::length(n0) * glm::length(n1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs one round of independent collapses, cheapest first. Both endpoints of a collapse are
+// frozen for the rest of the round so every decision is made against up to date geometry.
+bool MeshSimplifier::_collapsePass(size_t targetTriangleCount, double maxError) {
+    size_t triangleCount = _indices.size() / 3;
+    if (triangleCount <= targetTriangleCount) {
+        return false;
+    }
+
+    // Vertex -> triangle adjacency, built with a counting sort
+    std::vector<unsigned int> adjacencyOffsets(_vertices.size() + 1, 0);
+    std::vector<unsigned int> adjacency(_indices.size());
+    for (unsigned int index : _indices) {
+        adjacencyOffsets[index + 1]++;
+    }
+    for (size_t i = 1; i < adjacencyOffsets.size(); ++i) {
+        adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+    }
+    std::vector<unsigned int> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < _indices.size(); ++i) {
+        adjacency[cursor[_indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<Collapse> collapses;
+    collapses.reserve(_indices.size());
+    for (size_t i = 0; i + 3 <= _indices.size(); i += 3) {
+        for (size_t e = 0; e < 3; ++e) {
+            unsigned int a = _indices[i + e];
+            unsigned int b = _indices[i + (e + 1) % 3];
+            Collapse     best = {a, b, DBL_MAX};
+            if (!_locked[a]) {
+                best.cost = _collapseCost(a, b);
+            }
+            if (!_locked[b]) {
+                double cost = _collapseCost(b, a);
+                if (cost < best.cost) {
+                    best.from = b;
+                    best.to = a;
+                    best.cost = cost;
+                }
+            }
+            if (best.cost < DBL_MAX) {
+                collapses.push_back(best);
+            }
+        }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &l, const Collapse &r) { return l.cost < r.cost; });
+
+    std::vector<unsigned int> remap(_vertices.size());
+    for (size_t i = 0; i < remap.size(); ++i) {
+        remap[i] = static_cast<unsigned int>(i);
+    }
+    std::vector<bool> frozen(_vertices.size(), false);
+    size_t            collapseGoal = (triangleCount - targetTriangleCount) / 2 + 1;
+    size_t            collapsed = 0;
+
+    for (const auto &collapse : collapses) {
+        if (collapsed >= collapseGoal || collapse.cost > maxError) {
+            break;
+        }
+        if (frozen[collapse.from] || frozen[collapse.to] ||
+            _flipsTriangles(collapse.from, collapse.to, adjacencyOffsets, adjacency, remap)) {
+            continue;
+        }
+
+        Quadric       &target = _quadrics[_positionIds[collapse.to]];
+        const Quadric &source = _quadrics[_positionIds[collapse.from]];
+        target.a00 += source.a00;
+        target.a01 += source.a01;
+        target.a02 += source.a02;
+        target.a11 += source.a11;
+        target.a12 += source.a12;
+        target.a22 += source.a22;
+        target.b0 += source.b0;
+        target.b1 += source.b1;
+        target.b2 += source.b2;
+        target.c += source.c;
+        target.w += source.w;
+
+        remap[collapse.from] = collapse.to;
+        frozen[collapse.from] = true;
+        frozen[collapse.to] = true;
+        _error = std::max(_error, std::sqrt(collapse.cost));
+        collapsed++;
+    }
+    if (collapsed == 0) {
+        return false;
+    }
+
+    // Apply the collapses and drop the triangles that became degenerate
+    size_t write = 0;
+    for (size_t i = 0; i + 3 <= _indices.size(); i += 3) {
+        unsigned int a = remap[_indices[i]];
+        unsigned int b = remap[_indices[i + 1]];
+        unsigned int c = remap[_indices[i + 2]];
+        if (a == b || b == c || a == c) {
+            continue;
+        }
+        _indices[write++] = a;
+        _indices[write++] = b;
+        _indices[write++] = c;
+    }
+    _indices.resize(write);
+    return true;
+}
@@ -0,0 +1,192 @@
+#include "../include/MeshletBuilder.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+const size_t MeshletBuilder::MAX_VERTICES;
+const size_t MeshletBuilder::MAX_TRIANGLES;
+
+std::vector<Meshlet> MeshletBuilder::build(const std::vector<Vertex>  &vertices,
+                                           std::vector<unsigned int> &indices) {
+    size_t triangleCount = indices.size() / 3;
+
+    // Vertex -> triangle adjacency, built with a counting sort
+    std::vector<unsigned int> adjacencyOffsets(vertices.size() + 1, 0);
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        adjacencyOffsets[indices[i] + 1]++;
+    }
+    for (size_t i = 1; i < adjacencyOffsets.size(); ++i) {
+        adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+    }
+    std::vector<unsigned int> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        adjacency[cursor[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<bool>         emitted(triangleCount, false);
+    std::vector<bool>         inMeshlet(vertices.size(), false);
+    std::vector<unsigned int> meshletVertices;
+    std::vector<unsigned int> reordered;
+    std::vector<Meshlet>      meshlets;
+    Meshlet                   current;
+    size_t                    seed = 0;
+    size_t                    lastTriangle = SIZE_MAX;
+
+    reordered.reserve(triangleCount * 3);
+
+    // Number of vertices the triangle would add to the meshlet being built
+    auto newVertexCount = [&](size_t triangle) {
+        unsigned int count = 0;
+        for (size_t c = 0; c < 3; ++c) {
+            unsigned int vertex = indices[triangle * 3 + c];
+            bool         repeated = c > 0 && indices[triangle * 3] == vertex;
+            repeated = repeated || (c > 1 && indices[triangle * 3 + 1] == vertex);
+            if (!inMeshlet[vertex] && !repeated) {
+                count++;
+            }
+        }
+        return count;
+    };
+
+    // Best unemitted neighbour of `vertex`, preferring triangles that add the fewest vertices
+    auto scanNeighbours = [&](unsigned int vertex, size_t &best, unsigned int &bestNew) {
+        for (unsigned int a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a) {
+            size_t triangle = adjacency[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+            unsigned int count = newVertexCount(triangle);
+            if (count < bestNew) {
+                best = triangle;
+                bestNew = count;
+            }
+        }
+    };
+
+    auto flush = [&]() {
+        if (current.indexCount == 0) {
+            return;
+        }
+        _computeBounds(vertices, reordered, current);
+        meshlets.push_back(current);
+        for (unsigned int vertex : meshletVertices) {
+            inMeshlet[vertex] = false;
+        }
+        meshletVertices.clear();
+        current = Meshlet();
+        current.firstIndex = static_cast<unsigned int>(reordered.size());
+    };
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+        size_t       best = SIZE_MAX;
+        unsigned int bestNew = 4;
+
+        // Grow around the last triangle first, then around the whole cluster
+        if (lastTriangle != SIZE_MAX) {
+            for (size_t c = 0; c < 3 && bestNew > 0; ++c) {
+                scanNeighbours(indices[lastTriangle * 3 + c], best, bestNew);
+            }
+        }
+        if (best == SIZE_MAX) {
+            for (size_t v = 0; v < meshletVertices.size() && bestNew > 0; ++v) {
+                scanNeighbours(meshletVertices[v], best, bestNew);
+            }
+        }
+        if (best == SIZE_MAX) {
+            while (emitted[seed]) {
+                seed++;
+            }
+            best = seed;
+            bestNew = newVertexCount(best);
+        }
+
+        if (meshletVertices.size() + bestNew > MAX_VERTICES ||
+            current.indexCount / 3 >= MAX_TRIANGLES) {
+            flush();
+        }
+
+        emitted[best] = true;
+        for (size_t c = 0; c < 3; ++c) {
+            unsigned int vertex = indices[best * 3 + c];
+            if (!inMeshlet[vertex]) {
+                inMeshlet[vertex] = true;
+                meshletVertices.push_back(vertex);
+            }
+            reordered.push_back(vertex);
+        }
+        current.indexCount += 3;
+        lastTriangle = best;
+    }
+    flush();
+
+    indices.swap(reordered);
+    return meshlets;
+}
+
+// Bounding sphere plus a normal cone with its apex pushed back far enough that every triangle's
+// plane lies in front of it, so a camera inside the cone sees only backfaces
+void MeshletBuilder::_computeBounds(const std::vector<Vertex>       &vertices,
+                                    const std::vector<unsigned int> &indices, Meshlet &meshlet) {
+    unsigned int end = meshlet.firstIndex + meshlet.indexCount;
+
+    glm::vec3 minBounds(FLT_MAX);
+    glm::vec3 maxBounds(-FLT_MAX);
+    for (unsigned int i = meshlet.firstIndex; i < end; ++i) {
+        minBounds = glm::min(minBounds, vertices[indices[i]].position);
+        maxBounds = glm::max(maxBounds, vertices[indices[i]].position);
+    }
+    meshlet.bounds.center = (minBounds + maxBounds) * 0.5f;
+    meshlet.bounds.radius = 0.0f;
+    for (unsigned int i = meshlet.firstIndex; i < end; ++i) {
+        meshlet.bounds.radius =
+            std::max(meshlet.bounds.radius,
+                     glm::length(vertices[indices[i]].position - meshlet.bounds.center));
+    }
+
+    std::vector<glm::vec3> normals;
+    glm::vec3              axis(0.0f);
+    for (unsigned int i = meshlet.firstIndex; i < end; i += 3) {
+        const glm::vec3 &p0 = vertices[indices[i]].position;
+        glm::vec3        normal = glm::cross(vertices[indices[i + 1]].position - p0,
+                                             vertices[indices[i + 2]].position - p0);
+        float            length = glm::length(normal);
+        if (length > FLT_MIN) {
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+    }
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength <= FLT_MIN) {
+        return;
+    }
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const auto &normal : normals) {
+        minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+    // Wider than about 84 degrees: the cone would almost never cull anything
+    if (minDot <= 0.1f) {
+        return;
+    }
+
+    float maxT = 0.0f;
+    for (unsigned int i = meshlet.firstIndex; i < end; i += 3) {
+        const glm::vec3 &p0 = vertices[indices[i]].position;
+        glm::vec3        normal = glm::cross(vertices[indices[i + 1]].position - p0,
+                                             vertices[indices[i + 2]].position - p0);
+        float            length = glm::length(normal);
+        if (length <= FLT_MIN) {
+            continue;
+        }
+        normal /= length;
+        float t = glm::dot(meshlet.bounds.center - p0, normal) / glm::dot(axis, normal);
+        maxT = std::max(maxT, t);
+    }
+
+    meshlet.coneApex = meshlet.bounds.center - axis * maxT;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
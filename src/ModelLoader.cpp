@@ -0,0 +1,298 @@
+#include "../include/ModelLoader.h"
+#include "../include/Logger.h"
+#include "../include/Mesh.h"
+#include "../include/ObjLoader.h"
+#include "../include/TextureCache.h"
+#include <algorithm>
+#include <sstream>
+
+ModelLoad::ModelLoad(const std::string &path, const std::vector<glm::mat4> &placements)
+    : _path(path),
+      _placements(placements),
+      _state(LOADING),
+      _objectCount(0),
+      _objectsAdded(0),
+      _reloading(false),
+      _reloadPending(false) {}
+
+const std::string &ModelLoad::getPath() const { return _path; }
+
+ModelLoad::State ModelLoad::getState() const { return static_cast<State>(_state.load()); }
+
+bool ModelLoad::isFinished() const { return getState() != LOADING; }
+
+std::string ModelLoad::getError() const {
+    std::lock_guard<std::mutex> lock(_errorMutex);
+    return _error;
+}
+
+size_t ModelLoad::getObjectCount() const { return _objectCount; }
+
+size_t ModelLoad::getObjectsAdded() const { return _objectsAdded; }
+
+const std::vector<unsigned int> &ModelLoad::getRootNodes() const { return _rootNodes; }
+
+const std::vector<std::string> &ModelLoad::getFiles() const { return _files; }
+
+void ModelLoad::_fail(const std::string &error) {
+    std::lock_guard<std::mutex> lock(_errorMutex);
+    _error = error;
+    _state = FAILED;
+}
+
+ModelPart::ModelPart(Type partType, const ModelHandle &model, const std::string &partName)
+    : type(partType),
+      load(model),
+      name(partName) {}
+
+// Verbose log of the material, sizes and first vertices and triangles of a mesh; formats
+// nothing unless verbose messages are enabled
+static void logMeshInfo(int meshIndex, const std::shared_ptr<Mesh> &meshPtr,
+                        const TextureCache &textures) {
+    if (!Logger::isEnabled(LOG_VERBOSE)) {
+        return;
+    }
+    std::ostringstream out;
+    out << "Mesh #" << meshIndex << "\n";
+
+    const auto &vertices = meshPtr->getVertices();
+    const auto &indices = meshPtr->getIndices();
+    const auto &material = meshPtr->getMaterial();
+
+    if (meshPtr->getMaterialName().empty()) {
+        out << "  Material: (No material assigned)\n";
+    } else {
+        out << "  Material Name: " << meshPtr->getMaterialName() << "\n";
+        out << "    Ambient: (" << material.ambient.r << ", " << material.ambient.g << ", "
+            << material.ambient.b << ")\n";
+        out << "    Diffuse: (" << material.diffuse.r << ", " << material.diffuse.g << ", "
+            << material.diffuse.b << ")\n";
+        out << "    Specular: (" << material.specular.r << ", " << material.specular.g << ", "
+            << material.specular.b << ")\n";
+        out << "    Shininess: " << material.shininess << "\n";
+        out << "    Opacity: " << material.opacity << ", Illum: " << material.illum << "\n";
+        if (material.hasMap(MAP_DIFFUSE)) {
+            out << "    Diffuse Map Path: " << textures.getPath(material.maps[MAP_DIFFUSE])
+                << "\n";
+        }
+    }
+
+    out << "  Number of Vertices: " << vertices.size() << "\n";
+    out << "  Number of Indices: " << indices.size() << " ("
+        << (meshPtr->getIndexType() == GL_UNSIGNED_SHORT ? "16" : "32") << "-bit, "
+        << meshPtr->getDrawRanges().size() << " range(s))\n";
+    out << "  Levels of Detail: " << meshPtr->getLodCount() << " (";
+    for (size_t lod = 0; lod < meshPtr->getLodCount(); ++lod) {
+        out << (lod ? ", " : "") << meshPtr->getTriangleCount(lod) << " tris";
+    }
+    out << ")\n";
+
+    size_t maxVerticesToShow = std::min(vertices.size(), static_cast<size_t>(5));
+    for (size_t i = 0; i < maxVerticesToShow; ++i) {
+        const auto &vertex = vertices[i];
+        out << "    Vertex " << i << ": Position(" << vertex.position.x << ", "
+            << vertex.position.y << ", " << vertex.position.z << "), "
+            << "Normal(" << vertex.normal.x << ", " << vertex.normal.y << ", " << vertex.normal.z
+            << "), "
+            << "TexCoords(" << vertex.texCoords.x << ", " << vertex.texCoords.y << ")\n";
+    }
+    if (vertices.size() > maxVerticesToShow) {
+        out << "    ... (" << vertices.size() - maxVerticesToShow << " more vertices)\n";
+    }
+
+    size_t maxTrianglesToShow = std::min(indices.size() / 3, static_cast<size_t>(5));
+    for (size_t i = 0; i < maxTrianglesToShow * 3; i += 3) {
+        out << "    Triangle " << i / 3 << ": Indices(" << indices[i] << ", " << indices[i + 1]
+            << ", " << indices[i + 2] << ")\n";
+    }
+    if (indices.size() / 3 > maxTrianglesToShow) {
+        out << "    ... (" << (indices.size() / 3) - maxTrianglesToShow << " more triangles)\n";
+    }
+    std::string text = out.str();
+    text.erase(text.size() - 1); // Logger adds the last newline
+    Logger::write(LOG_VERBOSE, text);
+}
+
+// Files are read and meshes built with the job system's help, so a few loads at once are enough
+static const size_t MAX_DEFAULT_THREADS = 4;
+
+ModelLoader::ModelLoader()
+    : _threadCount(std::max(1u, std::min(static_cast<unsigned int>(MAX_DEFAULT_THREADS),
+                                         std::thread::hardware_concurrency()))),
+      _idleThreads(0),
+      _stopping(false),
+      _activeLoads(0) {}
+
+ModelLoader::~ModelLoader() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wakeUp.notify_all();
+    for (auto &thread : _threads) {
+        thread.join();
+    }
+}
+
+void ModelLoader::request(const ModelHandle &load) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _requests.push_back(load);
+    _startThread();
+}
+
+void ModelLoader::requestTexture(const std::string &path) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _textureRequests.push_back(path);
+    _startThread();
+}
+
+void ModelLoader::load(const ModelHandle &load) { _load(load); }
+
+std::unique_ptr<ModelPart> ModelLoader::poll() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_parts.empty()) {
+        return nullptr;
+    }
+    std::unique_ptr<ModelPart> part = std::move(_parts.front());
+    _parts.pop_front();
+    return part;
+}
+
+void ModelLoader::waitForPart() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _partReady.wait(lock, [this]() { return !_parts.empty(); });
+}
+
+void ModelLoader::setThreadCount(size_t threadCount) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _threadCount = std::max(threadCount, static_cast<size_t>(1));
+}
+
+size_t ModelLoader::getThreadCount() const { return _threadCount; }
+
+// A thread is started only when none is waiting for work; called with _mutex held
+void ModelLoader::_startThread() {
+    if (_idleThreads == 0 && _threads.size() < _threadCount) {
+        _threads.push_back(std::thread(&ModelLoader::_threadLoop, this));
+    } else {
+        _wakeUp.notify_one();
+    }
+}
+
+void ModelLoader::_threadLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _idleThreads++;
+        _wakeUp.wait(lock, [this]() {
+            return _stopping || !_requests.empty() || !_textureRequests.empty();
+        });
+        _idleThreads--;
+        if (_stopping) {
+            return;
+        }
+        if (!_textureRequests.empty()) {
+            std::string path = _textureRequests.front();
+            _textureRequests.pop_front();
+            lock.unlock();
+            std::unique_ptr<ModelPart> part(new ModelPart(ModelPart::TEXTURE, nullptr, path));
+            try {
+                part->image = Texture::decode(path);
+            } catch (const std::runtime_error &) {
+                // decode() reported it; the scene keeps the texture it has
+            }
+            _push(std::move(part));
+        } else {
+            ModelHandle load = _requests.front();
+            _requests.pop_front();
+            lock.unlock();
+            _load(load);
+        }
+        lock.lock();
+    }
+}
+
+// The model's textures are registered in a TextureCache of its own, as the scene's belongs to
+// the render thread; the scene maps the indices when it takes the textures over. Stopping is only
+// checked between parts, so a large file still gets parsed to the end.
+void ModelLoader::_load(const ModelHandle &load) {
+    {
+        std::lock_guard<std::mutex> lock(_imageMutex);
+        _activeLoads++;
+    }
+    try {
+        TextureCache textures;
+        load->_files.push_back(load->getPath());
+        ObjLoader objLoader(load->getPath(), textures);
+        load->_objectCount = objLoader.getObjects().size();
+        load->_files.insert(load->_files.end(), objLoader.getMaterialFiles().begin(),
+                            objLoader.getMaterialFiles().end());
+
+        for (size_t i = 0; i < textures.getCount() && !_stopping; ++i) {
+            const std::string         &path = textures.getPath(static_cast<int>(i));
+            std::unique_ptr<ModelPart> part(new ModelPart(ModelPart::TEXTURE, load, path));
+            try {
+                if (!load->_loadedTextures.count(path)) {
+                    part->image = _decode(path);
+                }
+            } catch (const std::runtime_error &) {
+                // decode() reported it; the part still comes so that the indices line up
+            }
+            _push(std::move(part));
+        }
+
+        int meshIndex = 0;
+        for (size_t i = 0; i < objLoader.getObjects().size() && !_stopping; ++i) {
+            const std::string         &name = objLoader.getObjects()[i].name;
+            std::unique_ptr<ModelPart> part(new ModelPart(ModelPart::OBJECT, load, name));
+            LogMessage(LOG_VERBOSE) << "Object #" << i << ": "
+                                    << (name.empty() ? "(unnamed)" : name);
+            part->meshes = objLoader.getObjectMeshes(i);
+            for (const auto &mesh : part->meshes) {
+                logMeshInfo(meshIndex++, mesh, textures);
+            }
+            _push(std::move(part));
+        }
+    } catch (const std::exception &e) {
+        load->_fail(e.what());
+    }
+    _push(std::unique_ptr<ModelPart>(new ModelPart(ModelPart::END, load, "")));
+
+    std::lock_guard<std::mutex> lock(_imageMutex);
+    if (--_activeLoads == 0) {
+        _images.clear();
+    }
+}
+
+// The first model to ask for a file decodes it; the others wait for its pixels, or its error
+TextureImage ModelLoader::_decode(const std::string &path) {
+    std::promise<TextureImage>       promise;
+    std::shared_future<TextureImage> image;
+    bool                             decodeHere = false;
+    {
+        std::lock_guard<std::mutex> lock(_imageMutex);
+        auto                        it = _images.find(path);
+        if (it == _images.end()) {
+            image = promise.get_future().share();
+            _images[path] = image;
+            decodeHere = true;
+        } else {
+            image = it->second;
+        }
+    }
+    if (decodeHere) {
+        try {
+            promise.set_value(Texture::decode(path));
+        } catch (const std::runtime_error &) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+    return image.get();
+}
+
+void ModelLoader::_push(std::unique_ptr<ModelPart> part) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _parts.push_back(std::move(part));
+    }
+    _partReady.notify_all();
+}
@@ -0,0 +1,270 @@
+#include "../include/NormalGenerator.h"
+#include "../include/Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+// Items per thread below which splitting the work costs more than it saves
+static const size_t PARALLEL_MIN_ITEMS = 16384;
+
+// Corner normals closer than this (as a dot product) share one vertex
+static const float SAME_NORMAL_DOT = 0.9999f;
+
+// Angle between two edges leaving a corner
+static float cornerAngle(const glm::vec3 &a, const glm::vec3 &b) {
+    float lengths = glm::length(a) * glm::length(b);
+    if (lengths <= FLT_MIN) {
+        return 0.0f;
+    }
+    return acosf(std::max(-1.0f, std::min(1.0f, glm::dot(a, b) / lengths)));
+}
+
+// Corner angles of every triangle, in corner order
+static std::vector<float> computeCornerAngles(const std::vector<Vertex>       &vertices,
+                                              const std::vector<unsigned int> &indices) {
+    std::vector<float> angles(indices.size());
+    parallelFor(indices.size() / 3, PARALLEL_MIN_ITEMS, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const glm::vec3 &p0 = vertices[indices[t * 3]].position;
+            const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].position;
+            angles[t * 3] = cornerAngle(p1 - p0, p2 - p0);
+            angles[t * 3 + 1] = cornerAngle(p2 - p1, p0 - p1);
+            angles[t * 3 + 2] = cornerAngle(p0 - p2, p1 - p2);
+        }
+    });
+    return angles;
+}
+
+// Groups the corners by key with a counting sort: the corners of key k are
+// adjacency[offsets[k]] up to adjacency[offsets[k + 1]]
+static void buildAdjacency(const std::vector<unsigned int> &cornerKeys, size_t keyCount,
+                           std::vector<unsigned int> &offsets,
+                           std::vector<unsigned int> &adjacency) {
+    offsets.assign(keyCount + 1, 0);
+    adjacency.resize(cornerKeys.size());
+    for (unsigned int key : cornerKeys) {
+        offsets[key + 1]++;
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+    std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t c = 0; c < cornerKeys.size(); ++c) {
+        adjacency[cursor[cornerKeys[c]]++] = static_cast<unsigned int>(c);
+    }
+}
+
+// Any unit vector perpendicular to n
+static glm::vec3 perpendicular(const glm::vec3 &n) {
+    glm::vec3 axis =
+        std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return glm::normalize(glm::cross(n, axis));
+}
+
+void NormalGenerator::generate(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                               const std::vector<unsigned int>  &positionIds,
+                               const std::vector<unsigned char> &needsNormal,
+                               const std::vector<unsigned int>  &smoothingGroups,
+                               float                             creaseAngle) {
+    size_t triangleCount = indices.size() / 3;
+    size_t cornerCount = triangleCount * 3;
+    float  creaseCosine = cosf(creaseAngle);
+
+    // Compact the position ids so the adjacency arrays scale with this mesh, not the whole file
+    std::vector<unsigned int> positions(positionIds);
+    std::sort(positions.begin(), positions.end());
+    positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+    std::vector<unsigned int> cornerPositions(cornerCount);
+    parallelFor(cornerCount, PARALLEL_MIN_ITEMS, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            unsigned int id = positionIds[indices[c]];
+            cornerPositions[c] = static_cast<unsigned int>(
+                std::lower_bound(positions.begin(), positions.end(), id) - positions.begin());
+        }
+    });
+
+    // Unit face normals and the angle of every corner
+    std::vector<glm::vec3> faceNormals(triangleCount);
+    parallelFor(triangleCount, PARALLEL_MIN_ITEMS, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const glm::vec3 &p0 = vertices[indices[t * 3]].position;
+            glm::vec3        normal = glm::cross(vertices[indices[t * 3 + 1]].position - p0,
+                                                 vertices[indices[t * 3 + 2]].position - p0);
+            float            length = glm::length(normal);
+            faceNormals[t] = length > FLT_MIN ? normal / length : glm::vec3(0.0f);
+        }
+    });
+    std::vector<float> cornerAngles = computeCornerAngles(vertices, indices);
+
+    std::vector<unsigned int> adjacencyOffsets, adjacency;
+    buildAdjacency(cornerPositions, positions.size(), adjacencyOffsets, adjacency);
+
+    // Every corner gathers from its neighbours instead of triangles scattering into vertices
+    std::vector<glm::vec3> cornerNormals(cornerCount);
+    parallelFor(cornerCount, PARALLEL_MIN_ITEMS, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            unsigned int vertex = indices[c];
+            if (!needsNormal[vertex]) {
+                cornerNormals[c] = vertices[vertex].normal;
+                continue;
+            }
+            size_t           triangle = c / 3;
+            unsigned int     group = smoothingGroups[triangle];
+            const glm::vec3 &faceNormal = faceNormals[triangle];
+            if (group == 0) {
+                cornerNormals[c] = faceNormal;
+                continue;
+            }
+
+            // Degenerate triangles have no direction of their own and take their neighbours'
+            glm::vec3    sum(0.0f);
+            bool         degenerate = glm::dot(faceNormal, faceNormal) < 0.5f;
+            unsigned int position = cornerPositions[c];
+            for (unsigned int a = adjacencyOffsets[position]; a < adjacencyOffsets[position + 1];
+                 ++a) {
+                size_t other = adjacency[a] / 3;
+                if (smoothingGroups[other] == group &&
+                    (degenerate || glm::dot(faceNormal, faceNormals[other]) >= creaseCosine)) {
+                    sum += faceNormals[other] * cornerAngles[adjacency[a]];
+                }
+            }
+            float length = glm::length(sum);
+            cornerNormals[c] = length > FLT_MIN ? sum / length : faceNormal;
+        }
+    });
+
+    _splitVertices(vertices, indices, needsNormal, cornerNormals);
+}
+
+// Gives every vertex the normal of its corners. The first distinct normal stays on the vertex,
+// every other one gets a copy of it appended to the vertex array.
+void NormalGenerator::_splitVertices(std::vector<Vertex>              &vertices,
+                                     std::vector<unsigned int>        &indices,
+                                     const std::vector<unsigned char> &needsNormal,
+                                     const std::vector<glm::vec3>     &cornerNormals) {
+    size_t                    vertexCount = vertices.size();
+    std::vector<unsigned int> offsets, corners;
+    buildAdjacency(indices, vertexCount, offsets, corners);
+
+    std::vector<unsigned int> copies;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (!needsNormal[v] || offsets[v] == offsets[v + 1]) {
+            continue;
+        }
+        copies.assign(1, static_cast<unsigned int>(v));
+        vertices[v].normal = cornerNormals[corners[offsets[v]]];
+        for (unsigned int a = offsets[v] + 1; a < offsets[v + 1]; ++a) {
+            unsigned int     corner = corners[a];
+            const glm::vec3 &normal = cornerNormals[corner];
+            unsigned int     match = static_cast<unsigned int>(-1);
+            for (unsigned int copy : copies) {
+                if (glm::dot(vertices[copy].normal, normal) >= SAME_NORMAL_DOT) {
+                    match = copy;
+                    break;
+                }
+            }
+            if (match == static_cast<unsigned int>(-1)) {
+                Vertex vertex = vertices[v];
+                vertex.normal = normal;
+                match = static_cast<unsigned int>(vertices.size());
+                vertices.push_back(vertex);
+                copies.push_back(match);
+            }
+            indices[corner] = match;
+        }
+    }
+}
+
+// Per-triangle UV gradients, projected on each vertex normal and averaged with corner angle
+// weights over the corners of the vertex that agree on handedness, like MikkTSpace does. Corners
+// of a mirrored UV island disagree, so their vertex is split.
+void NormalGenerator::generateTangents(std::vector<Vertex>       &vertices,
+                                       std::vector<unsigned int> &indices) {
+    size_t triangleCount = indices.size() / 3;
+    size_t cornerCount = triangleCount * 3;
+
+    std::vector<glm::vec3> faceTangents(triangleCount);
+    std::vector<glm::vec3> faceBitangents(triangleCount);
+    parallelFor(triangleCount, PARALLEL_MIN_ITEMS, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const Vertex &v0 = vertices[indices[t * 3]];
+            const Vertex &v1 = vertices[indices[t * 3 + 1]];
+            const Vertex &v2 = vertices[indices[t * 3 + 2]];
+            glm::vec3     edge1 = v1.position - v0.position;
+            glm::vec3     edge2 = v2.position - v0.position;
+            glm::vec2     uv1 = v1.texCoords - v0.texCoords;
+            glm::vec2     uv2 = v2.texCoords - v0.texCoords;
+            float         area = uv1.x * uv2.y - uv2.x * uv1.y;
+            if (std::fabs(area) <= FLT_MIN) {
+                faceTangents[t] = glm::vec3(0.0f);
+                faceBitangents[t] = glm::vec3(0.0f);
+                continue;
+            }
+            faceTangents[t] = (edge1 * uv2.y - edge2 * uv1.y) / area;
+            faceBitangents[t] = (edge2 * uv1.x - edge1 * uv2.x) / area;
+        }
+    });
+    std::vector<float> cornerAngles = computeCornerAngles(vertices, indices);
+
+    std::vector<unsigned int> offsets, corners;
+    buildAdjacency(indices, vertices.size(), offsets, corners);
+
+    // Handedness of every corner: the sign of the bitangent relative to normal x tangent
+    std::vector<float> cornerSigns(cornerCount);
+    parallelFor(cornerCount, PARALLEL_MIN_ITEMS, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            const glm::vec3 &normal = vertices[indices[c]].normal;
+            float            handedness =
+                glm::dot(glm::cross(normal, faceTangents[c / 3]), faceBitangents[c / 3]);
+            cornerSigns[c] = handedness < 0.0f ? -1.0f : 1.0f;
+        }
+    });
+
+    std::vector<glm::vec4> cornerTangents(cornerCount);
+    parallelFor(cornerCount, PARALLEL_MIN_ITEMS, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            unsigned int     vertex = indices[c];
+            const glm::vec3 &normal = vertices[vertex].normal;
+            glm::vec3        sum(0.0f);
+            for (unsigned int a = offsets[vertex]; a < offsets[vertex + 1]; ++a) {
+                unsigned int other = corners[a];
+                if ((cornerSigns[other] < 0.0f) != (cornerSigns[c] < 0.0f)) {
+                    continue;
+                }
+                glm::vec3 tangent = faceTangents[other / 3];
+                tangent -= normal * glm::dot(normal, tangent);
+                float length = glm::length(tangent);
+                if (length > FLT_MIN) {
+                    sum += tangent * (cornerAngles[other] / length);
+                }
+            }
+            float length = glm::length(sum);
+            glm::vec3 tangent = length > FLT_MIN ? sum / length : perpendicular(normal);
+            cornerTangents[c] = glm::vec4(tangent, cornerSigns[c]);
+        }
+    });
+
+    // Corners of one handedness keep the vertex, the other handedness gets one copy
+    size_t vertexCount = vertices.size();
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (offsets[v] == offsets[v + 1]) {
+            continue;
+        }
+        float        firstSign = cornerTangents[corners[offsets[v]]].w;
+        unsigned int mirrored = static_cast<unsigned int>(-1);
+        vertices[v].tangent = cornerTangents[corners[offsets[v]]];
+        for (unsigned int a = offsets[v] + 1; a < offsets[v + 1]; ++a) {
+            unsigned int corner = corners[a];
+            if ((cornerTangents[corner].w < 0.0f) == (firstSign < 0.0f)) {
+                continue;
+            }
+            if (mirrored == static_cast<unsigned int>(-1)) {
+                Vertex vertex = vertices[v];
+                vertex.tangent = cornerTangents[corner];
+                mirrored = static_cast<unsigned int>(vertices.size());
+                vertices.push_back(vertex);
+            }
+            indices[corner] = mirrored;
+        }
+    }
+}
@@ -1,11 +1,30 @@
 #include "../include/ObjLoader.h"
+#include "../include/LoadStats.h"
+#include "../include/Logger.h"
 #include "../include/Mesh.h"
+#include "../include/NormalGenerator.h"
+#include "../include/TextureCache.h"
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <sstream>
 
-ObjLoader::ObjLoader(const std::string &filePath) { _parseObjFile(filePath); }
+// Number of detail levels generated per SubMesh, LOD 0 included
+static const size_t LOD_LEVEL_COUNT = 4;
+
+// Generated normals are not smoothed across edges sharper than this
+static const float CREASE_ANGLE_DEGREES = 60.0f;
+
+// SubMeshes with at least this many triangles are split into meshlets for finer culling
+static const size_t MESHLET_MIN_TRIANGLES = 4096;
+
+ObjLoader::ObjLoader(const std::string &filePath, TextureCache &textures)
+    : _textures(textures),
+      _currentSmoothingGroup(1) {
+    _parseObjFile(filePath);
+}
 
 static std::string getParentPath(const std::string &path) {
     size_t pos = path.find_last_of("/\\");
@@ -29,16 +48,38 @@ static std::string combinePaths(const std::string &path1, const std::string &pat
 
 const std::vector<ObjObject> &ObjLoader::getObjects() const { return _objects; }
 
+const std::vector<std::string> &ObjLoader::getMaterialFiles() const { return _materialFiles; }
+
+// The whole file is read at once, then split into lines
 void ObjLoader::_parseObjFile(const std::string &filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        std::cerr << "Erreur: impossible d'ouvrir le fichier OBJ: " << filePath << std::endl;
-        throw std::runtime_error("Impossible d'ouvrir le fichier OBJ.");
+    std::string contents;
+    {
+        LoadStageScope read("file read");
+        std::ifstream  file(filePath.c_str(), std::ios::binary);
+        if (!file.is_open()) {
+            LogMessage(LOG_ERROR) << "Erreur: impossible d'ouvrir le fichier OBJ: " << filePath;
+            throw std::runtime_error("Impossible d'ouvrir le fichier OBJ.");
+        }
+        file.seekg(0, std::ios::end);
+        std::streamoff size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        contents.resize(static_cast<size_t>(std::max(size, static_cast<std::streamoff>(0))));
+        file.read(&contents[0], static_cast<std::streamsize>(contents.size()));
+        contents.resize(static_cast<size_t>(file.gcount()));
+        read.addBytes(contents.size());
     }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream lineStream(line);
+    // Faces and the vertex dedup map are nested stages, so this one times the line splitting and
+    // the other records
+    LoadStageScope tokenize("tokenize", contents.size());
+    size_t         lineStart = 0;
+    while (lineStart < contents.size()) {
+        size_t lineEnd = contents.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = contents.size();
+        }
+        std::istringstream lineStream(contents.substr(lineStart, lineEnd - lineStart));
+        lineStart = lineEnd + 1;
         std::string        prefix;
         lineStream >> prefix;
 
@@ -69,67 +110,159 @@ void ObjLoader::_parseObjFile(const std::string &filePath) {
             }
             lineStream >> _currentMaterialName;
             _currentSubMesh.materialName = _currentMaterialName;
+        } else if (prefix == "s") {
+            // Files without `s` records are smoothed; "off" and 0 mean flat shading
+            std::string group;
+            lineStream >> group;
+            _currentSmoothingGroup =
+                group == "off"
+                    ? 0
+                    : static_cast<unsigned int>(std::strtoul(group.c_str(), nullptr, 10));
+        } else if (prefix == "o" || prefix == "g") {
+            // Objects and groups each become an ObjObject with its own vertices; a group inside
+            // a named object is called "object/group"
+            std::string name;
+            std::getline(lineStream >> std::ws, name);
+            if (prefix == "o") {
+                _currentObjectName = name;
+            }
+            _startNewObject();
+            if (prefix == "o" || _currentObjectName.empty()) {
+                _currentObject.name = name;
+            } else {
+                _currentObject.name = _currentObjectName + "/" + name;
+            }
         }
     }
 
+    _finishObject();
+}
+
+// Closes the current object. The material carries over, since `usemtl` is not repeated after
+// every `o` or `g`.
+void ObjLoader::_startNewObject() {
+    _finishObject();
+    _currentObject = ObjObject();
+    _currentSubMesh = SubMesh();
+    _currentSubMesh.materialName = _currentMaterialName;
+    _vertexCache.clear();
+    _vertexPositionIds.clear();
+    _vertexNeedsNormal.clear();
+    _triangleSmoothingGroups.clear();
+}
+
+void ObjLoader::_finishObject() {
     if (!_currentSubMesh.indices.empty()) {
         _currentObject.subMeshes.push_back(_currentSubMesh);
+        _currentSubMesh.indices.clear();
     }
-    if (!_currentObject.subMeshes.empty()) {
-        _objects.push_back(_currentObject);
+    if (_currentObject.subMeshes.empty()) {
+        return;
+    }
+    LoadStageScope normals("normals", _currentObject.vertices.size() * sizeof(Vertex));
+    if (std::find(_vertexNeedsNormal.begin(), _vertexNeedsNormal.end(), 1) !=
+        _vertexNeedsNormal.end()) {
+        _generateNormals();
+    }
+    if (_needsTangents()) {
+        std::vector<unsigned int> indices = _gatherIndices();
+        NormalGenerator::generateTangents(_currentObject.vertices, indices);
+        _scatterIndices(indices);
     }
+    _objects.push_back(_currentObject);
+}
 
-    file.close();
+// Fills in the normals the faces did not reference. SubMeshes share the object's vertices, so
+// their triangles are processed together, in parse order to line up with the smoothing groups.
+void ObjLoader::_generateNormals() {
+    std::vector<unsigned int> indices = _gatherIndices();
+    NormalGenerator::generate(_currentObject.vertices, indices, _vertexPositionIds,
+                              _vertexNeedsNormal, _triangleSmoothingGroups,
+                              glm::radians(CREASE_ANGLE_DEGREES));
+    _scatterIndices(indices);
 }
 
-void ObjLoader::_startNewObject() {
-    if (!_currentSubMesh.indices.empty()) {
-        _currentObject.subMeshes.push_back(_currentSubMesh);
-        _currentSubMesh = SubMesh();
+// Tangents are only worth their cost when a material of the object is normal mapped
+bool ObjLoader::_needsTangents() const {
+    for (const auto &subMesh : _currentObject.subMeshes) {
+        auto it = _materials.find(subMesh.materialName);
+        if (it != _materials.end() && it->second.hasMap(MAP_NORMAL)) {
+            return true;
+        }
     }
-    if (!_currentObject.subMeshes.empty()) {
-        _objects.push_back(_currentObject);
+    return false;
+}
+
+// Indices of every SubMesh of the current object, concatenated in parse order
+std::vector<unsigned int> ObjLoader::_gatherIndices() const {
+    std::vector<unsigned int> indices;
+    for (const auto &subMesh : _currentObject.subMeshes) {
+        indices.insert(indices.end(), subMesh.indices.begin(), subMesh.indices.end());
+    }
+    return indices;
+}
+
+void ObjLoader::_scatterIndices(const std::vector<unsigned int> &indices) {
+    size_t offset = 0;
+    for (auto &subMesh : _currentObject.subMeshes) {
+        std::copy(indices.begin() + static_cast<std::ptrdiff_t>(offset),
+                  indices.begin() + static_cast<std::ptrdiff_t>(offset + subMesh.indices.size()),
+                  subMesh.indices.begin());
+        offset += subMesh.indices.size();
     }
-    _currentObject = ObjObject();
-    _vertexCache.clear();
 }
 
+// Each corner is looked up in the dedup map once, taking the index it would get if new; corners
+// already seen in this object reuse their vertex, the others are then parsed and added in order
 void ObjLoader::_processFaceData(const std::vector<std::string> &data) {
-    std::vector<unsigned int> vertexIndices;
-
-    for (const auto &vertexData : data) {
-        std::string key = vertexData;
-
-        unsigned int newIndex;
-        if (_vertexCache.find(key) != _vertexCache.end()) {
-            newIndex = _vertexCache[key];
-        } else {
-            std::istringstream vertexStream(vertexData);
-            std::string        posIndexStr, texIndexStr, normIndexStr;
-
-            std::getline(vertexStream, posIndexStr, '/');
-            std::getline(vertexStream, texIndexStr, '/');
-            std::getline(vertexStream, normIndexStr, '/');
-
-            unsigned int posIndex = _parseIndex(posIndexStr, _positions.size());
-            unsigned int texIndex = texIndexStr.empty()
-                                        ? static_cast<unsigned int>(-1)
-                                        : _parseIndex(texIndexStr, _texCoords.size());
-            unsigned int normIndex = normIndexStr.empty()
-                                         ? static_cast<unsigned int>(-1)
-                                         : _parseIndex(normIndexStr, _normals.size());
-
-            glm::vec3 pos = _positions.at(posIndex);
-            glm::vec2 texCoords = texIndex != static_cast<unsigned int>(-1)
-                                      ? _texCoords.at(texIndex)
-                                      : glm::vec2(0.0f);
-            glm::vec3 normal = normIndex != static_cast<unsigned int>(-1) ? _normals.at(normIndex)
-                                                                          : glm::vec3(0.0f);
-
-            newIndex = _addVertex(key, pos, normal, texCoords);
-            _vertexCache[key] = newIndex;
+    LoadStageScope            faces("face processing");
+    std::vector<unsigned int> vertexIndices(data.size());
+    {
+        LoadStageScope dedup("dedup");
+        unsigned int   nextVertex = static_cast<unsigned int>(_currentObject.vertices.size());
+        for (size_t i = 0; i < data.size(); ++i) {
+            auto inserted = _vertexCache.insert(std::make_pair(data[i], nextVertex));
+            vertexIndices[i] = inserted.first->second;
+            if (inserted.second) {
+                nextVertex++;
+            }
+            dedup.addBytes(data[i].size());
+        }
+    }
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        const std::string &vertexData = data[i];
+        faces.addBytes(vertexData.size() + 1);
+        // Reused corners, including one repeated earlier in this face, point below the next vertex
+        if (vertexIndices[i] != _currentObject.vertices.size()) {
+            continue;
         }
-        vertexIndices.push_back(newIndex);
+
+        std::istringstream vertexStream(vertexData);
+        std::string        posIndexStr, texIndexStr, normIndexStr;
+
+        std::getline(vertexStream, posIndexStr, '/');
+        std::getline(vertexStream, texIndexStr, '/');
+        std::getline(vertexStream, normIndexStr, '/');
+
+        unsigned int posIndex = _parseIndex(posIndexStr, _positions.size());
+        unsigned int texIndex = texIndexStr.empty()
+                                    ? static_cast<unsigned int>(-1)
+                                    : _parseIndex(texIndexStr, _texCoords.size());
+        unsigned int normIndex = normIndexStr.empty()
+                                     ? static_cast<unsigned int>(-1)
+                                     : _parseIndex(normIndexStr, _normals.size());
+
+        glm::vec3 pos = _positions.at(posIndex);
+        glm::vec2 texCoords = texIndex != static_cast<unsigned int>(-1)
+                                  ? _texCoords.at(texIndex)
+                                  : glm::vec2(0.0f);
+        glm::vec3 normal = normIndex != static_cast<unsigned int>(-1) ? _normals.at(normIndex)
+                                                                      : glm::vec3(0.0f);
+
+        _addVertex(pos, normal, texCoords);
+        _vertexPositionIds.push_back(posIndex);
+        _vertexNeedsNormal.push_back(normIndexStr.empty() ? 1 : 0);
     }
 
     // Triangulate the face if it has more than 3 vertices
@@ -138,6 +271,7 @@ void ObjLoader::_processFaceData(const std::vector<std::string> &data) {
             _currentSubMesh.indices.push_back(vertexIndices[0]);
             _currentSubMesh.indices.push_back(vertexIndices[i]);
             _currentSubMesh.indices.push_back(vertexIndices[i + 1]);
+            _triangleSmoothingGroups.push_back(_currentSmoothingGroup);
         }
     }
 }
@@ -151,13 +285,11 @@ unsigned int ObjLoader::_parseIndex(const std::string &index, size_t size) const
     return static_cast<unsigned int>(idx);
 }
 
-unsigned int ObjLoader::_addVertex(const std::string &key, const glm::vec3 &pos,
-                                   const glm::vec3 &normal, const glm::vec2 &texCoords) {
-    Vertex vertex = {pos, texCoords, normal};
+unsigned int ObjLoader::_addVertex(const glm::vec3 &pos, const glm::vec3 &normal,
+                                   const glm::vec2 &texCoords) {
+    Vertex vertex = {pos, texCoords, normal, glm::vec4(0.0f)};
     _currentObject.vertices.push_back(vertex);
-    unsigned int index = static_cast<unsigned int>(_currentObject.vertices.size() - 1);
-    _vertexCache[key] = index;
-    return index;
+    return static_cast<unsigned int>(_currentObject.vertices.size() - 1);
 }
 
 void ObjLoader::_loadMaterialFile(const std::string &objFilePath,
@@ -165,19 +297,23 @@ void ObjLoader::_loadMaterialFile(const std::string &objFilePath,
     // Construire le chemin complet vers le fichier .mtl
     std::string objParentPath = getParentPath(objFilePath);
     std::string mtlFilePath = combinePaths(objParentPath, mtllibFilename);
+    _materialFiles.push_back(mtlFilePath);
 
-    std::ifstream mtlFile(mtlFilePath.c_str());
+    LoadStageScope materials("material load");
+    std::ifstream  mtlFile(mtlFilePath.c_str());
     if (!mtlFile.is_open()) {
-        std::cerr << "Erreur: impossible d'ouvrir le fichier de matériau: " << mtlFilePath
-                  << std::endl;
+        LogMessage(LOG_ERROR) << "Erreur: impossible d'ouvrir le fichier de matériau: "
+                              << mtlFilePath;
         return;
     }
 
+    std::string mtlParentPath = getParentPath(mtlFilePath);
     std::string line;
     std::string currentMaterialName;
     Material    currentMaterial;
 
     while (std::getline(mtlFile, line)) {
+        materials.addBytes(line.size() + 1);
         std::istringstream lineStream(line);
         std::string        prefix;
         lineStream >> prefix;
@@ -188,7 +324,6 @@ void ObjLoader::_loadMaterialFile(const std::string &objFilePath,
             }
             lineStream >> currentMaterialName;
             currentMaterial = Material();
-            currentMaterial.name = currentMaterialName;
         } else if (prefix == "Ka") {
             lineStream >> currentMaterial.ambient.r >> currentMaterial.ambient.g >>
                 currentMaterial.ambient.b;
@@ -198,13 +333,28 @@ void ObjLoader::_loadMaterialFile(const std::string &objFilePath,
         } else if (prefix == "Ks") {
             lineStream >> currentMaterial.specular.r >> currentMaterial.specular.g >>
                 currentMaterial.specular.b;
+        } else if (prefix == "Ke") {
+            lineStream >> currentMaterial.emissive.r >> currentMaterial.emissive.g >>
+                currentMaterial.emissive.b;
         } else if (prefix == "Ns") {
             lineStream >> currentMaterial.shininess;
+        } else if (prefix == "d") {
+            lineStream >> currentMaterial.opacity;
+        } else if (prefix == "Tr") {
+            float transparency = 0.0f;
+            lineStream >> transparency;
+            currentMaterial.opacity = 1.0f - transparency;
+        } else if (prefix == "illum") {
+            lineStream >> currentMaterial.illum;
         } else if (prefix == "map_Kd") {
-            lineStream >> currentMaterial.diffuseMapPath;
-            std::string mtlParentPath = getParentPath(mtlFilePath);
-            std::string texturePath = combinePaths(mtlParentPath, currentMaterial.diffuseMapPath);
-            currentMaterial.diffuseMapPath = texturePath;
+            _parseTextureStatement(lineStream, mtlParentPath, currentMaterial, MAP_DIFFUSE);
+        } else if (prefix == "map_Ks") {
+            _parseTextureStatement(lineStream, mtlParentPath, currentMaterial, MAP_SPECULAR);
+        } else if (prefix == "map_d") {
+            _parseTextureStatement(lineStream, mtlParentPath, currentMaterial, MAP_OPACITY);
+        } else if (prefix == "map_Bump" || prefix == "map_bump" || prefix == "bump" ||
+                   prefix == "norm") {
+            _parseTextureStatement(lineStream, mtlParentPath, currentMaterial, MAP_NORMAL);
         }
     }
     if (!currentMaterialName.empty()) {
@@ -214,19 +364,104 @@ void ObjLoader::_loadMaterialFile(const std::string &objFilePath,
     mtlFile.close();
 }
 
+// Number of arguments taken by each texture option; -s, -o and -t take one to three numbers
+static size_t textureOptionArguments(const std::string &option) {
+    if (option == "-mm") {
+        return 2;
+    }
+    if (option == "-bm" || option == "-boost" || option == "-texres" || option == "-imfchan" ||
+        option == "-blendu" || option == "-blendv" || option == "-clamp" || option == "-cc") {
+        return 1;
+    }
+    return 0;
+}
+
+static bool isNumber(const std::string &token) {
+    char *end = nullptr;
+    std::strtof(token.c_str(), &end);
+    return !token.empty() && *end == '\0';
+}
+
+// "map_Kd -s 2 2 -o 0.5 0.5 textures/wood grain.png": options first, then the file name, which
+// may contain spaces
+void ObjLoader::_parseTextureStatement(std::istringstream &lineStream,
+                                       const std::string &mtlParentPath, Material &material,
+                                       MaterialMap map) {
+    std::vector<std::string> tokens{std::istream_iterator<std::string>{lineStream},
+                                    std::istream_iterator<std::string>{}};
+    glm::vec4 &transform = material.mapTransforms[map];
+
+    size_t i = 0;
+    while (i < tokens.size() && tokens[i].size() > 1 && tokens[i][0] == '-' &&
+           !isNumber(tokens[i])) {
+        std::string option = tokens[i++];
+        if (option == "-s" || option == "-o" || option == "-t") {
+            float  values[3] = {option == "-s" ? 1.0f : 0.0f, option == "-s" ? 1.0f : 0.0f, 0.0f};
+            size_t count = 0;
+            while (count < 3 && i < tokens.size() && isNumber(tokens[i])) {
+                values[count++] = std::strtof(tokens[i++].c_str(), nullptr);
+            }
+            if (count == 1 && option == "-s") {
+                values[1] = values[0];
+            }
+            if (option == "-s") {
+                transform.x = values[0];
+                transform.y = values[1];
+            } else if (option == "-o") {
+                transform.z = values[0];
+                transform.w = values[1];
+            }
+            continue;
+        }
+        size_t arguments = std::min(textureOptionArguments(option), tokens.size() - i);
+        if (option == "-bm" && arguments == 1) {
+            material.bumpScale = std::strtof(tokens[i].c_str(), nullptr);
+        }
+        i += arguments;
+    }
+
+    std::string fileName;
+    for (; i < tokens.size(); ++i) {
+        fileName += (fileName.empty() ? "" : " ") + tokens[i];
+    }
+    if (fileName.empty()) {
+        LogMessage(LOG_WARNING) << "Warning: texture statement without a file name";
+        return;
+    }
+    material.maps[map] = _textures.add(combinePaths(mtlParentPath, fileName));
+}
+
 std::vector<std::shared_ptr<Mesh>> ObjLoader::getMeshes() const {
     std::vector<std::shared_ptr<Mesh>> meshes;
-    for (const auto &object : _objects) {
-        auto verticesPtr = std::make_shared<std::vector<Vertex>>(object.vertices);
-        for (const auto &subMesh : object.subMeshes) {
-            std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(verticesPtr, subMesh.indices);
-
-            auto it = _materials.find(subMesh.materialName);
-            if (it != _materials.end()) {
-                mesh->setMaterial(it->second);
-            }
-            meshes.push_back(mesh);
+    for (size_t i = 0; i < _objects.size(); ++i) {
+        std::vector<std::shared_ptr<Mesh>> objectMeshes = getObjectMeshes(i);
+        meshes.insert(meshes.end(), objectMeshes.begin(), objectMeshes.end());
+    }
+    return meshes;
+}
+
+std::vector<std::shared_ptr<Mesh>> ObjLoader::getObjectMeshes(size_t objectIndex) const {
+    const ObjObject                   &object = _objects.at(objectIndex);
+    std::vector<std::shared_ptr<Mesh>> meshes;
+    LoadStageScope build("mesh build", object.vertices.size() * sizeof(Vertex));
+    auto verticesPtr = std::make_shared<std::vector<Vertex>>(object.vertices);
+    for (const auto &subMesh : object.subMeshes) {
+        std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(verticesPtr, subMesh.indices);
+        if (subMesh.indices.size() / 3 >= MESHLET_MIN_TRIANGLES) {
+            mesh->buildMeshlets();
+        }
+        mesh->buildLods(LOD_LEVEL_COUNT);
+        {
+            // Picking would otherwise build it on the render thread
+            LoadStageScope bvh("triangle BVH", subMesh.indices.size() * sizeof(unsigned int));
+            mesh->buildTriangleBvh();
+        }
+
+        auto it = _materials.find(subMesh.materialName);
+        if (it != _materials.end()) {
+            mesh->setMaterial(it->second, it->first);
         }
+        meshes.push_back(mesh);
     }
     return meshes;
 }
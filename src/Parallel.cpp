@@ -0,0 +1,28 @@
+#include "../include/Parallel.h"
+#include "../include/JobSystem.h"
+#include <algorithm>
+
+// Chunks per thread, for load balancing through stealing
+static const size_t CHUNKS_PER_THREAD = 4;
+
+void parallelFor(size_t count, size_t minChunk,
+                 const std::function<void(size_t begin, size_t end)> &body) {
+    JobSystem &jobs = JobSystem::getDefault();
+    size_t     chunkCount = (jobs.getWorkerCount() + 1) * CHUNKS_PER_THREAD;
+    chunkCount = std::min(chunkCount, count / std::max(minChunk, static_cast<size_t>(1)));
+    if (chunkCount <= 1 || jobs.getWorkerCount() == 0) {
+        if (count > 0) {
+            body(0, count);
+        }
+        return;
+    }
+
+    size_t     chunk = (count + chunkCount - 1) / chunkCount;
+    JobCounter counter;
+    for (size_t begin = chunk; begin < count; begin += chunk) {
+        size_t end = std::min(begin + chunk, count);
+        jobs.run([&body, begin, end]() { body(begin, end); }, &counter);
+    }
+    body(0, std::min(chunk, count));
+    jobs.wait(counter);
+}
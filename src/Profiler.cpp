@@ -0,0 +1,184 @@
+#include "../include/Profiler.h"
+#include "../include/Json.h"
+#include <algorithm>
+#include <fstream>
+
+const size_t Profiler::FRAME_LATENCY;
+const size_t Profiler::MAX_TRACE_EVENTS;
+
+Profiler::Profiler()
+    : _enabled(true),
+      _inFrame(false),
+      _capturing(false),
+      _frameIndex(0),
+      _epoch(std::chrono::steady_clock::now()),
+      _gpuOffset(0),
+      _gpuOffsetSet(false) {}
+
+Profiler::~Profiler() {
+    for (Frame &frame : _frames) {
+        if (!frame.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+        }
+    }
+}
+
+void Profiler::beginFrame() {
+    if (!_enabled || _inFrame) {
+        return;
+    }
+    if (!_gpuOffsetSet) {
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        _gpuOffset = gpuNow - _now();
+        _gpuOffsetSet = true;
+    }
+
+    Frame &frame = _frames[_frameIndex % FRAME_LATENCY];
+    if (frame.pending && !_readBack(frame)) {
+        // The GPU is more than FRAME_LATENCY frames behind: keep that frame and skip this one
+        return;
+    }
+    frame.sections.clear();
+    _openSections.clear();
+    _inFrame = true;
+    beginScope("frame");
+}
+
+void Profiler::endFrame() {
+    if (!_inFrame) {
+        return;
+    }
+    while (!_openSections.empty()) {
+        endScope();
+    }
+    Frame &frame = _frames[_frameIndex % FRAME_LATENCY];
+    frame.pending = !frame.sections.empty();
+    _inFrame = false;
+    _frameIndex++;
+}
+
+void Profiler::beginScope(const char *name) {
+    if (!_inFrame) {
+        return;
+    }
+    Frame       &frame = _frames[_frameIndex % FRAME_LATENCY];
+    unsigned int section = static_cast<unsigned int>(frame.sections.size());
+    if (frame.queries.size() < (section + 1) * 2) {
+        size_t oldSize = frame.queries.size();
+        frame.queries.resize(std::max(oldSize * 2, static_cast<size_t>(32)));
+        glGenQueries(static_cast<GLsizei>(frame.queries.size() - oldSize),
+                     frame.queries.data() + oldSize);
+    }
+    Section record = {name, static_cast<unsigned int>(_openSections.size()), _now(), 0};
+    frame.sections.push_back(record);
+    _openSections.push_back(section);
+    glQueryCounter(frame.queries[section * 2], GL_TIMESTAMP);
+}
+
+void Profiler::endScope() {
+    if (!_inFrame || _openSections.empty()) {
+        return;
+    }
+    Frame       &frame = _frames[_frameIndex % FRAME_LATENCY];
+    unsigned int section = _openSections.back();
+    _openSections.pop_back();
+    glQueryCounter(frame.queries[section * 2 + 1], GL_TIMESTAMP);
+    frame.sections[section].cpuEnd = _now();
+}
+
+void Profiler::flush() {
+    endFrame();
+    glFinish();
+    for (size_t i = 0; i < FRAME_LATENCY; ++i) {
+        Frame &frame = _frames[(_frameIndex + i) % FRAME_LATENCY];
+        if (frame.pending) {
+            _readBack(frame);
+        }
+    }
+}
+
+void Profiler::setEnabled(bool enabled) {
+    if (!enabled) {
+        endFrame();
+    }
+    _enabled = enabled;
+}
+
+bool Profiler::isEnabled() const { return _enabled; }
+
+const std::vector<Profiler::Timing> &Profiler::getTimings() const { return _timings; }
+
+void Profiler::startCapture() {
+    _trace.clear();
+    _capturing = true;
+}
+
+void Profiler::writeTrace(const std::string &path) const {
+    std::ofstream out(path.c_str());
+    if (!out.is_open()) {
+        throw std::runtime_error("Cannot write trace: " + path);
+    }
+    out << "{\"traceEvents\": [\n"
+        << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+        << "\"args\": {\"name\": \"CPU\"}},\n"
+        << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, "
+        << "\"args\": {\"name\": \"GPU\"}}";
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    for (const TraceEvent &event : _trace) {
+        out << ",\n{\"name\": " << jsonString(event.name) << ", \"cat\": \""
+            << (event.gpu ? "gpu" : "cpu") << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+            << (event.gpu ? 2 : 1) << ", \"ts\": " << static_cast<double>(event.begin) / 1e3
+            << ", \"dur\": " << static_cast<double>(event.end - event.begin) / 1e3 << "}";
+    }
+    out << "\n]}\n";
+}
+
+int64_t Profiler::_now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                _epoch)
+        .count();
+}
+
+bool Profiler::_readBack(Frame &frame) {
+    // The end of the "frame" section is the last timestamp endFrame issues, but check every
+    // section so a partly finished frame is never read
+    if (!_isAvailable(frame.queries[1])) {
+        return false;
+    }
+    for (size_t i = 0; i < frame.sections.size() * 2; ++i) {
+        if (!_isAvailable(frame.queries[i])) {
+            return false;
+        }
+    }
+    frame.pending = false;
+
+    _timings.clear();
+    for (size_t i = 0; i < frame.sections.size(); ++i) {
+        const Section &section = frame.sections[i];
+        GLuint64       gpuBegin = 0, gpuEnd = 0;
+        glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &gpuBegin);
+        glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &gpuEnd);
+
+        Timing timing = {section.name, section.depth,
+                         static_cast<double>(section.cpuEnd - section.cpuBegin) / 1e6,
+                         static_cast<double>(gpuEnd - gpuBegin) / 1e6};
+        _timings.push_back(timing);
+
+        if (_capturing && _trace.size() + 2 <= MAX_TRACE_EVENTS) {
+            TraceEvent cpu = {section.name, false, section.cpuBegin, section.cpuEnd};
+            TraceEvent gpu = {section.name, true, static_cast<int64_t>(gpuBegin) - _gpuOffset,
+                              static_cast<int64_t>(gpuEnd) - _gpuOffset};
+            _trace.push_back(cpu);
+            _trace.push_back(gpu);
+        }
+    }
+    return true;
+}
+
+bool Profiler::_isAvailable(GLuint query) {
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available != 0;
+}
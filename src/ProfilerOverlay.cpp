@@ -0,0 +1,180 @@
+#include "../include/ProfilerOverlay.h"
+#include "../include/Shader.h"
+#include "../include/glad/glad.h"
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+
+static const float        PIXEL_SIZE = 2.0f; // screen pixels per font pixel
+static const float        CHAR_ADVANCE = 4.0f * PIXEL_SIZE;
+static const float        LINE_HEIGHT = 7.0f * PIXEL_SIZE;
+static const float        MARGIN = 8.0f;
+static const float        BAR_PIXELS_PER_MS = 40.0f;
+static const float        MAX_BAR_WIDTH = 320.0f;
+static const size_t       LINE_LENGTH = 38; // characters of text before the bar
+static const unsigned int SOLID = 0x7FFF;   // every pixel of the glyph set
+
+static const glm::vec3 BACKGROUND_COLOR(0.05f, 0.05f, 0.08f);
+static const glm::vec3 TEXT_COLOR(0.9f, 0.9f, 0.9f);
+static const glm::vec3 BAR_COLORS[] = {
+    glm::vec3(0.9f, 0.3f, 0.3f), glm::vec3(0.3f, 0.8f, 0.3f), glm::vec3(0.3f, 0.5f, 0.9f),
+    glm::vec3(0.9f, 0.8f, 0.2f), glm::vec3(0.8f, 0.4f, 0.9f), glm::vec3(0.3f, 0.8f, 0.8f),
+};
+
+// Rows of the 3x5 font from the top, 1 for a lit pixel; lowercase letters draw as uppercase
+static const struct {
+    char        character;
+    const char *pixels;
+} FONT[] = {
+    {'0', "111101101101111"}, {'1', "010110010010111"}, {'2', "111001111100111"},
+    {'3', "111001111001111"}, {'4', "101101111001001"}, {'5', "111100111001111"},
+    {'6', "111100111101111"}, {'7', "111001001001001"}, {'8', "111101111101111"},
+    {'9', "111101111001111"}, {'A', "010101111101101"}, {'B', "110101110101110"},
+    {'C', "011100100100011"}, {'D', "110101101101110"}, {'E', "111100110100111"},
+    {'F', "111100110100100"}, {'G', "011100101101011"}, {'H', "101101111101101"},
+    {'I', "111010010010111"}, {'J', "001001001101010"}, {'K', "101101110101101"},
+    {'L', "100100100100111"}, {'M', "101111111101101"}, {'N', "110101101101101"},
+    {'O', "010101101101010"}, {'P', "110101110100100"}, {'Q', "010101101110011"},
+    {'R', "110101110101101"}, {'S', "011100010001110"}, {'T', "111010010010010"},
+    {'U', "101101101101111"}, {'V', "101101101101010"}, {'W', "101101111111101"},
+    {'X', "101101010101101"}, {'Y', "101101010010010"}, {'Z', "111001010100111"},
+    {'.', "000000000000010"}, {':', "000010000010000"}, {'-', "000000111000000"},
+    {'/', "001001010100100"}, {'(', "010100100100010"}, {')', "010001001001010"},
+    {'_', "000000000000111"},
+};
+
+static unsigned int glyphBits(char character) {
+    char upper = static_cast<char>(std::toupper(static_cast<unsigned char>(character)));
+    for (const auto &glyph : FONT) {
+        if (glyph.character != upper) {
+            continue;
+        }
+        unsigned int bits = 0;
+        for (const char *pixel = glyph.pixels; *pixel; ++pixel) {
+            bits = (bits << 1) | (*pixel == '1' ? 1u : 0u);
+        }
+        return bits;
+    }
+    return 0;
+}
+
+ProfilerOverlay::ProfilerOverlay() : _vao(0), _vbo(0), _vboCapacity(0) {}
+
+ProfilerOverlay::~ProfilerOverlay() {
+    if (_vbo != 0)
+        glDeleteBuffers(1, &_vbo);
+    if (_vao != 0)
+        glDeleteVertexArrays(1, &_vao);
+}
+
+void ProfilerOverlay::draw(const Profiler &profiler) {
+    const std::vector<Profiler::Timing> &timings = profiler.getTimings();
+    if (timings.empty()) {
+        return;
+    }
+    if (!_shader) {
+        _load();
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    _vertices.clear();
+    float width = CHAR_ADVANCE * static_cast<float>(LINE_LENGTH) + MAX_BAR_WIDTH + MARGIN;
+    float height = LINE_HEIGHT * static_cast<float>(timings.size() + 1) + MARGIN;
+    _addQuad(0.0f, 0.0f, width, height, BACKGROUND_COLOR, SOLID);
+    _addText(MARGIN, MARGIN, "section         cpu ms  gpu ms", TEXT_COLOR);
+
+    for (size_t i = 0; i < timings.size(); ++i) {
+        const Profiler::Timing &timing = timings[i];
+        int                     indent = static_cast<int>(timing.depth * 2);
+        char                    line[LINE_LENGTH + 1];
+        std::snprintf(line, sizeof(line), "%*s%-*s %7.2f %7.2f", indent, "", 14 - indent,
+                      timing.name, timing.cpuMilliseconds, timing.gpuMilliseconds);
+
+        float y = MARGIN + LINE_HEIGHT * static_cast<float>(i + 1);
+        _addText(MARGIN, y, line, TEXT_COLOR);
+        float bar = std::min(static_cast<float>(timing.gpuMilliseconds) * BAR_PIXELS_PER_MS,
+                             MAX_BAR_WIDTH);
+        _addQuad(MARGIN + CHAR_ADVANCE * static_cast<float>(LINE_LENGTH), y,
+                 std::max(bar, 1.0f), 5.0f * PIXEL_SIZE,
+                 BAR_COLORS[i % (sizeof(BAR_COLORS) / sizeof(BAR_COLORS[0]))], SOLID);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    if (_vertices.size() > _vboCapacity) {
+        _vboCapacity = _vertices.size() * 2;
+        glBufferData(GL_ARRAY_BUFFER,
+                     static_cast<GLsizeiptr>(_vboCapacity * sizeof(OverlayVertex)), nullptr,
+                     GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+                    static_cast<GLsizeiptr>(_vertices.size() * sizeof(OverlayVertex)),
+                    _vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    _shader->use();
+    _shader->setVec2("viewportSize", static_cast<float>(viewport[2]),
+                     static_cast<float>(viewport[3]));
+    glBindVertexArray(_vao);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(_vertices.size()));
+    glBindVertexArray(0);
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+}
+
+void ProfilerOverlay::_load() {
+    std::unique_ptr<Shader> shader(new Shader());
+    shader->addShaderFromFile("shaders/overlay_vertex.glsl", GL_VERTEX_SHADER);
+    shader->addShaderFromFile("shaders/overlay_fragment.glsl", GL_FRAGMENT_SHADER);
+    shader->link();
+    _shader = std::move(shader);
+
+    glGenVertexArrays(1, &_vao);
+    glGenBuffers(1, &_vbo);
+    glBindVertexArray(_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    GLsizei stride = sizeof(OverlayVertex);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void *>(offsetof(OverlayVertex, position)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void *>(offsetof(OverlayVertex, cell)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void *>(offsetof(OverlayVertex, color)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, stride,
+                           reinterpret_cast<void *>(offsetof(OverlayVertex, glyph)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ProfilerOverlay::_addQuad(float x, float y, float width, float height,
+                               const glm::vec3 &color, unsigned int glyph) {
+    const OverlayVertex corners[4] = {
+        {glm::vec2(x, y), glm::vec2(0.0f, 0.0f), color, glyph},
+        {glm::vec2(x + width, y), glm::vec2(1.0f, 0.0f), color, glyph},
+        {glm::vec2(x + width, y + height), glm::vec2(1.0f, 1.0f), color, glyph},
+        {glm::vec2(x, y + height), glm::vec2(0.0f, 1.0f), color, glyph},
+    };
+    static const int ORDER[6] = {0, 1, 2, 0, 2, 3};
+    for (int corner : ORDER) {
+        _vertices.push_back(corners[corner]);
+    }
+}
+
+void ProfilerOverlay::_addText(float x, float y, const std::string &text,
+                               const glm::vec3 &color) {
+    for (char character : text) {
+        unsigned int glyph = glyphBits(character);
+        if (glyph != 0) {
+            _addQuad(x, y, 3.0f * PIXEL_SIZE, 5.0f * PIXEL_SIZE, color, glyph);
+        }
+        x += CHAR_ADVANCE;
+    }
+}
@@ -0,0 +1,78 @@
+#include "../include/RadixSort.h"
+#include "../include/Parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+static const size_t RADIX_BITS = 8;
+static const size_t BUCKET_COUNT = 1u << RADIX_BITS;
+
+// Chunks get at least this many keys, below it threads cost more than they save
+static const size_t MIN_CHUNK_KEYS = 16384;
+
+uint32_t floatToSortableKey(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    // Negative floats sort backwards, so flip all their bits; positive ones only need the sign set
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+void radixSort(std::vector<uint32_t> &keys, std::vector<unsigned int> &values) {
+    size_t count = keys.size();
+    if (count < 2) {
+        return;
+    }
+    size_t chunkCount = std::max(1u, std::thread::hardware_concurrency());
+    chunkCount = std::max(static_cast<size_t>(1), std::min(chunkCount, count / MIN_CHUNK_KEYS));
+    size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    std::vector<uint32_t>     keysOut(count);
+    std::vector<unsigned int> valuesOut(count);
+    std::vector<size_t>       histograms(chunkCount * BUCKET_COUNT);
+
+    for (size_t shift = 0; shift < 32; shift += RADIX_BITS) {
+        std::fill(histograms.begin(), histograms.end(), 0);
+        parallelFor(chunkCount, 1, [&](size_t firstChunk, size_t lastChunk) {
+            for (size_t chunk = firstChunk; chunk < lastChunk; ++chunk) {
+                size_t *histogram = &histograms[chunk * BUCKET_COUNT];
+                size_t  end = std::min(count, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i) {
+                    histogram[(keys[i] >> shift) & (BUCKET_COUNT - 1)]++;
+                }
+            }
+        });
+
+        // Bucket-major prefix sum: bucket b of chunk c starts after every smaller bucket and
+        // after bucket b of the chunks before c
+        size_t offset = 0;
+        bool   singleBucket = false;
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            size_t bucketTotal = 0;
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                size_t &slot = histograms[chunk * BUCKET_COUNT + bucket];
+                size_t  keysInBucket = slot;
+                slot = offset;
+                offset += keysInBucket;
+                bucketTotal += keysInBucket;
+            }
+            singleBucket = singleBucket || bucketTotal == count;
+        }
+        if (singleBucket) {
+            continue;
+        }
+
+        parallelFor(chunkCount, 1, [&](size_t firstChunk, size_t lastChunk) {
+            for (size_t chunk = firstChunk; chunk < lastChunk; ++chunk) {
+                size_t *cursor = &histograms[chunk * BUCKET_COUNT];
+                size_t  end = std::min(count, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i) {
+                    size_t destination = cursor[(keys[i] >> shift) & (BUCKET_COUNT - 1)]++;
+                    keysOut[destination] = keys[i];
+                    valuesOut[destination] = values[i];
+                }
+            }
+        });
+        keys.swap(keysOut);
+        values.swap(valuesOut);
+    }
+}
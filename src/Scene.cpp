@@ -1,23 +1,285 @@
 #include "../include/Scene.h"
 #include "../include/Camera.h"
+#include "../include/Culling.h"
+#include "../include/FileWatcher.h"
+#include "../include/Logger.h"
 #include "../include/Mesh.h"
+#include "../include/Parallel.h"
+#include "../include/ProfilerOverlay.h"
+#include "../include/RadixSort.h"
 #include "../include/Shader.h"
+#include "../include/ShaderPermutations.h"
 #include "../include/Texture.h"
 #include "../include/glad/glad.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 
-Scene::Scene() : _activeCameraIndex(0) {
+// Direction the single directional light shines from, in world space
+static const glm::vec3 LIGHT_DIRECTION(0.4f, 1.0f, 0.6f);
+
+// Bytes of loading models update() sends to the GPU per frame by default
+static const size_t DEFAULT_UPLOAD_BUDGET = 8 << 20;
+
+// Instances per job when transforming bounds; smaller scenes are not worth the scheduling
+static const size_t PARALLEL_MIN_INSTANCES = 4096;
+
+// Material shader variant features past the texture map ones, which are 1 << map
+static const unsigned int FEATURE_UNLIT = 1u << MAP_COUNT;
+static const unsigned int FEATURE_SPECULAR = 2u << MAP_COUNT;
+static const unsigned int FEATURE_WEIGHTED_OIT = 4u << MAP_COUNT;
+static const unsigned int FEATURE_COUNT = MAP_COUNT + 3;
+
+// Define each feature bit turns on in the material shaders
+static const char *const FEATURE_DEFINES[FEATURE_COUNT] = {
+    "HAS_DIFFUSE_MAP", "HAS_SPECULAR_MAP", "HAS_OPACITY_MAP", "HAS_NORMAL_MAP",
+    "UNLIT",           "SPECULAR",         "WEIGHTED_OIT"};
+
+// Features of the cheapest variant drawing a material with these maps, dropping those its
+// lighting never reads
+static unsigned int getMaterialFeatures(const Material &material, unsigned int maps) {
+    if (material.illum == 0) {
+        return FEATURE_UNLIT | (maps & ((1u << MAP_DIFFUSE) | (1u << MAP_OPACITY)));
+    }
+    if (material.illum >= 2) {
+        return FEATURE_SPECULAR | maps;
+    }
+    return maps & ~(1u << MAP_SPECULAR);
+}
+
+// Sampler of each texture slot in the material shaders, read from the unit of the same number
+static const char *const MAP_TEXTURES[MAP_COUNT] = {"diffuseMap", "specularMap", "opacityMap",
+                                                    "normalMap"};
+
+// Uniform buffer binding point of MaterialBlock, which holds a Material as is
+static const char *const MATERIAL_BLOCK = "MaterialBlock";
+static const GLuint      MATERIAL_BLOCK_BINDING = 0;
+
+static bool isTransparent(const Material &material) {
+    return material.opacity < 1.0f || material.hasMap(MAP_OPACITY);
+}
+
+static std::vector<std::string> getFeatureDefines(unsigned int features) {
+    std::vector<std::string> defines;
+    for (unsigned int i = 0; i < FEATURE_COUNT; ++i) {
+        if (features & (1u << i)) {
+            defines.push_back(FEATURE_DEFINES[i]);
+        }
+    }
+    return defines;
+}
+
+static unsigned int getMaterialMaps(const Material &material) {
+    unsigned int maps = 0;
+    for (unsigned int map = 0; map < MAP_COUNT; ++map) {
+        if (material.hasMap(static_cast<MaterialMap>(map))) {
+            maps |= 1u << map;
+        }
+    }
+    return maps;
+}
+
+// Largest stretch factor the matrix applies to any direction, used to scale bounds and errors
+static float maxScale(const glm::mat4 &matrix) {
+    float x = glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0]));
+    float y = glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1]));
+    float z = glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]));
+    return sqrtf(std::max(x, std::max(y, z)));
+}
+
+Scene::Scene()
+    : _activeCameraIndex(0),
+      _targetFramebuffer(0),
+      _viewportWidth(800),
+      _viewportHeight(600),
+      _lodEnabled(true),
+      _meshletCullingEnabled(true),
+      _weightedOitEnabled(false),
+      _profilerOverlayEnabled(false),
+      _lodPixelThreshold(1.0f),
+      _uploadBudget(DEFAULT_UPLOAD_BUDGET),
+      _loadingModels(0),
+      _reloadingTextures(0),
+      _bvhDirty(false),
+      _instanceBuffer(0),
+      _instanceBufferCapacity(0),
+      _opaqueItemCount(0),
+      _oitFramebuffer(0),
+      _oitAccumTexture(0),
+      _oitRevealageTexture(0),
+      _oitDepthBuffer(0),
+      _oitWidth(0),
+      _oitHeight(0),
+      _emptyVao(0),
+      _materialBuffer(0) {
     // Constructor implementation (if needed)
 }
 
 Scene::~Scene() {
-    // Destructor implementation (if needed)
+    if (_instanceBuffer != 0)
+        glDeleteBuffers(1, &_instanceBuffer);
+    if (_emptyVao != 0)
+        glDeleteVertexArrays(1, &_emptyVao);
+    if (_materialBuffer != 0)
+        glDeleteBuffers(1, &_materialBuffer);
+    _deleteOitTargets();
+}
+
+size_t Scene::addMesh(const std::shared_ptr<Mesh> &mesh, const glm::mat4 &transform) {
+    return addInstance(mesh, transform);
 }
 
-void Scene::addMesh(const std::shared_ptr<Mesh> &mesh) { _meshes.push_back(mesh); }
+size_t Scene::addInstance(const std::shared_ptr<Mesh> &mesh, const glm::mat4 &transform,
+                          int material, unsigned int flags) {
+    return addInstance(mesh, _sceneGraph.createNode(SceneGraph::NO_PARENT, transform), material,
+                       flags);
+}
+
+size_t Scene::addInstance(const std::shared_ptr<Mesh> &mesh, unsigned int node, int material,
+                          unsigned int flags) {
+    if (_instanceBuffer == 0) {
+        glGenBuffers(1, &_instanceBuffer);
+    }
+    _registerMesh(mesh);
+
+    Instance instance;
+    instance.mesh = mesh;
+    instance.node = node;
+    instance.transform = _sceneGraph.getWorldTransform(node);
+    instance.material = material;
+    instance.flags = flags;
+    _instances.push_back(instance);
+
+    _nodeInstances.resize(_sceneGraph.getNodeCount());
+    _nodeInstances[node].push_back(static_cast<unsigned int>(_instances.size() - 1));
+    _bvhDirty = true;
+    return _instances.size() - 1;
+}
+
+void Scene::_registerMesh(const std::shared_ptr<Mesh> &mesh) {
+    if (_meshIds.find(mesh.get()) == _meshIds.end()) {
+        _meshIds[mesh.get()] = static_cast<unsigned int>(_meshes.size());
+        _meshes.push_back(mesh);
+        mesh->upload(); // nothing left to send for meshes of models loaded in the background
+        mesh->setInstanceBuffer(_instanceBuffer);
+    }
+}
+
+// Mesh ids only live for a frame, so the list can be rebuilt from the instances, dropping the
+// meshes a reload replaced
+void Scene::_releaseUnusedMeshes() {
+    _meshes.clear();
+    _meshIds.clear();
+    for (const auto &instance : _instances) {
+        auto id = static_cast<unsigned int>(_meshes.size());
+        if (_meshIds.insert(std::make_pair(instance.mesh.get(), id)).second) {
+            _meshes.push_back(instance.mesh);
+        }
+    }
+}
+
+ModelHandle Scene::loadModel(const std::string &path, const std::vector<glm::mat4> &placements) {
+    ModelHandle load = std::make_shared<ModelLoad>(path, placements);
+    _loadingModels++;
+    _modelLoader.load(load);
+    _uploadModels(SIZE_MAX);
+    return load;
+}
+
+ModelHandle Scene::loadModelAsync(const std::string                &path,
+                                  const std::vector<glm::mat4> &placements) {
+    ModelHandle load = std::make_shared<ModelLoad>(path, placements);
+    _loadingModels++;
+    _modelLoader.request(load);
+    return load;
+}
+
+void Scene::finishLoading() {
+    _uploadModels(SIZE_MAX);
+    while (_loadingModels > 0 || _reloadingTextures > 0) {
+        _modelLoader.waitForPart();
+        _uploadModels(SIZE_MAX);
+    }
+}
+
+void Scene::setUploadBudget(size_t bytesPerFrame) { _uploadBudget = bytesPerFrame; }
+
+size_t Scene::getUploadBudget() const { return _uploadBudget; }
+
+size_t Scene::getLoadingModelCount() const { return _loadingModels; }
+
+void Scene::setLoaderThreadCount(size_t threadCount) { _modelLoader.setThreadCount(threadCount); }
+
+size_t Scene::getLoaderThreadCount() const { return _modelLoader.getThreadCount(); }
+
+void Scene::setHotReloadEnabled(bool enabled) {
+    if (!enabled) {
+        _fileWatcher.reset();
+    } else if (!_fileWatcher) {
+        _fileWatcher.reset(new FileWatcher());
+        _watchFiles();
+    }
+}
+
+bool Scene::isHotReloadEnabled() const { return _fileWatcher != nullptr; }
+
+TextureCache &Scene::getTextureCache() { return _textureCache; }
+
+const TextureCache &Scene::getTextureCache() const { return _textureCache; }
+
+size_t Scene::addMaterial(const Material &material) {
+    std::string key(reinterpret_cast<const char *>(&material), sizeof(Material));
+    auto        it = _materialIndices.find(key);
+    if (it != _materialIndices.end()) {
+        return it->second;
+    }
+    _materials.push_back(material);
+    _materialIndices[key] = _materials.size() - 1;
+
+    // The driver compiles the material's variant while the rest of the scene loads, so that the
+    // first frame drawing it does not wait; one whose textures fail is built when drawn instead
+    if (_materialShaders) {
+        unsigned int features = getMaterialFeatures(material, getMaterialMaps(material));
+        _materialShaders->prepare(getFeatureDefines(features));
+        if (_weightedOitEnabled && isTransparent(material)) {
+            _materialShaders->prepare(getFeatureDefines(features | FEATURE_WEIGHTED_OIT));
+        }
+    }
+    return _materials.size() - 1;
+}
+
+void Scene::setInstanceTransform(size_t instance, const glm::mat4 &transform) {
+    _sceneGraph.setLocalTransform(_instances.at(instance).node, transform);
+}
+
+void Scene::setInstanceMaterial(size_t instance, int material) {
+    _instances.at(instance).material = material;
+}
+
+void Scene::setInstanceFlags(size_t instance, unsigned int flags) {
+    _instances.at(instance).flags = flags;
+}
+
+const Instance &Scene::getInstance(size_t instance) const { return _instances.at(instance); }
+
+size_t Scene::getInstanceCount() const { return _instances.size(); }
 
 void Scene::addTexture(const std::shared_ptr<Texture> &texture) { _textures.push_back(texture); }
 
-void Scene::addShader(const std::shared_ptr<Shader> &shader) { _shaders.push_back(shader); }
+void Scene::addShader(const std::shared_ptr<Shader> &shader) {
+    _shaders.push_back(shader);
+    if (_fileWatcher) {
+        _watchFiles();
+    }
+}
+
+void Scene::setMaterialShaders(const std::shared_ptr<ShaderPermutations> &shaders) {
+    _materialShaders = shaders;
+    _shaderVariants.clear();
+    if (_fileWatcher) {
+        _watchFiles();
+    }
+}
 
 void Scene::addCamera(const std::shared_ptr<Camera> &camera) { _cameras.push_back(camera); }
 
@@ -48,54 +310,929 @@ std::shared_ptr<Camera> Scene::getActiveCamera() const {
 
 std::vector<std::shared_ptr<Camera>> &Scene::getCameras() { return _cameras; }
 
+void Scene::setViewportSize(int width, int height) {
+    _viewportWidth = std::max(width, 1);
+    _viewportHeight = std::max(height, 1);
+}
+
+void Scene::setTargetFramebuffer(GLuint framebuffer) { _targetFramebuffer = framebuffer; }
+
+void Scene::setLodEnabled(bool enabled) { _lodEnabled = enabled; }
+
+bool Scene::isLodEnabled() const { return _lodEnabled; }
+
+void Scene::setMeshletCullingEnabled(bool enabled) { _meshletCullingEnabled = enabled; }
+
+bool Scene::isMeshletCullingEnabled() const { return _meshletCullingEnabled; }
+
+void Scene::setWeightedOitEnabled(bool enabled) { _weightedOitEnabled = enabled; }
+
+bool Scene::isWeightedOitEnabled() const { return _weightedOitEnabled; }
+
+Profiler &Scene::getProfiler() { return _profiler; }
+
+void Scene::setProfilerOverlayEnabled(bool enabled) { _profilerOverlayEnabled = enabled; }
+
+bool Scene::isProfilerOverlayEnabled() const { return _profilerOverlayEnabled; }
+
+SceneGraph &Scene::getSceneGraph() { return _sceneGraph; }
+
+const SceneGraph &Scene::getSceneGraph() const { return _sceneGraph; }
+
+void Scene::update() {
+    if (_fileWatcher) {
+        _reloadChangedFiles();
+    }
+    if (!_reloadingShaders.empty()) {
+        _finishShaderReloads();
+    }
+    if (_loadingModels > 0 || _reloadingTextures > 0) {
+        ProfileScope scope(_profiler, "model upload");
+        _uploadModels(_uploadBudget);
+    }
+    _updateTransforms();
+}
+
+const RenderStats &Scene::getRenderStats() const { return _stats; }
+
+const Bvh &Scene::getBvh() const { return _bvh; }
+
+AABB Scene::getBounds() {
+    _updateTransforms();
+    _updateBvh();
+    AABB bounds;
+    if (!_bvh.getNodes().empty() && _bvh.getItemCount() > 0) {
+        bounds.min = _bvh.getNodes()[0].boundsMin;
+        bounds.max = _bvh.getNodes()[0].boundsMax;
+    }
+    return bounds;
+}
+
+// Takes the parts of loading models in the order they became ready until the budget is spent
+void Scene::_uploadModels(size_t budget) {
+    while (budget > 0) {
+        if (!_uploadPart) {
+            _uploadPart = _modelLoader.poll();
+            if (!_uploadPart) {
+                return;
+            }
+        }
+        if (!_uploadModelPart(*_uploadPart, budget)) {
+            return;
+        }
+        _uploadPart.reset();
+    }
+}
+
+static size_t getImageBytes(const TextureImage &image) {
+    return static_cast<size_t>(image.width) * static_cast<size_t>(image.height) *
+           static_cast<size_t>(image.channels);
+}
+
+// Returns false while an object still has mesh data to send
+bool Scene::_uploadModelPart(ModelPart &part, size_t &budget) {
+    if (!part.load) {
+        _reloadTexture(part);
+        budget -= std::min(budget, getImageBytes(part.image));
+        return true;
+    }
+
+    ModelLoad &load = *part.load;
+    if (part.type == ModelPart::TEXTURE) {
+        int texture = _textureCache.add(part.name);
+        load._textures.push_back(texture);
+        if (!_textureCache.isLoaded(texture)) {
+            std::shared_ptr<Texture> loaded;
+            try {
+                if (part.image.pixels) {
+                    loaded = std::make_shared<Texture>(part.image);
+                }
+            } catch (const std::runtime_error &) {
+                // Texture reported it; the cache marks it as failed
+            }
+            _textureCache.set(texture, loaded);
+            budget -= std::min(budget, getImageBytes(part.image));
+        }
+        return true;
+    }
+
+    if (part.type == ModelPart::OBJECT) {
+        for (const auto &mesh : part.meshes) {
+            if (!mesh->upload(budget)) {
+                return false;
+            }
+        }
+        if (load._rootNodes.empty()) {
+            for (const auto &placement : load._placements) {
+                load._rootNodes.push_back(
+                    _sceneGraph.createNode(SceneGraph::NO_PARENT, placement, load.getPath()));
+            }
+        }
+        std::vector<int> materials;
+        for (const auto &mesh : part.meshes) {
+            Material material = mesh->getMaterial();
+            for (int map = 0; map < static_cast<int>(MAP_COUNT); ++map) {
+                if (material.maps[map] != NO_TEXTURE) {
+                    material.maps[map] = load._textures.at(static_cast<size_t>(material.maps[map]));
+                }
+            }
+            mesh->setMaterial(material, mesh->getMaterialName());
+            materials.push_back(static_cast<int>(addMaterial(material)));
+        }
+        _addModelObject(load, part, materials);
+        load._objectsAdded++;
+        return true;
+    }
+
+    _finishModel(part.load);
+    return true;
+}
+
+// A texture decoded again replaces the one in the cache; when decoding failed, the old one stays
+void Scene::_reloadTexture(ModelPart &part) {
+    _reloadingTextures--;
+    int texture = _textureCache.find(part.name);
+    if (texture == NO_TEXTURE || !part.image.pixels) {
+        return;
+    }
+    try {
+        _textureCache.set(texture, std::make_shared<Texture>(part.image));
+        LogMessage(LOG_INFO) << "Texture reloaded: " << part.name;
+    } catch (const std::runtime_error &) {
+        // Texture reported it
+    }
+}
+
+// A new object gets a node under each root. The object a reload finds with the same name keeps
+// its nodes, whose instances are pointed at the new meshes; instances left over when the object
+// now has fewer meshes are hidden, to be shown again by a later reload that needs them.
+void Scene::_addModelObject(ModelLoad &load, const ModelPart &part,
+                            const std::vector<int> &materials) {
+    ModelLoad::Object object;
+    object.name = part.name;
+    object.meshCount = part.meshes.size();
+
+    auto previous = std::find_if(
+        load._unclaimed.begin(), load._unclaimed.end(),
+        [&part](const ModelLoad::Object &candidate) { return candidate.name == part.name; });
+    if (previous == load._unclaimed.end()) {
+        for (unsigned int root : load._rootNodes) {
+            unsigned int node = _sceneGraph.createNode(root, glm::mat4(1.0f), part.name);
+            for (size_t i = 0; i < part.meshes.size(); ++i) {
+                addInstance(part.meshes[i], node, materials[i]);
+            }
+            object.nodes.push_back(node);
+        }
+        load._objects.push_back(object);
+        return;
+    }
+
+    object.nodes = previous->nodes;
+    size_t shown = previous->meshCount;
+    load._unclaimed.erase(previous);
+    for (unsigned int node : object.nodes) {
+        std::vector<unsigned int> instances = _nodeInstances[node];
+        for (size_t i = 0; i < std::max(instances.size(), part.meshes.size()); ++i) {
+            if (i >= instances.size()) {
+                addInstance(part.meshes[i], node, materials[i]);
+                continue;
+            }
+            Instance &instance = _instances[instances[i]];
+            if (i >= part.meshes.size()) {
+                instance.flags = 0;
+                continue;
+            }
+            _registerMesh(part.meshes[i]);
+            instance.mesh = part.meshes[i];
+            instance.material = materials[i];
+            if (i >= shown) {
+                instance.flags = INSTANCE_VISIBLE | INSTANCE_PICKABLE;
+            }
+            _markInstanceMoved(instances[i]);
+        }
+    }
+    load._objects.push_back(object);
+}
+
+// A model that failed to load is kept too, so that fixing its file loads it. A reload replaces
+// the model it reloads once all its objects are in, hiding the objects the file no longer has but
+// keeping their nodes in case they come back; when it fails, the previous model stays as it was.
+void Scene::_finishModel(const ModelHandle &load) {
+    _loadingModels--;
+    ModelHandle previous = load->_previous;
+    load->_previous.reset();
+
+    if (load->getState() == ModelLoad::FAILED && previous) {
+        LogMessage(LOG_ERROR) << "Failed to reload the model " << load->getPath()
+                              << ", keeping the previous one: " << load->getError();
+    } else if (load->getState() == ModelLoad::FAILED) {
+        LogMessage(LOG_ERROR) << "Failed to load the model " << load->getPath() << ": "
+                              << load->getError();
+        _models.push_back(load);
+    } else if (previous) {
+        load->_state = ModelLoad::DONE;
+        for (auto &object : load->_unclaimed) {
+            for (unsigned int node : object.nodes) {
+                for (unsigned int instance : _nodeInstances[node]) {
+                    _instances[instance].flags = 0;
+                }
+            }
+            object.meshCount = 0;
+            load->_objects.push_back(object);
+        }
+        load->_unclaimed.clear();
+        std::replace(_models.begin(), _models.end(), previous, load);
+        _releaseUnusedMeshes();
+        LogMessage(LOG_INFO) << "Model reloaded: " << load->getPath();
+    } else {
+        load->_state = ModelLoad::DONE;
+        _models.push_back(load);
+        LogMessage(LOG_INFO) << "Model loaded successfully: " << load->getPath();
+    }
+    if (_fileWatcher) {
+        _watchFiles();
+    }
+
+    if (previous) {
+        previous->_reloading = false;
+        if (previous->_reloadPending) {
+            previous->_reloadPending = false;
+            _reloadModel(load->getState() == ModelLoad::DONE ? load : previous);
+        }
+    }
+}
+
+std::vector<std::shared_ptr<Shader>> Scene::_getAllShaders() const {
+    std::vector<std::shared_ptr<Shader>> shaders = _shaders;
+    if (_oitCompositeShader) {
+        shaders.push_back(_oitCompositeShader);
+    }
+    if (_materialShaders) {
+        const std::vector<std::shared_ptr<Shader>> &variants = _materialShaders->getPrograms();
+        shaders.insert(shaders.end(), variants.begin(), variants.end());
+    }
+    return shaders;
+}
+
+void Scene::_watchFiles() {
+    for (const auto &shader : _getAllShaders()) {
+        for (const auto &file : shader->getFiles()) {
+            _fileWatcher->watch(file);
+        }
+    }
+    if (_materialShaders) {
+        for (const auto &file : _materialShaders->getFiles()) {
+            _fileWatcher->watch(file);
+        }
+    }
+    for (const auto &model : _models) {
+        for (const auto &file : model->getFiles()) {
+            _fileWatcher->watch(file);
+        }
+    }
+    for (size_t i = 0; i < _textureCache.getCount(); ++i) {
+        _fileWatcher->watch(_textureCache.getPath(static_cast<int>(i)));
+    }
+}
+
+// Shaders are recompiled by the driver, on its own threads when it can, and swapped in by
+// _finishShaderReloads() once linked; models and textures load again on the loader threads, so
+// the frame never waits on a file. A texture not loaded yet needs nothing, its first bind reading
+// the new file.
+void Scene::_reloadChangedFiles() {
+    std::vector<std::shared_ptr<Shader>> shaders = _getAllShaders();
+    for (const auto &path : _fileWatcher->poll()) {
+        for (const auto &shader : shaders) {
+            std::vector<std::string> files = shader->getFiles();
+            if (std::find(files.begin(), files.end(), path) == files.end()) {
+                continue;
+            }
+            if (shader->reload()) {
+                _reloadingShaders.push_back(std::make_pair(shader, path));
+            } else {
+                LogMessage(LOG_ERROR) << "Failed to reload the shader " << path
+                                      << ", keeping the previous program";
+            }
+        }
+        if (_materialShaders) {
+            std::vector<std::string> files = _materialShaders->getFiles();
+            if (std::find(files.begin(), files.end(), path) != files.end()) {
+                _forgetFailedVariants();
+            }
+        }
+        for (const auto &model : _models) {
+            const std::vector<std::string> &files = model->getFiles();
+            if (std::find(files.begin(), files.end(), path) != files.end()) {
+                _reloadModel(model);
+            }
+        }
+        int texture = _textureCache.find(path);
+        if (texture != NO_TEXTURE && _textureCache.isLoaded(texture)) {
+            _reloadingTextures++;
+            _modelLoader.requestTexture(path);
+        }
+    }
+}
+
+// Variants that failed to build are tried again when next drawn, the edit may have fixed them
+void Scene::_forgetFailedVariants() {
+    _materialShaders->forgetFailures();
+    for (auto variant = _shaderVariants.begin(); variant != _shaderVariants.end();) {
+        variant = variant->second.shader ? std::next(variant) : _shaderVariants.erase(variant);
+    }
+}
+
+// A shader still linking keeps drawing with its previous program. One whose reload was started
+// over again is left for the entry of the newer reload.
+void Scene::_finishShaderReloads() {
+    for (size_t i = 0; i < _reloadingShaders.size();) {
+        Shader &shader = *_reloadingShaders[i].first;
+        if (shader.isReloading() && !shader.isReloadDone()) {
+            ++i;
+            continue;
+        }
+        if (shader.isReloading()) {
+            if (shader.finishReload()) {
+                LogMessage(LOG_INFO) << "Shader reloaded: " << _reloadingShaders[i].second;
+            } else {
+                LogMessage(LOG_ERROR) << "Failed to reload the shader "
+                                      << _reloadingShaders[i].second
+                                      << ", keeping the previous program";
+            }
+        }
+        _reloadingShaders.erase(_reloadingShaders.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+}
+
+// The reload takes over the model's roots, so its objects land where the model's were
+void Scene::_reloadModel(const ModelHandle &model) {
+    if (model->_reloading) {
+        model->_reloadPending = true;
+        return;
+    }
+    ModelHandle reload = std::make_shared<ModelLoad>(model->getPath(), model->_placements);
+    reload->_previous = model;
+    reload->_rootNodes = model->_rootNodes;
+    reload->_unclaimed = model->_objects;
+    for (size_t i = 0; i < _textureCache.getCount(); ++i) {
+        if (_textureCache.isLoaded(static_cast<int>(i))) {
+            reload->_loadedTextures.insert(_textureCache.getPath(static_cast<int>(i)));
+        }
+    }
+    model->_reloading = true;
+    _loadingModels++;
+    _modelLoader.request(reload);
+    LogMessage(LOG_INFO) << "Reloading the model " << model->getPath();
+}
+
+void Scene::_updateTransforms() {
+    _changedNodes.clear();
+    _sceneGraph.update(_changedNodes);
+    for (unsigned int node : _changedNodes) {
+        if (node >= _nodeInstances.size()) {
+            continue;
+        }
+        for (unsigned int instance : _nodeInstances[node]) {
+            _instances[instance].transform = _sceneGraph.getWorldTransform(node);
+            _markInstanceMoved(instance);
+        }
+    }
+}
+
+void Scene::_markInstanceMoved(size_t instance) {
+    if (!_bvhDirty && !_instanceMoved[instance]) {
+        _instanceMoved[instance] = 1;
+        _changedInstances.push_back(static_cast<unsigned int>(instance));
+    }
+}
+
+void Scene::_updateBvh() {
+    if (_bvhDirty) {
+        _instanceBounds.resize(_instances.size());
+        parallelFor(_instances.size(), PARALLEL_MIN_INSTANCES, [this](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                _instanceBounds[i] =
+                    transformAABB(_instances[i].mesh->getBounds(), _instances[i].transform);
+            }
+        });
+        _bvh.build(_instanceBounds);
+        _instanceMoved.assign(_instances.size(), 0);
+        _changedInstances.clear();
+        _bvhDirty = false;
+        return;
+    }
+
+    parallelFor(_changedInstances.size(), PARALLEL_MIN_INSTANCES,
+                [this](size_t begin, size_t end) {
+                    for (size_t j = begin; j < end; ++j) {
+                        unsigned int    i = _changedInstances[j];
+                        const Instance &instance = _instances[i];
+                        _instanceBounds[i] =
+                            transformAABB(instance.mesh->getBounds(), instance.transform);
+                        _instanceMoved[i] = 0;
+                    }
+                });
+    _bvh.refit(_instanceBounds, _changedInstances);
+    _changedInstances.clear();
+}
+
 void Scene::render() {
+    _stats = RenderStats();
+
     // Clear screen
-    glClearColor(0.0f, 0.0f, 0.4f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
+    {
+        ProfileScope scope(_profiler, "clear");
+        glBindFramebuffer(GL_FRAMEBUFFER, _targetFramebuffer);
+        glClearColor(0.0f, 0.0f, 0.4f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+    }
 
     // Get the active camera's view and projection matrices
     auto camera = getActiveCamera();
-    if (!camera) {
+    if (camera) {
+        // Keep only the instances whose world bounds touch the view frustum, then batch them by
+        // mesh, material and LOD and render each batch with one instanced draw, transparent last
+        {
+            ProfileScope scope(_profiler, "culling");
+            _updateTransforms();
+            _updateBvh();
+            _visibleInstances.clear();
+            _bvh.queryFrustum(
+                extractFrustum(camera->getProjectionMatrix() * camera->getViewMatrix()),
+                _visibleInstances);
+            _stats.instancesCulled = _instances.size() - _visibleInstances.size();
+            _buildDrawItems(*camera);
+            _uploadInstances();
+        }
+        _renderMeshes();
+    }
+
+    if (_profilerOverlayEnabled) {
+        try {
+            if (!_profilerOverlay) {
+                _profilerOverlay.reset(new ProfilerOverlay());
+            }
+            _profilerOverlay->draw(_profiler);
+        } catch (const std::runtime_error &e) {
+            LogMessage(LOG_WARNING) << "Profiler overlay disabled: " << e.what();
+            _profilerOverlayEnabled = false;
+        }
+    }
+}
+
+bool Scene::raycast(const glm::vec3 &origin, const glm::vec3 &direction, RaycastHit &hit,
+                    float maxDistance) {
+    _updateTransforms();
+    _updateBvh();
+
+    bool found = false;
+    _bvh.raycast(origin, direction, maxDistance, [&](unsigned int item, float closest) {
+        const Instance &instance = _instances[item];
+        if (!(instance.flags & INSTANCE_PICKABLE)) {
+            return closest;
+        }
+
+        // The direction is transformed without normalizing, so distances stay in world units of
+        // the original ray and compare directly across meshes
+        glm::mat4        inverseModel = glm::inverse(instance.transform);
+        glm::vec3        localOrigin = glm::vec3(inverseModel * glm::vec4(origin, 1.0f));
+        glm::vec3        localDirection = glm::vec3(inverseModel * glm::vec4(direction, 0.0f));
+        TriangleBvh::Hit meshHit;
+        if (!instance.mesh->raycast(localOrigin, localDirection, closest, meshHit)) {
+            return closest;
+        }
+        found = true;
+        hit.mesh = instance.mesh;
+        hit.instance = item;
+        hit.triangle = meshHit.triangle;
+        hit.barycentrics = meshHit.barycentrics;
+        hit.distance = meshHit.distance;
+        hit.position = origin + direction * meshHit.distance;
+        return meshHit.distance;
+    });
+    return found;
+}
+
+// Picks the coarsest level whose geometric error, projected at the distance of the mesh's bounding
+// sphere, stays under _lodPixelThreshold pixels on screen
+size_t Scene::_selectLod(const Mesh &mesh, const glm::mat4 &transform,
+                         const Camera &camera) const {
+    if (!_lodEnabled || mesh.getLodCount() == 1) {
+        return 0;
+    }
+
+    const BoundingSphere &sphere = mesh.getBoundingSphere();
+    float                 scale = maxScale(transform);
+    glm::vec3             center = glm::vec3(transform * glm::vec4(sphere.center, 1.0f));
+    float distance = glm::length(center - camera.getPosition()) - sphere.radius * scale;
+    distance = std::max(distance, camera.getNearPlane());
+
+    float pixelsPerUnit =
+        static_cast<float>(_viewportHeight) /
+        (2.0f * tanf(glm::radians(camera.getFieldOfView()) * 0.5f) * distance);
+
+    size_t lod = 0;
+    for (size_t i = 1; i < mesh.getLodCount(); ++i) {
+        if (mesh.getLodError(i) * scale * pixelsPerUnit > _lodPixelThreshold) {
+            break;
+        }
+        lod = i;
+    }
+    return lod;
+}
+
+void Scene::_buildDrawItems(const Camera &camera) {
+    _drawItems.clear();
+    _transparentItems.clear();
+    for (unsigned int index : _visibleInstances) {
+        const Instance &instance = _instances[index];
+        if (!(instance.flags & INSTANCE_VISIBLE)) {
+            continue;
+        }
+        DrawItem item;
+        item.mesh = _meshIds[instance.mesh.get()];
+        item.material = instance.material;
+        item.lod =
+            static_cast<unsigned int>(_selectLod(*instance.mesh, instance.transform, camera));
+        item.instance = index;
+        const Material &material = item.material < 0
+                                       ? instance.mesh->getMaterial()
+                                       : _materials.at(static_cast<size_t>(item.material));
+        item.features = getMaterialFeatures(material, getMaterialMaps(material));
+        (_isTransparent(item) ? _transparentItems : _drawItems).push_back(item);
+    }
+    // Shader variant, then material, so that the program changes least and meshes sharing a
+    // scene material set its uniforms and textures once
+    auto batchOrder = [](const DrawItem &a, const DrawItem &b) {
+        if (a.features != b.features)
+            return a.features < b.features;
+        if (a.material != b.material)
+            return a.material < b.material;
+        if (a.mesh != b.mesh)
+            return a.mesh < b.mesh;
+        if (a.lod != b.lod)
+            return a.lod < b.lod;
+        return a.instance < b.instance;
+    };
+    std::sort(_drawItems.begin(), _drawItems.end(), batchOrder);
+    _opaqueItemCount = _drawItems.size();
+    _stats.transparentInstances = _transparentItems.size();
+
+    // Weighted blended OIT does not care about order, so its queue batches like the opaque one
+    if (_weightedOitEnabled) {
+        std::sort(_transparentItems.begin(), _transparentItems.end(), batchOrder);
+        _drawItems.insert(_drawItems.end(), _transparentItems.begin(), _transparentItems.end());
+        return;
+    }
+
+    // Back to front by the view depth of each bounding sphere center. Inverting the keys makes
+    // the ascending sort put the farthest first.
+    glm::vec3 position = camera.getPosition();
+    glm::vec3 front = camera.getFront();
+    _depthKeys.resize(_transparentItems.size());
+    _depthOrder.resize(_transparentItems.size());
+    for (size_t i = 0; i < _transparentItems.size(); ++i) {
+        const Instance  &instance = _instances[_transparentItems[i].instance];
+        const glm::vec3 &localCenter = instance.mesh->getBoundingSphere().center;
+        glm::vec3        center = glm::vec3(instance.transform * glm::vec4(localCenter, 1.0f));
+        _depthKeys[i] = ~floatToSortableKey(glm::dot(center - position, front));
+        _depthOrder[i] = static_cast<unsigned int>(i);
+    }
+    radixSort(_depthKeys, _depthOrder);
+    for (unsigned int i : _depthOrder) {
+        _drawItems.push_back(_transparentItems[i]);
+    }
+}
+
+bool Scene::_isTransparent(const DrawItem &item) const {
+    const Material &material = item.material < 0
+                                   ? _meshes[item.mesh]->getMaterial()
+                                   : _materials.at(static_cast<size_t>(item.material));
+    return isTransparent(material);
+}
+
+// Streams the model matrices of this frame's draw items, in draw order, into the instance buffer.
+// The buffer is orphaned first so the driver never waits on the previous frame's draws.
+void Scene::_uploadInstances() {
+    _instanceData.resize(_drawItems.size());
+    for (size_t i = 0; i < _drawItems.size(); ++i) {
+        _instanceData[i] = _instances[_drawItems[i].instance].transform;
+    }
+    if (_instanceData.empty()) {
         return;
     }
 
-    // Render all meshes with their associated shaders and textures
-    _renderMeshes();
+    if (_instanceData.size() > _instanceBufferCapacity) {
+        _instanceBufferCapacity = std::max(_instanceData.size(), _instanceBufferCapacity * 2);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER,
+                 static_cast<GLsizeiptr>(_instanceBufferCapacity * sizeof(glm::mat4)), nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+                    static_cast<GLsizeiptr>(_instanceData.size() * sizeof(glm::mat4)),
+                    _instanceData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void Scene::_renderMeshes() {
-    for (const auto &mesh : _meshes) {
-        if (_shaders.empty()) {
+    if (_shaders.empty() && !_materialShaders) {
+        return;
+    }
+    const Camera &camera = *getActiveCamera();
+    if (_materialBuffer == 0) {
+        glGenBuffers(1, &_materialBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, _materialBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Material), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, _materialBuffer);
+
+    {
+        ProfileScope scope(_profiler, "opaque");
+        _drawItemRange(0, _opaqueItemCount, camera, false);
+    }
+    if (_opaqueItemCount == _drawItems.size()) {
+        return;
+    }
+    ProfileScope scope(_profiler, "transparent");
+
+    // Transparent surfaces test against the opaque depth without writing their own
+    if (_weightedOitEnabled && _beginWeightedOit()) {
+        _drawItemRange(_opaqueItemCount, _drawItems.size(), camera, true);
+        _compositeWeightedOit();
+        return;
+    }
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    _drawItemRange(_opaqueItemCount, _drawItems.size(), camera, false);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
+
+// Consecutive items of the same mesh, material and LOD make one batch, so a back-to-front range
+// only merges neighbours and keeps its order. The program changes only when a material needs
+// another variant than the last one.
+void Scene::_drawItemRange(size_t begin, size_t end, const Camera &camera, bool weightedOit) {
+    glm::mat4     viewProjection = camera.getProjectionMatrix() * camera.getViewMatrix();
+    const MaterialShader *shader = nullptr; // in use, null if even the plain variant failed
+    size_t                batchEnd = begin;
+    int                   boundMaterial = -1; // scene material whose uniforms are set, -1 for none
+    for (size_t batchStart = begin; batchStart < end; batchStart = batchEnd) {
+        const DrawItem &item = _drawItems[batchStart];
+        batchEnd = batchStart + 1;
+        while (batchEnd < end && _drawItems[batchEnd].mesh == item.mesh &&
+               _drawItems[batchEnd].material == item.material &&
+               _drawItems[batchEnd].lod == item.lod) {
+            batchEnd++;
+        }
+        const Mesh  &mesh = *_meshes[item.mesh];
+        unsigned int instanceCount = static_cast<unsigned int>(batchEnd - batchStart);
+
+        // Select the material's variant from the maps that actually bound, then upload it
+        if (item.material < 0 || item.material != boundMaterial) {
+            const Material &material = item.material < 0
+                                           ? mesh.getMaterial()
+                                           : _materials.at(static_cast<size_t>(item.material));
+            unsigned int boundMaps = _bindMaterialMaps(material);
+            unsigned int features = getMaterialFeatures(material, boundMaps);
+            const MaterialShader *variant =
+                _getMaterialShader(weightedOit ? features | FEATURE_WEIGHTED_OIT : features);
+            if (variant && variant != shader) {
+                variant->shader->use();
+                _setFrameUniforms(*variant, camera);
+            }
+            shader = variant;
+            if (shader) {
+                _uploadMaterial(material);
+            }
+            boundMaterial = item.material;
+        }
+        if (!shader) {
             continue;
         }
 
-        auto shader = _shaders[0];
-        shader->use();
+        // Meshlet culling depends on each instance's transform, so those draw one by one
+        if (item.lod == 0 && _meshletCullingEnabled && !mesh.getMeshlets().empty()) {
+            for (size_t i = batchStart; i < batchEnd; ++i) {
+                mesh.drawMeshlets(_instanceData[i], viewProjection, camera.getPosition(),
+                                  static_cast<unsigned int>(i), _stats);
+            }
+        } else {
+            mesh.draw(item.lod, instanceCount, static_cast<unsigned int>(batchStart));
+            _stats.drawCalls += mesh.getDrawRanges(item.lod).size();
+            _stats.trianglesDrawn += mesh.getTriangleCount(item.lod) * instanceCount;
+        }
+        _stats.trianglesFullDetail += mesh.getTriangleCount(0) * instanceCount;
+    }
+}
 
-        // Set camera uniforms
-        shader->setMat4("view", getActiveCamera()->getViewMatrix());
-        shader->setMat4("projection", getActiveCamera()->getProjectionMatrix());
+// Variants are built the first time a material needs them, and watched like the other shaders.
+// Until the driver is done linking one, and for good if it fails to build, the pass's plain
+// variant, without maps or lighting options, stands in for it rather than stalling the frame or
+// dropping the material. A failure stays cached so the variant is not rebuilt every frame.
+const Scene::MaterialShader *Scene::_getMaterialShader(unsigned int features) {
+    unsigned int plain = features & FEATURE_WEIGHTED_OIT;
+    auto         variant = _shaderVariants.find(features);
+    if (variant != _shaderVariants.end()) {
+        if (variant->second.shader) {
+            return &variant->second;
+        }
+        return features != plain ? _getMaterialShader(plain) : nullptr;
+    }
+    if (!_materialShaders) {
+        if (_shaders.empty()) {
+            return nullptr;
+        }
+        return &_cacheMaterialShader(features, _shaders[0]);
+    }
+    std::vector<std::string> defines = getFeatureDefines(features);
+    if (features != plain && !_materialShaders->isReady(defines)) {
+        return _getMaterialShader(plain);
+    }
+    std::shared_ptr<Shader> shader = _materialShaders->get(defines);
+    if (shader && _fileWatcher) {
+        for (const auto &file : shader->getFiles()) {
+            _fileWatcher->watch(file);
+        }
+    }
+    const MaterialShader &cached = _cacheMaterialShader(features, shader);
+    if (shader) {
+        return &cached;
+    }
+    return features != plain ? _getMaterialShader(plain) : nullptr;
+}
 
-        // **Set the mesh's model matrix**
-        shader->setMat4("model", mesh->getModelMatrix());
+// Handles and the block binding stay valid across reloads, so they are set up once per variant
+const Scene::MaterialShader &Scene::_cacheMaterialShader(unsigned int                   features,
+                                                         const std::shared_ptr<Shader> &shader) {
+    MaterialShader &cached = _shaderVariants[features];
+    cached.shader = shader;
+    if (!shader) {
+        return cached;
+    }
+    shader->bindUniformBlock(MATERIAL_BLOCK, MATERIAL_BLOCK_BINDING);
+    GLint blockSize = shader->getUniformBlockSize(MATERIAL_BLOCK);
+    if (blockSize >= 0 && blockSize != static_cast<GLint>(sizeof(Material))) {
+        LogMessage(LOG_WARNING) << MATERIAL_BLOCK << " is " << blockSize << " bytes, Material "
+                                << sizeof(Material);
+    }
+    cached.view = shader->getUniformHandle("view");
+    cached.projection = shader->getUniformHandle("projection");
+    cached.viewPosition = shader->getUniformHandle("viewPosition");
+    cached.lightDirection = shader->getUniformHandle("lightDirection");
+    for (unsigned int map = 0; map < MAP_COUNT; ++map) {
+        cached.mapTextures[map] = shader->getUniformHandle(MAP_TEXTURES[map]);
+    }
+    return cached;
+}
 
-        // Set material uniforms
-        const Material &material = mesh->getMaterial();
-        shader->setVec3("material.ambient", material.ambient);
-        shader->setVec3("material.diffuse", material.diffuse);
-        shader->setVec3("material.specular", material.specular);
-        shader->setFloat("material.shininess", material.shininess);
+void Scene::_setFrameUniforms(const MaterialShader &shader, const Camera &camera) const {
+    const Shader &program = *shader.shader;
+    program.setMat4(shader.view, camera.getViewMatrix());
+    program.setMat4(shader.projection, camera.getProjectionMatrix());
+    program.setVec3(shader.viewPosition, camera.getPosition());
+    program.setVec3(shader.lightDirection, glm::normalize(LIGHT_DIRECTION));
+    for (unsigned int map = 0; map < MAP_COUNT; ++map) {
+        program.setInt(shader.mapTextures[map], static_cast<int>(map));
+    }
+}
 
-        // Bind textures
-        if (!material.diffuseMapPath.empty()) {
-            if (!material.diffuseTexture) {
-                material.diffuseTexture = std::make_shared<Texture>(material.diffuseMapPath);
-            }
-            material.diffuseTexture->bind(0);
-            shader->setInt("material.diffuseMap", 0);
+// The composite shader is loaded with the first targets; any failure turns the mode off
+bool Scene::_createOitTargets() {
+    if (_oitFramebuffer != 0 && _oitWidth == _viewportWidth && _oitHeight == _viewportHeight) {
+        return true;
+    }
+    if (!_oitCompositeShader) {
+        try {
+            auto shader = std::make_shared<Shader>();
+            shader->addShaderFromFile("shaders/fullscreen_vertex.glsl", GL_VERTEX_SHADER);
+            shader->addShaderFromFile("shaders/oit_composite_fragment.glsl", GL_FRAGMENT_SHADER);
+            shader->link();
+            _oitCompositeShader = shader;
+        } catch (const std::runtime_error &e) {
+            LogMessage(LOG_WARNING) << "Weighted blended OIT disabled: " << e.what();
+            return false;
         }
+        glGenVertexArrays(1, &_emptyVao);
+    }
+    _deleteOitTargets();
+    _oitWidth = _viewportWidth;
+    _oitHeight = _viewportHeight;
+
+    glGenTextures(1, &_oitAccumTexture);
+    glBindTexture(GL_TEXTURE_2D, _oitAccumTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, _oitWidth, _oitHeight, 0, GL_RGBA, GL_FLOAT,
+                 nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &_oitRevealageTexture);
+    glBindTexture(GL_TEXTURE_2D, _oitRevealageTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, _oitWidth, _oitHeight, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-        mesh->draw();
+    // Same format as the target framebuffer's depth, which is blitted into it every frame
+    glGenRenderbuffers(1, &_oitDepthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _oitDepthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, _oitWidth, _oitHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    static const GLenum DRAW_BUFFERS[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glGenFramebuffers(1, &_oitFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _oitFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _oitAccumTexture,
+                           0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                           _oitRevealageTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER,
+                              _oitDepthBuffer);
+    glDrawBuffers(2, DRAW_BUFFERS);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, _targetFramebuffer);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        LogMessage(LOG_WARNING) << "Weighted blended OIT disabled: incomplete framebuffer (0x"
+                                << std::hex << status << std::dec << ")";
+        _deleteOitTargets();
+        return false;
+    }
+    return true;
+}
+
+void Scene::_deleteOitTargets() {
+    if (_oitFramebuffer != 0)
+        glDeleteFramebuffers(1, &_oitFramebuffer);
+    if (_oitAccumTexture != 0)
+        glDeleteTextures(1, &_oitAccumTexture);
+    if (_oitRevealageTexture != 0)
+        glDeleteTextures(1, &_oitRevealageTexture);
+    if (_oitDepthBuffer != 0)
+        glDeleteRenderbuffers(1, &_oitDepthBuffer);
+    _oitFramebuffer = _oitAccumTexture = _oitRevealageTexture = _oitDepthBuffer = 0;
+}
+
+// Accumulation starts from the opaque depth, zero color and full revealage
+bool Scene::_beginWeightedOit() {
+    if (!_createOitTargets()) {
+        _weightedOitEnabled = false;
+        return false;
     }
+    static const GLfloat ZERO[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    static const GLfloat ONE[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _targetFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _oitFramebuffer);
+    glBlitFramebuffer(0, 0, _oitWidth, _oitHeight, 0, 0, _oitWidth, _oitHeight,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, _oitFramebuffer);
+    glClearBufferfv(GL_COLOR, 0, ZERO);
+    glClearBufferfv(GL_COLOR, 1, ONE);
+
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    glDepthMask(GL_FALSE);
+    return true;
+}
+
+// Resolves the accumulated average color over the opaque image, weighted by revealage
+void Scene::_compositeWeightedOit() {
+    glDepthMask(GL_TRUE);
+    glBindFramebuffer(GL_FRAMEBUFFER, _targetFramebuffer);
+    glDisable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    _oitCompositeShader->use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _oitAccumTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, _oitRevealageTexture);
+    _oitCompositeShader->setInt("accumTexture", 0);
+    _oitCompositeShader->setInt("revealageTexture", 1);
+    glBindVertexArray(_emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// Texture slot i is bound to unit i; a slot whose file failed to load is treated as absent
+unsigned int Scene::_bindMaterialMaps(const Material &material) const {
+    unsigned int bound = 0;
+    for (unsigned int map = 0; map < MAP_COUNT; ++map) {
+        if (_textureCache.bind(material.maps[static_cast<int>(map)], map)) {
+            bound |= 1u << map;
+        }
+    }
+    return bound;
+}
+
+// One write of the whole block per material change; the slots of unbound maps are never sampled
+void Scene::_uploadMaterial(const Material &material) const {
+    glBindBuffer(GL_UNIFORM_BUFFER, _materialBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Material), &material);
 }
@@ -0,0 +1,108 @@
+#include "../include/SceneGraph.h"
+#include <algorithm>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+const unsigned int SceneGraph::NO_PARENT;
+
+// result = a * b, one result column at a time as a weighted sum of the columns of a
+static void multiplyMatrices(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &result) {
+#if defined(__SSE__)
+    const float *left = &a[0][0];
+    const float *right = &b[0][0];
+    float       *out = &result[0][0];
+
+    __m128 column0 = _mm_loadu_ps(left);
+    __m128 column1 = _mm_loadu_ps(left + 4);
+    __m128 column2 = _mm_loadu_ps(left + 8);
+    __m128 column3 = _mm_loadu_ps(left + 12);
+    for (int column = 0; column < 4; ++column) {
+        const float *weights = right + column * 4;
+        __m128       sum = _mm_mul_ps(column0, _mm_set1_ps(weights[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(column1, _mm_set1_ps(weights[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(column2, _mm_set1_ps(weights[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(column3, _mm_set1_ps(weights[3])));
+        _mm_storeu_ps(out + column * 4, sum);
+    }
+#else
+    result = a * b;
+#endif
+}
+
+SceneGraph::SceneGraph() : _firstDirty(0) {}
+
+unsigned int SceneGraph::createNode(unsigned int parent, const glm::mat4 &localTransform,
+                                   const std::string &name) {
+    if (parent != NO_PARENT) {
+        _checkNode(parent);
+    }
+
+    unsigned int node = static_cast<unsigned int>(_parents.size());
+    _parents.push_back(parent);
+    _localTransforms.push_back(localTransform);
+    _worldTransforms.push_back(parent == NO_PARENT ? localTransform
+                                                   : _worldTransforms[parent] * localTransform);
+    _dirty.push_back(1);
+    _names.push_back(name);
+    _firstDirty = std::min(_firstDirty, static_cast<size_t>(node));
+    return node;
+}
+
+void SceneGraph::setLocalTransform(unsigned int node, const glm::mat4 &localTransform) {
+    _checkNode(node);
+    _localTransforms[node] = localTransform;
+    _dirty[node] = 1;
+    _firstDirty = std::min(_firstDirty, static_cast<size_t>(node));
+}
+
+const glm::mat4 &SceneGraph::getLocalTransform(unsigned int node) const {
+    _checkNode(node);
+    return _localTransforms[node];
+}
+
+const glm::mat4 &SceneGraph::getWorldTransform(unsigned int node) const {
+    _checkNode(node);
+    return _worldTransforms[node];
+}
+
+unsigned int SceneGraph::getParent(unsigned int node) const {
+    _checkNode(node);
+    return _parents[node];
+}
+
+const std::string &SceneGraph::getName(unsigned int node) const {
+    _checkNode(node);
+    return _names[node];
+}
+
+size_t SceneGraph::getNodeCount() const { return _parents.size(); }
+
+// A node is recomputed when it or its parent is dirty; marking it dirty in turn carries the change
+// down to its own children, which always come later in the arrays
+void SceneGraph::update(std::vector<unsigned int> &changedNodes) {
+    size_t count = _parents.size();
+    for (size_t i = _firstDirty; i < count; ++i) {
+        unsigned int parent = _parents[i];
+        if (!_dirty[i] && (parent == NO_PARENT || !_dirty[parent])) {
+            continue;
+        }
+        _dirty[i] = 1;
+        if (parent == NO_PARENT) {
+            _worldTransforms[i] = _localTransforms[i];
+        } else {
+            multiplyMatrices(_worldTransforms[parent], _localTransforms[i], _worldTransforms[i]);
+        }
+        changedNodes.push_back(static_cast<unsigned int>(i));
+    }
+    std::fill(_dirty.begin() + static_cast<std::ptrdiff_t>(std::min(_firstDirty, count)),
+              _dirty.end(), 0);
+    _firstDirty = count;
+}
+
+void SceneGraph::_checkNode(unsigned int node) const {
+    if (node >= _parents.size()) {
+        throw std::out_of_range("SceneGraph: no node " + std::to_string(node));
+    }
+}
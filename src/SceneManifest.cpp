@@ -0,0 +1,134 @@
+#include "../include/SceneManifest.h"
+#include <algorithm>
+#include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <sstream>
+
+static std::string getParentPath(const std::string &path) {
+    size_t pos = path.find_last_of("/\\");
+    if (pos == std::string::npos) {
+        return "";
+    }
+    return path.substr(0, pos + 1);
+}
+
+static std::string trim(const std::string &text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) {
+        return "";
+    }
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+// Translation, then yaw around Y, pitch around X and roll around Z, then scale
+static glm::mat4 makeTransform(const glm::vec3 &position, const glm::vec3 &angles,
+                               const glm::vec3 &scale) {
+    glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+    transform = glm::rotate(transform, glm::radians(angles.x), glm::vec3(0.0f, 1.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(angles.y), glm::vec3(1.0f, 0.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(angles.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    return glm::scale(transform, scale);
+}
+
+SceneManifest::SceneManifest(const std::string &path) {
+    std::ifstream file(path.c_str());
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open scene manifest: " + path);
+    }
+    std::string directory = getParentPath(path);
+    std::string line;
+    size_t      lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        try {
+            _parseLine(line, directory);
+        } catch (const std::runtime_error &e) {
+            std::ostringstream message;
+            message << path << ":" << lineNumber << ": " << e.what();
+            throw std::runtime_error(message.str());
+        }
+    }
+    if (_models.empty()) {
+        throw std::runtime_error("Scene manifest has no models: " + path);
+    }
+    for (auto &model : _models) {
+        if (model.placements.empty()) {
+            model.placements.push_back(glm::mat4(1.0f));
+        }
+    }
+}
+
+const std::vector<SceneManifest::Model> &SceneManifest::getModels() const { return _models; }
+
+const std::vector<CameraPose> &SceneManifest::getCameras() const { return _cameras; }
+
+void SceneManifest::_parseLine(const std::string &line, const std::string &directory) {
+    std::istringstream lineStream(line.substr(0, line.find('#')));
+    std::string        keyword;
+    if (!(lineStream >> keyword)) {
+        return;
+    }
+
+    if (keyword == "model") {
+        Model model;
+        std::getline(lineStream >> model.name, model.path);
+        model.path = trim(model.path);
+        if (model.name.empty() || model.path.empty()) {
+            throw std::runtime_error("expected: model <name> <path>");
+        }
+        for (const auto &other : _models) {
+            if (other.name == model.name) {
+                throw std::runtime_error("model '" + model.name + "' is already declared");
+            }
+        }
+        if (model.path[0] != '/') {
+            model.path = directory + model.path;
+        }
+        _models.push_back(model);
+    } else if (keyword == "instance") {
+        std::string name;
+        glm::vec3   position;
+        if (!(lineStream >> name >> position.x >> position.y >> position.z)) {
+            throw std::runtime_error("expected: instance <name> <x y z> [...]");
+        }
+        auto model =
+            std::find_if(_models.begin(), _models.end(),
+                         [&name](const Model &candidate) { return candidate.name == name; });
+        if (model == _models.end()) {
+            throw std::runtime_error("unknown model '" + name + "'");
+        }
+
+        // Angles and scale are optional, but each one is read whole or not at all
+        std::vector<float> values;
+        float              value;
+        while (lineStream >> value) {
+            values.push_back(value);
+        }
+        bool validCount = values.empty() || values.size() == 3 || values.size() == 4 ||
+                          values.size() == 6;
+        if (!lineStream.eof() || !validCount) {
+            throw std::runtime_error("expected: instance <name> <x y z> [<yaw pitch roll> "
+                                     "[<scale> | <sx sy sz>]]");
+        }
+        glm::vec3 angles(0.0f);
+        glm::vec3 scale(1.0f);
+        if (values.size() >= 3) {
+            angles = glm::vec3(values[0], values[1], values[2]);
+        }
+        if (values.size() == 4) {
+            scale = glm::vec3(values[3]);
+        } else if (values.size() == 6) {
+            scale = glm::vec3(values[3], values[4], values[5]);
+        }
+        model->placements.push_back(makeTransform(position, angles, scale));
+    } else if (keyword == "camera") {
+        CameraPose pose;
+        if (!(lineStream >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yaw >>
+              pose.pitch)) {
+            throw std::runtime_error("expected: camera <x y z> <yaw> <pitch>");
+        }
+        _cameras.push_back(pose);
+    } else {
+        throw std::runtime_error("unknown statement '" + keyword + "'");
+    }
+}
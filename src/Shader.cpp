@@ -1,11 +1,148 @@
 #include "../include/Shader.h"
+#include "../include/Logger.h"
 #include "../include/glad/glad.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
-#include <iostream>
+#include <iomanip>
 #include <sstream>
 #include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
 
-Shader::Shader() : ID(0) {
+std::string Shader::_binaryCacheDirectory;
+bool        Shader::_parallelCompile = false;
+
+// KHR_parallel_shader_compile, which the GLAD loader does not cover; the ARB version has the
+// same values
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void(APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// Start of a program binary file; the key guards against a stale or foreign file under the name
+struct ProgramBinaryHeader {
+    char     magic[8];
+    uint64_t key;
+    uint32_t format; // as glGetProgramBinary gave it
+    uint32_t size;   // bytes of binary after the header
+};
+
+static const char PROGRAM_BINARY_MAGIC[8] = {'S', 'C', 'O', 'P', 'P', 'R', 'G', '1'};
+
+static const int MAX_INCLUDE_DEPTH = 16;
+
+// 64-bit FNV-1a, chained over several pieces
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const char *text) {
+    // The terminator goes in too, so that pieces cannot shift into each other
+    return text ? hashBytes(hash, text, strlen(text) + 1) : hash;
+}
+
+static std::string getParentPath(const std::string &path) {
+    size_t pos = path.find_last_of("/\\");
+    if (pos == std::string::npos) {
+        return "";
+    }
+    return path.substr(0, pos + 1);
+}
+
+// Adds the identifiers of GLSL source, whole words outside comments, to the set
+static void addIdentifiers(const std::string               &source,
+                           std::unordered_set<std::string> &identifiers) {
+    size_t i = 0;
+    while (i < source.size()) {
+        if (source.compare(i, 2, "//") == 0) {
+            i = source.find('\n', i);
+            continue;
+        }
+        if (source.compare(i, 2, "/*") == 0) {
+            i = source.find("*/", i + 2);
+            i = i == std::string::npos ? i : i + 2;
+            continue;
+        }
+        if (!isalpha(static_cast<unsigned char>(source[i])) && source[i] != '_') {
+            ++i;
+            continue;
+        }
+        size_t start = i;
+        while (i < source.size() &&
+               (isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_')) {
+            ++i;
+        }
+        identifiers.insert(source.substr(start, i - start));
+    }
+}
+
+// Every sampler and image type, opaque types set with glUniform1i; the GL numbers them in runs
+static bool isSampler(GLenum type) {
+    static const GLenum SAMPLER_RANGES[][2] = {
+        {GL_SAMPLER_1D, GL_SAMPLER_2D_RECT_SHADOW},
+        {GL_SAMPLER_1D_ARRAY, GL_SAMPLER_CUBE_SHADOW},
+        {GL_INT_SAMPLER_1D, GL_UNSIGNED_INT_SAMPLER_BUFFER},
+        {GL_SAMPLER_CUBE_MAP_ARRAY, GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY},
+        {GL_IMAGE_1D, GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY},
+        {GL_SAMPLER_2D_MULTISAMPLE, GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY}};
+    for (const auto &range : SAMPLER_RANGES) {
+        if (type >= range[0] && type <= range[1]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// glUniform1i also sets booleans and samplers; everything else takes its own type
+static bool acceptsType(GLenum setterType, GLenum uniformType) {
+    if (setterType == uniformType) {
+        return true;
+    }
+    if (setterType == GL_INT || setterType == GL_BOOL) {
+        return uniformType == GL_INT || uniformType == GL_BOOL || isSampler(uniformType);
+    }
+    return false;
+}
+
+static std::string uniformTypeToString(GLenum type) {
+    switch (type) {
+    case GL_BOOL:
+        return "bool";
+    case GL_INT:
+        return "int";
+    case GL_FLOAT:
+        return "float";
+    case GL_FLOAT_VEC2:
+        return "vec2";
+    case GL_FLOAT_VEC3:
+        return "vec3";
+    case GL_FLOAT_VEC4:
+        return "vec4";
+    case GL_FLOAT_MAT2:
+        return "mat2";
+    case GL_FLOAT_MAT3:
+        return "mat3";
+    case GL_FLOAT_MAT4:
+        return "mat4";
+    default:
+        break;
+    }
+    if (isSampler(type)) {
+        return "sampler";
+    }
+    std::ostringstream name;
+    name << "GL type 0x" << std::hex << type;
+    return name.str();
+}
+
+Shader::Shader() : ID(0), _linking(false), _binaryKey(0) {
     // Create a program object
     ID = glCreateProgram();
     if (ID == 0) {
@@ -14,26 +151,60 @@ Shader::Shader() : ID(0) {
 }
 
 Shader::~Shader() {
-    // Delete the shader program
+    // Delete the shader program and the shaders of a program never linked
+    _deleteStages();
     if (ID != 0) {
         glDeleteProgram(ID);
     }
 }
 
-Shader::Shader(Shader &&other) noexcept : ID(other.ID), shaderIDs(std::move(other.shaderIDs)) {
+Shader::Shader(Shader &&other) noexcept
+    : ID(other.ID),
+      shaderIDs(std::move(other.shaderIDs)),
+      _files(std::move(other._files)),
+      _includes(std::move(other._includes)),
+      _stages(std::move(other._stages)),
+      _linking(other._linking),
+      _binaryPath(std::move(other._binaryPath)),
+      _binaryKey(other._binaryKey),
+      _reload(std::move(other._reload)),
+      _identifiers(std::move(other._identifiers)),
+      _activeUniforms(std::move(other._activeUniforms)),
+      _uniformBlocks(std::move(other._uniformBlocks)),
+      _storageBlocks(std::move(other._storageBlocks)),
+      _uniforms(std::move(other._uniforms)),
+      _uniformHandles(std::move(other._uniformHandles)),
+      _warnedBlocks(std::move(other._warnedBlocks)) {
     other.ID = 0;
+    other._linking = false;
 }
 
 Shader &Shader::operator=(Shader &&other) noexcept {
     if (this != &other) {
-        // Delete existing resources
+        // Delete existing resources, as the destructor does
+        _deleteStages();
         if (ID != 0) {
             glDeleteProgram(ID);
         }
         // Transfer ownership
         ID = other.ID;
         shaderIDs = std::move(other.shaderIDs);
+        _files = std::move(other._files);
+        _includes = std::move(other._includes);
+        _stages = std::move(other._stages);
+        _linking = other._linking;
+        _binaryPath = std::move(other._binaryPath);
+        _binaryKey = other._binaryKey;
+        _reload = std::move(other._reload);
+        _identifiers = std::move(other._identifiers);
+        _activeUniforms = std::move(other._activeUniforms);
+        _uniformBlocks = std::move(other._uniformBlocks);
+        _storageBlocks = std::move(other._storageBlocks);
+        _uniforms = std::move(other._uniforms);
+        _uniformHandles = std::move(other._uniformHandles);
+        _warnedBlocks = std::move(other._warnedBlocks);
         other.ID = 0;
+        other._linking = false;
     }
     return *this;
 }
@@ -58,13 +229,31 @@ static std::string shaderTypeToString(GLenum shaderType) {
     }
 }
 
-void Shader::addShaderFromFile(const std::string &filePath, GLenum shaderType) {
-    std::string shaderCode = _loadShaderSource(filePath);
+void Shader::addShaderFromFile(const std::string &filePath, GLenum shaderType,
+                               const std::vector<std::string> &defines) {
+    std::string shaderCode = _preprocess(_loadShaderSource(filePath), filePath, defines, 0);
     addShaderFromSource(shaderCode, shaderType);
+    SourceFile file = {filePath, shaderType, defines};
+    _files.push_back(file);
 }
 
 void Shader::addShaderFromSource(const std::string &sourceCode, GLenum shaderType) {
-    const char *code = sourceCode.c_str();
+    Stage stage = {sourceCode, shaderType};
+    _stages.push_back(stage);
+}
+
+uint64_t Shader::getSourceHash() const {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const auto &stage : _stages) {
+        hash = hashBytes(hash, &stage.type, sizeof(stage.type));
+        hash = hashString(hash, stage.source.c_str());
+    }
+    return hash;
+}
+
+void Shader::_compileStage(const Stage &stage) {
+    const char *code = stage.source.c_str();
+    GLenum      shaderType = stage.type;
 
     // Create shader object
     unsigned int shader = glCreateShader(shaderType);
@@ -72,10 +261,9 @@ void Shader::addShaderFromSource(const std::string &sourceCode, GLenum shaderTyp
         throw std::runtime_error("Failed to create shader");
     }
 
-    // Compile shader
+    // Compile shader; finishLink() checks the result, so the driver need not be waited on here
     glShaderSource(shader, 1, &code, nullptr);
     glCompileShader(shader);
-    _checkCompileErrors(shader, shaderTypeToString(shaderType));
 
     // Attach shader to the program
     glAttachShader(ID, shader);
@@ -84,66 +272,468 @@ void Shader::addShaderFromSource(const std::string &sourceCode, GLenum shaderTyp
     shaderIDs.push_back(shader);
 }
 
+void Shader::_deleteStages() {
+    for (unsigned int shader : shaderIDs) {
+        glDetachShader(ID, shader);
+        glDeleteShader(shader);
+    }
+    shaderIDs.clear();
+}
+
+void Shader::setBinaryCacheDirectory(const std::string &directory) {
+    _binaryCacheDirectory = directory;
+}
+
+const std::string &Shader::getBinaryCacheDirectory() { return _binaryCacheDirectory; }
+
+bool Shader::enableParallelCompile(void *(*getProcAddress)(const char *name)) {
+    GLint       count = 0;
+    const char *function = nullptr;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char *name =
+            reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (strcmp(name, "GL_KHR_parallel_shader_compile") == 0) {
+            function = "glMaxShaderCompilerThreadsKHR";
+        } else if (strcmp(name, "GL_ARB_parallel_shader_compile") == 0 && !function) {
+            function = "glMaxShaderCompilerThreadsARB";
+        }
+    }
+    if (!function) {
+        _parallelCompile = false;
+        return false;
+    }
+
+    // Without the call the driver picks its own thread count, which may be none
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads =
+        reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(getProcAddress(function));
+    if (maxShaderCompilerThreads) {
+        maxShaderCompilerThreads(0xFFFFFFFFu); // as many as the implementation allows
+    }
+    GLint threads = 0;
+    glGetIntegerv(GL_MAX_SHADER_COMPILER_THREADS_KHR, &threads);
+    LogMessage(LOG_VERBOSE) << "Parallel shader compiling through " << function << ", "
+                            << static_cast<GLuint>(threads) << " thread(s)";
+    _parallelCompile = true;
+    return true;
+}
+
 void Shader::link() {
+    beginLink();
+    finishLink();
+}
+
+// A cached binary the driver takes replaces compiling and linking; otherwise the program is built
+// from source and its binary saved for the next time
+void Shader::beginLink() {
+    _binaryPath.clear();
+    _collectIdentifiers();
+    GLint binaryFormats = 0;
+    if (!_binaryCacheDirectory.empty()) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    }
+    if (binaryFormats > 0) {
+        _binaryKey = _getBinaryKey();
+        std::ostringstream path;
+        path << _binaryCacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0')
+             << _binaryKey << ".bin";
+        if (_loadBinary(path.str(), _binaryKey)) {
+            _stages.clear();
+            _reflect();
+            return;
+        }
+        _binaryPath = path.str();
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    for (const auto &stage : _stages) {
+        _compileStage(stage);
+    }
+    _stages.clear();
+
     // Link the shader program
     glLinkProgram(ID);
-    _checkCompileErrors(ID, "PROGRAM");
+    _linking = true;
+}
+
+void Shader::finishLink() {
+    if (!_linking) {
+        return;
+    }
+    _linking = false;
+    try {
+        for (unsigned int shader : shaderIDs) {
+            GLint type = 0;
+            glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+            _checkCompileErrors(shader, shaderTypeToString(static_cast<GLenum>(type)));
+        }
+        _checkCompileErrors(ID, "PROGRAM");
+    } catch (const std::runtime_error &) {
+        _deleteStages();
+        throw;
+    }
 
     // Delete the shader objects after linking
-    for (unsigned int shader : shaderIDs) {
-        glDeleteShader(shader);
+    _deleteStages();
+    _reflect();
+
+    if (!_binaryPath.empty()) {
+        _saveBinary(_binaryPath, _binaryKey);
     }
-    shaderIDs.clear();
+}
+
+bool Shader::isLinking() const { return _linking; }
+
+bool Shader::isLinkDone() const {
+    if (!_linking || !_parallelCompile) {
+        return true;
+    }
+    GLint done = GL_FALSE;
+    glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+bool Shader::reload() {
+    if (_files.empty()) {
+        return false;
+    }
+    if (_linking) {
+        try {
+            finishLink();
+        } catch (const std::runtime_error &) {
+            // Logged, and about to be replaced anyway
+        }
+    }
+    _reload.reset();
+    try {
+        std::unique_ptr<Shader> fresh(new Shader());
+        for (const auto &file : _files) {
+            fresh->addShaderFromFile(file.path, file.type, file.defines);
+        }
+        fresh->beginLink();
+        _reload = std::move(fresh);
+    } catch (const std::runtime_error &) {
+        // The error was logged where it happened
+        return false;
+    }
+    return true;
+}
+
+bool Shader::isReloading() const { return _reload != nullptr; }
+
+bool Shader::isReloadDone() const { return !_reload || _reload->isLinkDone(); }
+
+bool Shader::finishReload() {
+    if (!_reload) {
+        return false;
+    }
+    std::unique_ptr<Shader> fresh = std::move(_reload);
+    try {
+        fresh->finishLink();
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+    std::swap(ID, fresh->ID);
+    std::swap(_includes, fresh->_includes);
+    std::swap(_identifiers, fresh->_identifiers);
+    _reflect();
+    return true;
+}
+
+std::vector<std::string> Shader::getFiles() const {
+    std::vector<std::string> paths;
+    for (const auto &file : _files) {
+        paths.push_back(file.path);
+    }
+    for (const auto &include : _includes) {
+        if (std::find(paths.begin(), paths.end(), include) == paths.end()) {
+            paths.push_back(include);
+        }
+    }
+    return paths;
 }
 
 void Shader::use() const { glUseProgram(ID); }
 
+int Shader::getUniformHandle(const std::string &name) const {
+    auto handle = _uniformHandles.find(name);
+    if (handle != _uniformHandles.end()) {
+        return handle->second;
+    }
+    Uniform uniform = {name, -1, 0, false, false};
+    _refreshUniform(uniform);
+    _uniforms.push_back(uniform);
+    _uniformHandles[name] = static_cast<int>(_uniforms.size() - 1);
+    return static_cast<int>(_uniforms.size() - 1);
+}
+
+void Shader::setBool(int uniform, bool value) const {
+    GLint location = _locate(uniform, GL_BOOL);
+    if (location >= 0) {
+        glUniform1i(location, static_cast<int>(value));
+    }
+}
+
+void Shader::setInt(int uniform, int value) const {
+    GLint location = _locate(uniform, GL_INT);
+    if (location >= 0) {
+        glUniform1i(location, value);
+    }
+}
+
+void Shader::setFloat(int uniform, float value) const {
+    GLint location = _locate(uniform, GL_FLOAT);
+    if (location >= 0) {
+        glUniform1f(location, value);
+    }
+}
+
+void Shader::setVec2(int uniform, const glm::vec2 &value) const {
+    GLint location = _locate(uniform, GL_FLOAT_VEC2);
+    if (location >= 0) {
+        glUniform2fv(location, 1, &value[0]);
+    }
+}
+
+void Shader::setVec3(int uniform, const glm::vec3 &value) const {
+    GLint location = _locate(uniform, GL_FLOAT_VEC3);
+    if (location >= 0) {
+        glUniform3fv(location, 1, &value[0]);
+    }
+}
+
+void Shader::setVec4(int uniform, const glm::vec4 &value) const {
+    GLint location = _locate(uniform, GL_FLOAT_VEC4);
+    if (location >= 0) {
+        glUniform4fv(location, 1, &value[0]);
+    }
+}
+
+void Shader::setMat2(int uniform, const glm::mat2 &mat) const {
+    GLint location = _locate(uniform, GL_FLOAT_MAT2);
+    if (location >= 0) {
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+}
+
+void Shader::setMat3(int uniform, const glm::mat3 &mat) const {
+    GLint location = _locate(uniform, GL_FLOAT_MAT3);
+    if (location >= 0) {
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+}
+
+void Shader::setMat4(int uniform, const glm::mat4 &mat) const {
+    GLint location = _locate(uniform, GL_FLOAT_MAT4);
+    if (location >= 0) {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+}
+
 void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), static_cast<int>(value));
+    setBool(getUniformHandle(name), value);
 }
 
 void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    setInt(getUniformHandle(name), value);
 }
 
 void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    setFloat(getUniformHandle(name), value);
 }
 
 void Shader::setVec2(const std::string &name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    setVec2(getUniformHandle(name), value);
 }
 
 void Shader::setVec2(const std::string &name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    setVec2(getUniformHandle(name), glm::vec2(x, y));
 }
 
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    setVec3(getUniformHandle(name), value);
 }
 
 void Shader::setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    setVec3(getUniformHandle(name), glm::vec3(x, y, z));
 }
 
 void Shader::setVec4(const std::string &name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    setVec4(getUniformHandle(name), value);
 }
 
 void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    setVec4(getUniformHandle(name), glm::vec4(x, y, z, w));
 }
 
 void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    setMat2(getUniformHandle(name), mat);
 }
 
 void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    setMat3(getUniformHandle(name), mat);
 }
 
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    setMat4(getUniformHandle(name), mat);
+}
+
+void Shader::bindUniformBlock(const std::string &name, GLuint binding) {
+    _bindBlock(_uniformBlocks, name, binding, false);
+}
+
+void Shader::bindStorageBlock(const std::string &name, GLuint binding) {
+    _bindBlock(_storageBlocks, name, binding, true);
+}
+
+GLint Shader::getUniformBlockSize(const std::string &name) const {
+    auto block = _uniformBlocks.find(name);
+    return block == _uniformBlocks.end() ? -1 : block->second.size;
+}
+
+GLint Shader::getStorageBlockSize(const std::string &name) const {
+    auto block = _storageBlocks.find(name);
+    return block == _storageBlocks.end() ? -1 : block->second.size;
+}
+
+void Shader::_bindBlock(std::unordered_map<std::string, Block> &blocks, const std::string &name,
+                        GLuint binding, bool storage) {
+    auto block = blocks.find(name);
+    if (block == blocks.end()) {
+        if (!_isDeclared(name) && _warnedBlocks.insert(name).second) {
+            LogMessage(LOG_WARNING) << "Shader block '" << name << "' is not declared";
+        }
+        return;
+    }
+    block->second.binding = static_cast<GLint>(binding);
+    if (storage) {
+        glShaderStorageBlockBinding(ID, block->second.index, binding);
+    } else {
+        glUniformBlockBinding(ID, block->second.index, binding);
+    }
+}
+
+// Words of the stage sources, which tell a uniform optimized out from a misspelled one
+void Shader::_collectIdentifiers() {
+    _identifiers.clear();
+    for (const auto &stage : _stages) {
+        addIdentifiers(stage.source, _identifiers);
+    }
+}
+
+// Reads what the linked program uses, then points the handles given out and the block bindings
+// made so far at it
+void Shader::_reflect() {
+    _activeUniforms.clear();
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(static_cast<size_t>(std::max(maxLength, 1)));
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei       length = 0;
+        ActiveUniform uniform = {-1, 0, 0};
+        glGetActiveUniform(ID, static_cast<GLuint>(i), maxLength, &length, &uniform.size,
+                           &uniform.type, name.data());
+        std::string uniformName(name.data(), static_cast<size_t>(length));
+        uniform.location = glGetUniformLocation(ID, uniformName.c_str());
+        if (uniform.location < 0) {
+            continue; // a block member, set through the block's buffer
+        }
+        _activeUniforms[uniformName] = uniform;
+
+        // An array also answers to its bare name, as with glGetUniformLocation
+        if (length > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+            _activeUniforms[uniformName.substr(0, uniformName.size() - 3)] = uniform;
+        }
+    }
+    for (auto &uniform : _uniforms) {
+        _refreshUniform(uniform);
+    }
+    _readBlocks(GL_UNIFORM_BLOCK, _uniformBlocks);
+    _readBlocks(GL_SHADER_STORAGE_BLOCK, _storageBlocks);
+}
+
+// Blocks bound before keep their binding point
+void Shader::_readBlocks(GLenum programInterface, std::unordered_map<std::string, Block> &blocks) {
+    std::unordered_map<std::string, Block> previous;
+    previous.swap(blocks);
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramInterfaceiv(ID, programInterface, GL_ACTIVE_RESOURCES, &count);
+    glGetProgramInterfaceiv(ID, programInterface, GL_MAX_NAME_LENGTH, &maxLength);
+    std::vector<char> name(static_cast<size_t>(std::max(maxLength, 1)));
+    for (GLint i = 0; i < count; ++i) {
+        static const GLenum PROPERTY = GL_BUFFER_DATA_SIZE;
+        GLsizei             length = 0;
+        Block               block = {static_cast<GLuint>(i), 0, -1};
+        glGetProgramResourceName(ID, programInterface, block.index, maxLength, &length,
+                                 name.data());
+        glGetProgramResourceiv(ID, programInterface, block.index, 1, &PROPERTY, 1, nullptr,
+                               &block.size);
+        std::string blockName(name.data(), static_cast<size_t>(length));
+        auto        old = previous.find(blockName);
+        if (old != previous.end() && old->second.binding >= 0) {
+            block.binding = old->second.binding;
+            GLuint binding = static_cast<GLuint>(block.binding);
+            if (programInterface == GL_SHADER_STORAGE_BLOCK) {
+                glShaderStorageBlockBinding(ID, block.index, binding);
+            } else {
+                glUniformBlockBinding(ID, block.index, binding);
+            }
+        }
+        blocks[blockName] = block;
+    }
+}
+
+void Shader::_refreshUniform(Uniform &uniform) const {
+    auto active = _activeUniforms.find(uniform.name);
+    uniform.location = active == _activeUniforms.end() ? -1 : active->second.location;
+    uniform.type = active == _activeUniforms.end() ? 0 : active->second.type;
+    uniform.declared = active != _activeUniforms.end() || _isDeclared(uniform.name);
+    uniform.warned = false;
+}
+
+// Every part of a name such as "lights[2].color" appears in the sources
+bool Shader::_isDeclared(const std::string &name) const {
+    size_t start = 0;
+    while (start <= name.size()) {
+        size_t end = name.find('.', start);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        std::string part = name.substr(start, end - start);
+        part = part.substr(0, part.find('['));
+        if (part.empty() || !_identifiers.count(part)) {
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+// Location to upload to, or -1 to skip the upload
+GLint Shader::_locate(int uniform, GLenum type) const {
+    if (uniform < 0 || static_cast<size_t>(uniform) >= _uniforms.size()) {
+        return -1;
+    }
+    Uniform &entry = _uniforms[static_cast<size_t>(uniform)];
+    if (entry.location >= 0 && acceptsType(type, entry.type)) {
+        return entry.location;
+    }
+    if (entry.warned) {
+        return -1;
+    }
+    if (entry.location >= 0) {
+        LogMessage(LOG_WARNING) << "Shader uniform '" << entry.name << "' is a "
+                                << uniformTypeToString(entry.type) << ", not a "
+                                << uniformTypeToString(type);
+        entry.warned = true;
+    } else if (!entry.declared) {
+        LogMessage(LOG_WARNING) << "Shader uniform '" << entry.name << "' is not declared";
+        entry.warned = true;
+    }
+    return -1;
 }
 
 void Shader::_checkCompileErrors(unsigned int shader, const std::string &type) const {
@@ -154,23 +744,110 @@ void Shader::_checkCompileErrors(unsigned int shader, const std::string &type) c
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
         if (!success) {
             glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
-            std::cerr << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n"
-                      << infoLog << "\n -- --------------------------------------------------- -- "
-                      << std::endl;
+            LogMessage(LOG_ERROR)
+                << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n"
+                << infoLog << "\n -- --------------------------------------------------- -- ";
             throw std::runtime_error("Shader compilation error");
         }
     } else {
         glGetProgramiv(ID, GL_LINK_STATUS, &success);
         if (!success) {
             glGetProgramInfoLog(ID, sizeof(infoLog), nullptr, infoLog);
-            std::cerr << "ERROR::PROGRAM_LINKING_ERROR\n"
-                      << infoLog << "\n -- --------------------------------------------------- -- "
-                      << std::endl;
+            LogMessage(LOG_ERROR)
+                << "ERROR::PROGRAM_LINKING_ERROR\n"
+                << infoLog << "\n -- --------------------------------------------------- -- ";
             throw std::runtime_error("Shader program linking error");
         }
     }
 }
 
+// A binary only fits the driver that made it, so the key covers the driver along with the sources
+uint64_t Shader::_getBinaryKey() const {
+    uint64_t hash = 14695981039346656037ULL;
+    hash = hashString(hash, reinterpret_cast<const char *>(glGetString(GL_VENDOR)));
+    hash = hashString(hash, reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    hash = hashString(hash, reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+    uint64_t sourceHash = getSourceHash();
+    return hashBytes(hash, &sourceHash, sizeof(sourceHash));
+}
+
+bool Shader::_loadBinary(const std::string &path, uint64_t key) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    ProgramBinaryHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.key != key) {
+        return false;
+    }
+    // The binary fills the rest of the file; a size that disagrees means a truncated or corrupt
+    // entry, and is never allocated
+    std::streampos binaryStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff remaining = file.tellg() - binaryStart;
+    file.seekg(binaryStart);
+    if (header.size == 0 || remaining != static_cast<std::streamoff>(header.size)) {
+        LogMessage(LOG_VERBOSE) << "Shader binary size mismatch, compiling: " << path;
+        return false;
+    }
+    std::vector<char> binary(header.size);
+    if (!file.read(binary.data(), static_cast<std::streamsize>(binary.size()))) {
+        return false;
+    }
+
+    glProgramBinary(ID, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint success = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if (!success) {
+        LogMessage(LOG_VERBOSE) << "Shader binary rejected by the driver, compiling: " << path;
+        return false;
+    }
+    LogMessage(LOG_VERBOSE) << "Shader program loaded from " << path;
+    return true;
+}
+
+// Written under a name of its own first, then renamed, so that another process starting at the
+// same time never reads half a file
+void Shader::_saveBinary(const std::string &path, uint64_t key) const {
+    GLint length = 0;
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLsizei           written = 0;
+    GLenum            format = 0;
+    glGetProgramBinary(ID, length, &written, &format, binary.data());
+    if (written <= 0) {
+        return;
+    }
+
+    ProgramBinaryHeader header;
+    memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+    header.key = key;
+    header.format = format;
+    header.size = static_cast<uint32_t>(written);
+
+    mkdir(_binaryCacheDirectory.c_str(), 0755); // fails harmlessly when it exists
+    std::ostringstream temporary;
+    temporary << path << "." << getpid() << ".tmp";
+    {
+        std::ofstream file(temporary.str().c_str(), std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(binary.data(), written);
+        if (!file) {
+            LogMessage(LOG_WARNING) << "Cannot write the shader cache file " << path;
+            std::remove(temporary.str().c_str());
+            return;
+        }
+    }
+    if (std::rename(temporary.str().c_str(), path.c_str()) != 0) {
+        std::remove(temporary.str().c_str());
+    }
+}
+
 std::string Shader::_loadShaderSource(const std::string &filePath) const {
     std::ifstream shaderFile;
     shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -181,9 +858,73 @@ std::string Shader::_loadShaderSource(const std::string &filePath) const {
         shaderStream << shaderFile.rdbuf();
         shaderFile.close();
     } catch (std::ifstream::failure &e) {
-        std::cerr << "ERROR::SHADER::FILE_NOT_READ: " << filePath << "\n" << e.what() << std::endl;
+        LogMessage(LOG_ERROR) << "ERROR::SHADER::FILE_NOT_READ: " << filePath << "\n" << e.what();
         throw std::runtime_error("Failed to read shader file");
     }
 
     return shaderStream.str();
 }
+
+// Each #include "file" line is replaced by the file, between #line directives so that compile
+// errors keep pointing at the right line, before the defines are put in
+std::string Shader::_preprocess(const std::string &source, const std::string &filePath,
+                                const std::vector<std::string> &defines, int depth) {
+    if (depth > MAX_INCLUDE_DEPTH) {
+        LogMessage(LOG_ERROR) << "ERROR::SHADER::INCLUDE_TOO_DEEP: " << filePath;
+        throw std::runtime_error("Shader includes nested too deep");
+    }
+    std::istringstream lines(source);
+    std::ostringstream expanded;
+    std::string        line;
+    int                lineNumber = 0;
+    int                versionLine = 0;
+    size_t             definesOffset = 0;
+    while (std::getline(lines, line)) {
+        ++lineNumber;
+        std::istringstream words(line);
+        std::string        directive;
+        std::string        name;
+        words >> directive;
+        if (directive != "#include") {
+            expanded << line << "\n";
+            if (directive == "#version" && versionLine == 0) {
+                versionLine = lineNumber;
+                definesOffset = static_cast<size_t>(expanded.tellp());
+            }
+            continue;
+        }
+
+        words >> name;
+        if (name.size() < 3 || name[0] != '"' || name[name.size() - 1] != '"') {
+            LogMessage(LOG_ERROR) << "ERROR::SHADER::BAD_INCLUDE: " << filePath << ":"
+                                  << lineNumber << ": expected #include \"file\"";
+            throw std::runtime_error("Bad shader include");
+        }
+        std::string includePath = getParentPath(filePath) + name.substr(1, name.size() - 2);
+        if (std::find(_includes.begin(), _includes.end(), includePath) == _includes.end()) {
+            _includes.push_back(includePath);
+        }
+        std::string included = _loadShaderSource(includePath);
+        expanded << "#line 1\n"
+                 << _preprocess(included, includePath, defines, depth + 1) << "#line "
+                 << lineNumber + 1 << "\n";
+    }
+
+    std::string text = expanded.str();
+    if (depth > 0) {
+        return text;
+    }
+    std::unordered_set<std::string> identifiers;
+    addIdentifiers(text, identifiers);
+    std::ostringstream block;
+    for (const auto &define : defines) {
+        if (identifiers.count(define.substr(0, define.find(' '))) > 0) {
+            block << "#define " << define << "\n";
+        }
+    }
+    if (block.tellp() > 0) {
+        block << "#line " << versionLine + 1 << "\n";
+        text.insert(definesOffset, block.str());
+    }
+    return text;
+}
@@ -0,0 +1,119 @@
+#include "../include/ShaderPermutations.h"
+#include "../include/Logger.h"
+#include "../include/Shader.h"
+#include <algorithm>
+#include <iterator>
+
+void ShaderPermutations::addStage(const std::string &path, GLenum type) {
+    Stage stage = {path, type};
+    _stages.push_back(stage);
+}
+
+void ShaderPermutations::prepare(const std::vector<std::string> &defines) {
+    std::string key;
+    _begin(defines, key);
+}
+
+bool ShaderPermutations::isReady(const std::vector<std::string> &defines) {
+    std::string             key;
+    std::shared_ptr<Shader> program = _begin(defines, key);
+    return !program || !program->isLinking() || program->isLinkDone();
+}
+
+std::shared_ptr<Shader> ShaderPermutations::get(const std::vector<std::string> &defines) {
+    std::string             key;
+    std::shared_ptr<Shader> program = _begin(defines, key);
+    if (program && program->isLinking()) {
+        try {
+            program->finishLink();
+            LogMessage(LOG_VERBOSE) << "Shader variant built: [" << key << "]";
+        } catch (const std::runtime_error &e) {
+            LogMessage(LOG_ERROR) << "Shader variant [" << key << "] failed: " << e.what();
+            _forget(program);
+            return nullptr;
+        }
+    }
+    return program;
+}
+
+// The sources are read and hashed before anything compiles, so a variant equal to one already
+// started costs only the file reads
+std::shared_ptr<Shader> ShaderPermutations::_begin(const std::vector<std::string> &defines,
+                                                   std::string                    &key) {
+    std::vector<std::string> sorted = defines;
+    std::sort(sorted.begin(), sorted.end());
+    for (const auto &define : sorted) {
+        key += define + ";";
+    }
+    auto variant = _variants.find(key);
+    if (variant != _variants.end()) {
+        return variant->second;
+    }
+
+    std::shared_ptr<Shader> program;
+    try {
+        auto shader = std::make_shared<Shader>();
+        for (const auto &stage : _stages) {
+            shader->addShaderFromFile(stage.path, stage.type, sorted);
+        }
+        uint64_t hash = shader->getSourceHash();
+        auto     same = _programsBySource.find(hash);
+        if (same != _programsBySource.end()) {
+            program = same->second;
+        } else {
+            shader->beginLink();
+            program = shader;
+            _programsBySource[hash] = shader;
+            _programs.push_back(shader);
+        }
+    } catch (const std::runtime_error &e) {
+        LogMessage(LOG_ERROR) << "Shader variant [" << key << "] failed: " << e.what();
+    }
+    _variants[key] = program;
+    return program;
+}
+
+// Every variant sharing a program that failed fails with it
+void ShaderPermutations::_forget(const std::shared_ptr<Shader> &program) {
+    for (auto &variant : _variants) {
+        if (variant.second == program) {
+            variant.second = nullptr;
+        }
+    }
+    for (auto &source : _programsBySource) {
+        if (source.second == program) {
+            source.second = nullptr;
+        }
+    }
+    _programs.erase(std::remove(_programs.begin(), _programs.end(), program), _programs.end());
+}
+
+const std::vector<std::shared_ptr<Shader>> &ShaderPermutations::getPrograms() const {
+    return _programs;
+}
+
+size_t ShaderPermutations::getVariantCount() const { return _variants.size(); }
+
+std::vector<std::string> ShaderPermutations::getFiles() const {
+    std::vector<std::string> files;
+    for (const auto &stage : _stages) {
+        files.push_back(stage.path);
+    }
+    for (const auto &program : _programs) {
+        for (const auto &file : program->getFiles()) {
+            if (std::find(files.begin(), files.end(), file) == files.end()) {
+                files.push_back(file);
+            }
+        }
+    }
+    return files;
+}
+
+void ShaderPermutations::forgetFailures() {
+    for (auto variant = _variants.begin(); variant != _variants.end();) {
+        variant = variant->second ? std::next(variant) : _variants.erase(variant);
+    }
+    for (auto source = _programsBySource.begin(); source != _programsBySource.end();) {
+        source = source->second ? std::next(source) : _programsBySource.erase(source);
+    }
+}
@@ -1,56 +1,46 @@
 #include "../include/Texture.h"
+#include "../include/LoadStats.h"
+#include "../include/Logger.h"
 #include "../include/stb_image.h"
-#include <iostream>
 
 Texture::Texture(const std::string &path, GLenum textureType, bool flip)
-    : ID(0),
-      type(textureType) {
-    // Generate texture ID
-    glGenTextures(1, &ID);
-
-    // Load image data
-    int            width, height, nrChannels;
-    unsigned char *data = _loadImage(path, width, height, nrChannels, flip);
-    if (data) {
-        GLenum format;
-        if (nrChannels == 1)
-            format = GL_RED;
-        else if (nrChannels == 3)
-            format = GL_RGB;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
-        else {
-            std::cerr << "Unsupported number of channels: " << nrChannels << std::endl;
-            stbi_image_free(data);
-            throw std::runtime_error("Unsupported texture format");
-        }
+    : Texture(decode(path, flip), textureType) {}
 
-        // Bind texture
-        glBindTexture(type, ID);
+Texture::Texture(const TextureImage &image, GLenum textureType) : ID(0), type(textureType) {
+    GLenum format;
+    if (image.channels == 1)
+        format = GL_RED;
+    else if (image.channels == 3)
+        format = GL_RGB;
+    else if (image.channels == 4)
+        format = GL_RGBA;
+    else {
+        LogMessage(LOG_ERROR) << "Unsupported number of channels: " << image.channels;
+        throw std::runtime_error("Unsupported texture format");
+    }
 
-        // Upload image data to texture
-        glTexImage2D(type, 0, static_cast<GLint>(format), width, height, 0, format,
-                     GL_UNSIGNED_BYTE, data);
+    // Generate and bind texture
+    glGenTextures(1, &ID);
+    glBindTexture(type, ID);
 
-        // Generate mipmaps
+    // Upload image data to texture and generate mipmaps
+    {
+        LoadStageScope upload("gpu upload", static_cast<uint64_t>(image.width) *
+                                                static_cast<uint64_t>(image.height) *
+                                                static_cast<uint64_t>(image.channels));
+        glTexImage2D(type, 0, static_cast<GLint>(format), image.width, image.height, 0, format,
+                     GL_UNSIGNED_BYTE, image.pixels.get());
         glGenerateMipmap(type);
+    }
 
-        // Default texture parameters (can be changed using setParameter)
-        glTexParameteri(type, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(type, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // Unbind texture
-        glBindTexture(type, 0);
+    // Default texture parameters (can be changed using setParameter)
+    glTexParameteri(type, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(type, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        // Free image data
-        stbi_image_free(data);
-    } else {
-        std::cerr << "Failed to load texture: " << path << std::endl;
-        stbi_image_free(data);
-        throw std::runtime_error("Failed to load texture");
-    }
+    // Unbind texture
+    glBindTexture(type, 0);
 }
 
 Texture::~Texture() {
@@ -90,9 +80,18 @@ void Texture::setParameter(GLenum name, GLfloat *value) {
     glBindTexture(type, 0);
 }
 
-unsigned char *Texture::_loadImage(const std::string &path, int &width, int &height,
-                                   int &nrChannels, bool flip) {
-    stbi_set_flip_vertically_on_load(flip);
-    unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-    return data;
+// The flip flag is per thread, so loader threads can decode while the render thread does too
+TextureImage Texture::decode(const std::string &path, bool flip) {
+    LoadStageScope stage("texture decode");
+    TextureImage   image;
+    stbi_set_flip_vertically_on_load_thread(flip);
+    unsigned char *data = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+    if (!data) {
+        LogMessage(LOG_ERROR) << "Failed to load texture: " << path;
+        throw std::runtime_error("Failed to load texture");
+    }
+    image.pixels.reset(data, stbi_image_free);
+    stage.addBytes(static_cast<uint64_t>(image.width) * static_cast<uint64_t>(image.height) *
+                    static_cast<uint64_t>(image.channels));
+    return image;
 }
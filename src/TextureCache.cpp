@@ -0,0 +1,68 @@
+#include "../include/TextureCache.h"
+#include "../include/Texture.h"
+
+int TextureCache::add(const std::string &path) {
+    auto it = _indices.find(path);
+    if (it != _indices.end()) {
+        return it->second;
+    }
+    int texture = static_cast<int>(_paths.size());
+    _paths.push_back(path);
+    _textures.push_back(nullptr);
+    _failed.push_back(0);
+    _indices[path] = texture;
+    return texture;
+}
+
+int TextureCache::find(const std::string &path) const {
+    auto it = _indices.find(path);
+    return it == _indices.end() ? NO_TEXTURE : it->second;
+}
+
+bool TextureCache::bind(int texture, unsigned int unit) const {
+    size_t index = static_cast<size_t>(texture);
+    if (texture < 0 || index >= _paths.size() || !_load(index)) {
+        return false;
+    }
+    _textures[index]->bind(unit);
+    return true;
+}
+
+void TextureCache::loadAll() const {
+    for (size_t index = 0; index < _paths.size(); ++index) {
+        _load(index);
+    }
+}
+
+void TextureCache::set(int texture, const std::shared_ptr<Texture> &loaded) {
+    size_t index = static_cast<size_t>(texture);
+    _textures.at(index) = loaded;
+    _failed[index] = loaded ? 0 : 1;
+}
+
+bool TextureCache::isLoaded(int texture) const {
+    size_t index = static_cast<size_t>(texture);
+    return _textures.at(index) || _failed[index];
+}
+
+const std::string &TextureCache::getPath(int texture) const {
+    return _paths.at(static_cast<size_t>(texture));
+}
+
+size_t TextureCache::getCount() const { return _paths.size(); }
+
+bool TextureCache::_load(size_t index) const {
+    if (_failed[index]) {
+        return false;
+    }
+    if (!_textures[index]) {
+        try {
+            _textures[index] = std::make_shared<Texture>(_paths[index]);
+        } catch (const std::runtime_error &) {
+            // Texture already printed the path; do not retry every frame
+            _failed[index] = 1;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,331 @@
+#include "../include/TriangleBvh.h"
+#include "../include/Bvh.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <future>
+#include <numeric>
+#include <thread>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+static const unsigned int MAX_LEAF_TRIANGLES = 4;
+static const float        TRAVERSAL_COST = 1.0f; // cost of a box test relative to a triangle test
+static const unsigned int PARALLEL_MIN_TRIANGLES = 32768; // smaller subtrees build serially
+static const unsigned int EMPTY_CHILD = UINT_MAX;
+
+// Slab test of one ray against the four child boxes of a node. Returns a bit per child whose
+// box the ray enters before maxDistance, and writes the entry distances.
+static int intersectChildren(const float minX[4], const float minY[4], const float minZ[4],
+                             const float maxX[4], const float maxY[4], const float maxZ[4],
+                             const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                             float maxDistance, float entry[4]) {
+#if defined(__SSE__)
+    __m128 originX = _mm_set1_ps(origin.x);
+    __m128 originY = _mm_set1_ps(origin.y);
+    __m128 originZ = _mm_set1_ps(origin.z);
+    __m128 inverseX = _mm_set1_ps(inverseDirection.x);
+    __m128 inverseY = _mm_set1_ps(inverseDirection.y);
+    __m128 inverseZ = _mm_set1_ps(inverseDirection.z);
+
+    __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minX), originX), inverseX);
+    __m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxX), originX), inverseX);
+    __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minY), originY), inverseY);
+    __m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxY), originY), inverseY);
+    __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minZ), originZ), inverseZ);
+    __m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxZ), originZ), inverseZ);
+
+    __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)),
+                              _mm_max_ps(_mm_min_ps(t1z, t2z), _mm_setzero_ps()));
+    __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)),
+                             _mm_min_ps(_mm_max_ps(t1z, t2z), _mm_set1_ps(maxDistance)));
+    _mm_storeu_ps(entry, tNear);
+    return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+#else
+    int mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        float t1x = (minX[i] - origin.x) * inverseDirection.x;
+        float t2x = (maxX[i] - origin.x) * inverseDirection.x;
+        float t1y = (minY[i] - origin.y) * inverseDirection.y;
+        float t2y = (maxY[i] - origin.y) * inverseDirection.y;
+        float t1z = (minZ[i] - origin.z) * inverseDirection.z;
+        float t2z = (maxZ[i] - origin.z) * inverseDirection.z;
+        float tNear = std::max(std::max(std::min(t1x, t2x), std::min(t1y, t2y)),
+                               std::max(std::min(t1z, t2z), 0.0f));
+        float tFar = std::min(std::min(std::max(t1x, t2x), std::max(t1y, t2y)),
+                              std::min(std::max(t1z, t2z), maxDistance));
+        entry[i] = tNear;
+        if (tNear <= tFar) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+TriangleBvh::TriangleBvh(const std::vector<Vertex>       &vertices,
+                         const std::vector<unsigned int> &indices)
+    : _buildNodeCount(0) {
+    unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+    if (triangleCount == 0) {
+        return;
+    }
+
+    _triangleIds.resize(triangleCount);
+    std::iota(_triangleIds.begin(), _triangleIds.end(), 0u);
+    _slotBounds.resize(triangleCount);
+    _centroids.resize(triangleCount);
+    AABB rootBounds;
+    for (unsigned int i = 0; i < triangleCount; ++i) {
+        for (unsigned int c = 0; c < 3; ++c) {
+            _slotBounds[i].grow(vertices[indices[i * 3 + c]].position);
+        }
+        _centroids[i] = _slotBounds[i].center();
+        rootBounds.grow(_slotBounds[i]);
+    }
+
+    // A binary tree over T triangles never needs more than 2T - 1 nodes, so the array is sized
+    // once and worker threads only reserve slots from the atomic counter
+    _buildNodes.resize(triangleCount * 2 - 1);
+    _buildNodes[0].bounds = rootBounds;
+    _buildNodes[0].leftFirst = 0;
+    _buildNodes[0].count = triangleCount;
+    _buildNodeCount = 1;
+
+    unsigned int parallelDepth = 0;
+    for (unsigned int threads = std::thread::hardware_concurrency(); threads > 1; threads /= 2) {
+        parallelDepth++;
+    }
+    _buildRecursive(0, parallelDepth);
+    _buildNodes.resize(_buildNodeCount);
+
+    _triangles.resize(triangleCount);
+    for (unsigned int i = 0; i < triangleCount; ++i) {
+        const glm::vec3 &p0 = vertices[indices[_triangleIds[i] * 3]].position;
+        _triangles[i].v0 = p0;
+        _triangles[i].edge1 = vertices[indices[_triangleIds[i] * 3 + 1]].position - p0;
+        _triangles[i].edge2 = vertices[indices[_triangleIds[i] * 3 + 2]].position - p0;
+    }
+
+    _collapse();
+
+    std::vector<BuildNode>().swap(_buildNodes);
+    std::vector<AABB>().swap(_slotBounds);
+    std::vector<glm::vec3>().swap(_centroids);
+}
+
+bool TriangleBvh::intersect(const glm::vec3 &origin, const glm::vec3 &direction,
+                            float maxDistance, Hit &hit) const {
+    if (_nodes.empty()) {
+        return false;
+    }
+
+    struct StackEntry {
+        unsigned int node;
+        float        entry;
+    };
+
+    glm::vec3               inverseDirection = 1.0f / direction;
+    float                   closest = maxDistance;
+    bool                    found = false;
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back({0, 0.0f});
+
+    while (!stack.empty()) {
+        StackEntry current = stack.back();
+        stack.pop_back();
+        if (current.entry > closest) {
+            continue;
+        }
+
+        const Node &node = _nodes[current.node];
+        float       entry[4];
+        int mask = intersectChildren(node.minX, node.minY, node.minZ, node.maxX, node.maxY,
+                                     node.maxZ, origin, inverseDirection, closest, entry);
+
+        // Leaves are tested right away, inner children pushed farthest first
+        StackEntry inner[4];
+        int        innerCount = 0;
+        for (int i = 0; i < 4; ++i) {
+            if (!(mask & (1 << i)) || node.children[i] == EMPTY_CHILD) {
+                continue;
+            }
+            if (node.counts[i] == 0) {
+                inner[innerCount++] = {node.children[i], entry[i]};
+                continue;
+            }
+            for (unsigned int t = node.children[i]; t < node.children[i] + node.counts[i]; ++t) {
+                const Triangle &triangle = _triangles[t];
+                glm::vec3       p = glm::cross(direction, triangle.edge2);
+                float           determinant = glm::dot(triangle.edge1, p);
+                if (std::fabs(determinant) < FLT_MIN) {
+                    continue;
+                }
+                float     inverseDeterminant = 1.0f / determinant;
+                glm::vec3 s = origin - triangle.v0;
+                float     u = glm::dot(s, p) * inverseDeterminant;
+                if (u < 0.0f || u > 1.0f) {
+                    continue;
+                }
+                glm::vec3 q = glm::cross(s, triangle.edge1);
+                float     v = glm::dot(direction, q) * inverseDeterminant;
+                if (v < 0.0f || u + v > 1.0f) {
+                    continue;
+                }
+                float distance = glm::dot(triangle.edge2, q) * inverseDeterminant;
+                if (distance >= 0.0f && distance < closest) {
+                    closest = distance;
+                    found = true;
+                    hit.triangle = _triangleIds[t];
+                    hit.distance = distance;
+                    hit.barycentrics = glm::vec2(u, v);
+                }
+            }
+        }
+        std::sort(inner, inner + innerCount, [](const StackEntry &a, const StackEntry &b) {
+            return a.entry > b.entry;
+        });
+        stack.insert(stack.end(), inner, inner + innerCount);
+    }
+    return found;
+}
+
+size_t TriangleBvh::getNodeCount() const { return _nodes.size(); }
+
+// Splits the node and its descendants. The first levels hand one child to another thread;
+// below that, or once subtrees get small, the rest of the subtree is built with a local stack.
+void TriangleBvh::_buildRecursive(unsigned int nodeIndex, unsigned int parallelDepth) {
+    if (parallelDepth > 0 && _buildNodes[nodeIndex].count >= PARALLEL_MIN_TRIANGLES) {
+        if (!_split(nodeIndex)) {
+            return;
+        }
+        unsigned int      left = _buildNodes[nodeIndex].leftFirst;
+        std::future<void> leftBuild = std::async(std::launch::async, &TriangleBvh::_buildRecursive,
+                                                 this, left, parallelDepth - 1);
+        _buildRecursive(left + 1, parallelDepth - 1);
+        leftBuild.get();
+        return;
+    }
+
+    std::vector<unsigned int> stack(1, nodeIndex);
+    while (!stack.empty()) {
+        unsigned int current = stack.back();
+        stack.pop_back();
+        if (_split(current)) {
+            stack.push_back(_buildNodes[current].leftFirst);
+            stack.push_back(_buildNodes[current].leftFirst + 1);
+        }
+    }
+}
+
+// Turns a leaf into an inner node with two leaf children at the best SAH plane, unless keeping
+// the leaf is cheaper
+bool TriangleBvh::_split(unsigned int nodeIndex) {
+    BuildNode &node = _buildNodes[nodeIndex];
+    if (node.count <= 1) {
+        return false;
+    }
+
+    SahSplit split = findSahSplit(_slotBounds, _centroids, node.leftFirst, node.count);
+    float    area = node.bounds.surfaceArea();
+    float    leafCost = static_cast<float>(node.count) * area;
+    float    splitCost = split.cost + TRAVERSAL_COST * area;
+    if (split.axis < 0 || (node.count <= MAX_LEAF_TRIANGLES && splitCost >= leafCost)) {
+        return false;
+    }
+
+    unsigned int leftCount =
+        partitionSlots(split, node.leftFirst, node.count, _triangleIds, _slotBounds, _centroids);
+    if (leftCount == 0 || leftCount == node.count) {
+        return false;
+    }
+
+    unsigned int leftIndex = _buildNodeCount.fetch_add(2);
+    BuildNode   &left = _buildNodes[leftIndex];
+    BuildNode   &right = _buildNodes[leftIndex + 1];
+    left = BuildNode();
+    right = BuildNode();
+    left.leftFirst = node.leftFirst;
+    left.count = leftCount;
+    right.leftFirst = node.leftFirst + leftCount;
+    right.count = node.count - leftCount;
+    for (unsigned int i = left.leftFirst; i < left.leftFirst + left.count; ++i) {
+        left.bounds.grow(_slotBounds[i]);
+    }
+    for (unsigned int i = right.leftFirst; i < right.leftFirst + right.count; ++i) {
+        right.bounds.grow(_slotBounds[i]);
+    }
+
+    node.leftFirst = leftIndex;
+    node.count = 0;
+    return true;
+}
+
+// Builds the 4-wide tree by pulling up grandchildren: each wide node starts from one binary node
+// and keeps opening its largest inner child until it has four children or only leaves are left
+void TriangleBvh::_collapse() {
+    struct Pending {
+        unsigned int buildNode;
+        unsigned int node;
+    };
+
+    _nodes.clear();
+    _nodes.reserve(_buildNodes.size() / 2 + 1);
+    _nodes.push_back(Node());
+    std::vector<Pending> pending(1, Pending{0, 0});
+
+    while (!pending.empty()) {
+        Pending current = pending.back();
+        pending.pop_back();
+
+        unsigned int children[4] = {current.buildNode};
+        unsigned int childCount = 1;
+        while (childCount < 4) {
+            int   largest = -1;
+            float largestArea = -1.0f;
+            for (unsigned int i = 0; i < childCount; ++i) {
+                const BuildNode &child = _buildNodes[children[i]];
+                if (child.count == 0 && child.bounds.surfaceArea() > largestArea) {
+                    largest = static_cast<int>(i);
+                    largestArea = child.bounds.surfaceArea();
+                }
+            }
+            if (largest < 0) {
+                break;
+            }
+            unsigned int opened = children[largest];
+            children[largest] = _buildNodes[opened].leftFirst;
+            children[childCount++] = _buildNodes[opened].leftFirst + 1;
+        }
+
+        Node node;
+        for (unsigned int i = 0; i < 4; ++i) {
+            if (i >= childCount) {
+                node.minX[i] = node.minY[i] = node.minZ[i] = FLT_MAX;
+                node.maxX[i] = node.maxY[i] = node.maxZ[i] = -FLT_MAX;
+                node.children[i] = EMPTY_CHILD;
+                node.counts[i] = 0;
+                continue;
+            }
+            const BuildNode &child = _buildNodes[children[i]];
+            node.minX[i] = child.bounds.min.x;
+            node.minY[i] = child.bounds.min.y;
+            node.minZ[i] = child.bounds.min.z;
+            node.maxX[i] = child.bounds.max.x;
+            node.maxY[i] = child.bounds.max.y;
+            node.maxZ[i] = child.bounds.max.z;
+            node.counts[i] = child.count;
+            if (child.count > 0) {
+                node.children[i] = child.leftFirst;
+            } else {
+                node.children[i] = static_cast<unsigned int>(_nodes.size());
+                pending.push_back(Pending{children[i], node.children[i]});
+                _nodes.push_back(Node());
+            }
+        }
+        _nodes[current.node] = node;
+    }
+}